@@ -0,0 +1,117 @@
+#include <benchmark/benchmark.h>
+
+#include "message.pb.h"
+
+#include <string>
+
+// Compares the version 1 envelope, where the payload is serialized into
+// Message.data, against the version 2 payload oneof. Encode covers
+// building the envelope and serializing it, decode covers parsing it
+// back into a usable payload.
+
+static void fillTask(Scheduler::Task* task) {
+    task->set_type(Scheduler::TaskType::TASK_ONE);
+    task->set_key("dataset-42");
+    task->set_id(123456789);
+}
+
+static void fillTaskResponse(Scheduler::TaskResponse* response) {
+    response->set_success(true);
+    response->set_id(123456789);
+}
+
+static void fillHeartbeat(Scheduler::HeartbeatData* data) {
+    data->set_id(42);
+    data->set_capacity(8);
+    data->set_load(1.5);
+}
+
+static void fillTaskBatch(Scheduler::TaskBatch* batch) {
+    for (int i = 0; i < 64; i++) {
+        fillTask(batch->add_tasks());
+    }
+}
+
+template <typename Payload, void (*fill)(Payload*)>
+static void BM_NestedEncode(benchmark::State& state) {
+    for (auto _: state) {
+        Payload payload;
+        fill(&payload);
+        std::string data;
+        payload.SerializeToString(&data);
+        Scheduler::Message msg;
+        msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_DATA);
+        msg.set_data(data);
+        std::string buffer;
+        msg.SerializeToString(&buffer);
+        benchmark::DoNotOptimize(buffer);
+    }
+}
+
+template <typename Payload, void (*fill)(Payload*)>
+static void BM_NestedDecode(benchmark::State& state) {
+    Payload payload;
+    fill(&payload);
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_DATA);
+    msg.set_data(payload.SerializeAsString());
+    std::string buffer = msg.SerializeAsString();
+    for (auto _: state) {
+        Scheduler::Message received;
+        received.ParseFromString(buffer);
+        Payload p;
+        p.ParseFromString(received.data());
+        benchmark::DoNotOptimize(p);
+    }
+}
+
+template <typename Payload, Payload* (Scheduler::Message::*mutablePayload)(), void (*fill)(Payload*)>
+static void BM_FlatEncode(benchmark::State& state) {
+    for (auto _: state) {
+        Scheduler::Message msg;
+        msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_DATA);
+        msg.set_version(2);
+        fill((msg.*mutablePayload)());
+        std::string buffer;
+        msg.SerializeToString(&buffer);
+        benchmark::DoNotOptimize(buffer);
+    }
+}
+
+template <typename Payload, Payload* (Scheduler::Message::*mutablePayload)(), void (*fill)(Payload*)>
+static void BM_FlatDecode(benchmark::State& state) {
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_DATA);
+    msg.set_version(2);
+    fill((msg.*mutablePayload)());
+    std::string buffer = msg.SerializeAsString();
+    for (auto _: state) {
+        Scheduler::Message received;
+        received.ParseFromString(buffer);
+        benchmark::DoNotOptimize(received);
+    }
+}
+
+using Msg = Scheduler::Message;
+
+BENCHMARK(BM_NestedEncode<Scheduler::Task, fillTask>);
+BENCHMARK(BM_FlatEncode<Scheduler::Task, &Msg::mutable_task, fillTask>);
+BENCHMARK(BM_NestedDecode<Scheduler::Task, fillTask>);
+BENCHMARK(BM_FlatDecode<Scheduler::Task, &Msg::mutable_task, fillTask>);
+
+BENCHMARK(BM_NestedEncode<Scheduler::TaskResponse, fillTaskResponse>);
+BENCHMARK(BM_FlatEncode<Scheduler::TaskResponse, &Msg::mutable_task_response, fillTaskResponse>);
+BENCHMARK(BM_NestedDecode<Scheduler::TaskResponse, fillTaskResponse>);
+BENCHMARK(BM_FlatDecode<Scheduler::TaskResponse, &Msg::mutable_task_response, fillTaskResponse>);
+
+BENCHMARK(BM_NestedEncode<Scheduler::HeartbeatData, fillHeartbeat>);
+BENCHMARK(BM_FlatEncode<Scheduler::HeartbeatData, &Msg::mutable_heartbeat, fillHeartbeat>);
+BENCHMARK(BM_NestedDecode<Scheduler::HeartbeatData, fillHeartbeat>);
+BENCHMARK(BM_FlatDecode<Scheduler::HeartbeatData, &Msg::mutable_heartbeat, fillHeartbeat>);
+
+BENCHMARK(BM_NestedEncode<Scheduler::TaskBatch, fillTaskBatch>);
+BENCHMARK(BM_FlatEncode<Scheduler::TaskBatch, &Msg::mutable_task_batch, fillTaskBatch>);
+BENCHMARK(BM_NestedDecode<Scheduler::TaskBatch, fillTaskBatch>);
+BENCHMARK(BM_FlatDecode<Scheduler::TaskBatch, &Msg::mutable_task_batch, fillTaskBatch>);
+
+BENCHMARK_MAIN();
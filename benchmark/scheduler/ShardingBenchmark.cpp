@@ -0,0 +1,121 @@
+#include <benchmark/benchmark.h>
+
+#include "Master.hpp"
+#include "ShardedClient.hpp"
+#include "ShardedWorker.hpp"
+#include "ShardMap.hpp"
+#include "UniquePtr.hpp"
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Dispatch throughput of a cluster against its number of masters. Masters,
+// workers and the client all run in this process and talk over loopback.
+// Every worker serves every master and tasks return straight away, so the
+// masters' dispatch and routing is what is measured.
+
+static constexpr int WORKERS = 4;
+static constexpr int WORKER_CAPACITY = 16;
+static constexpr int TASKS = 20000;
+static constexpr int BASE_PORT = 19100;
+
+class Cluster {
+public:
+    explicit Cluster(int masterCount) {
+        std::string description;
+        for (int i = 0; i < masterCount; i++) {
+            // Ports differ between cluster sizes so that a cluster never
+            // binds a port the previous one left in TIME_WAIT
+            ports.push_back(std::to_string(BASE_PORT + 10 * masterCount + i));
+            description += (i == 0 ? "" : ",") + std::string{"localhost:"} + ports.back();
+        }
+        ShardMap::parse(description, shards);
+
+        for (const std::string& port: ports) {
+            masters.emplace_back(new Master(nullptr, port.c_str()));
+            Master* master = masters.back().get();
+            if (!master->init() || !master->listen()) {
+                return;
+            }
+            masterThreads.emplace_back(&Master::run, master);
+        }
+
+        for (int i = 0; i < WORKERS; i++) {
+            workers.emplace_back(new ShardedWorker(shards, std::chrono::seconds{1}, WORKER_CAPACITY));
+            ShardedWorker* worker = workers.back().get();
+            worker->setHandler(Scheduler::TaskType::TASK_ONE, [](const Scheduler::Task& task, std::string& result) {
+                result = task.payload();
+                return true;
+            });
+            if (!worker->connect()) {
+                return;
+            }
+            workerThreads.emplace_back(&ShardedWorker::run, worker);
+        }
+
+        client = UniquePtr<ShardedClient>{new ShardedClient(shards)};
+        ready = client->connect();
+    }
+
+    ~Cluster() {
+        if (client.get() != nullptr) {
+            client->close();
+        }
+        // Only masters that got as far as running wait on stop
+        for (size_t i = 0; i < masterThreads.size(); i++) {
+            masters[i]->stop();
+        }
+        for (std::thread& thread: masterThreads) {
+            thread.join();
+        }
+        // Workers return once their masters have closed their connections
+        for (std::thread& thread: workerThreads) {
+            thread.join();
+        }
+    }
+
+    ShardedClient& submitter() {
+        return *client;
+    }
+
+    bool ready = false;
+
+private:
+    std::vector<std::string> ports;
+    ShardMap shards;
+    std::vector<UniquePtr<Master>> masters;
+    std::vector<std::thread> masterThreads;
+    std::vector<UniquePtr<ShardedWorker>> workers;
+    std::vector<std::thread> workerThreads;
+    UniquePtr<ShardedClient> client;
+};
+
+static void BM_ShardedDispatch(benchmark::State& state) {
+    Cluster cluster(state.range(0));
+    if (!cluster.ready) {
+        state.SkipWithError("Cluster failed to start");
+        return;
+    }
+
+    std::vector<std::future<TaskResult>> results;
+    results.reserve(TASKS);
+    for (auto _: state) {
+        for (int i = 0; i < TASKS; i++) {
+            Scheduler::Task task;
+            task.set_type(Scheduler::TaskType::TASK_ONE);
+            task.set_payload("x");
+            results.push_back(cluster.submitter().submit(std::move(task)));
+        }
+        for (std::future<TaskResult>& result: results) {
+            benchmark::DoNotOptimize(result.get().success);
+        }
+        results.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * TASKS);
+}
+BENCHMARK(BM_ShardedDispatch)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+
+#include "TaskGraph.hpp"
+#include "TaskLog.hpp"
+#include "Vector.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Time a restarted master takes to get its backlog back: reading the task
+// log a previous run left behind and queueing every pending task again.
+// Should grow with the number of pending tasks and nothing else.
+
+static constexpr size_t PAYLOAD_SIZE = 64;
+
+static void BM_Recover(benchmark::State& state) {
+    size_t tasks = state.range(0);
+    char path[] = "/tmp/TaskLogBenchmarkXXXXXX";
+    if (mkdtemp(path) == nullptr) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+    std::string directory = path;
+    {
+        TaskLog log(directory);
+        log.open([](const Scheduler::LogRecord&) {});
+        Scheduler::Task task;
+        task.set_type(Scheduler::TaskType::TASK_ONE);
+        task.set_payload(std::string(PAYLOAD_SIZE, 'x'));
+        for (uint64_t id = 1; id <= tasks; id++) {
+            log.submit(id, task, 1, id);
+        }
+        log.sync();
+    }
+
+    for (auto _: state) {
+        TaskLog log(directory);
+        TaskGraph graph;
+        Vector<uint64_t> dependencies;
+        log.open([&](const Scheduler::LogRecord& record) {
+            graph.add(record.id(), record.task(), dependencies);
+        });
+        benchmark::DoNotOptimize(graph.size());
+    }
+    state.SetItemsProcessed(state.iterations() * tasks);
+
+    std::remove((directory + "/tasks.log").c_str());
+    std::remove((directory + "/tasks.snapshot").c_str());
+    std::remove(directory.c_str());
+}
+BENCHMARK(BM_Recover)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
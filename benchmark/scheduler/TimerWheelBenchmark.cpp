@@ -0,0 +1,43 @@
+#include <benchmark/benchmark.h>
+
+#include "TimerWheel.hpp"
+
+#include <cstdint>
+
+// Heartbeat processing against fleet size. A heartbeat pushes its worker's
+// deadline back, and a tick advances the wheel with nothing expiring, so
+// both should cost the same whatever the number of workers.
+
+static constexpr uint64_t EXPIRY_TICKS = 200;
+
+static void BM_Reschedule(benchmark::State& state) {
+    int workers = state.range(0);
+    TimerWheel wheel;
+    for (int id = 0; id < workers; id++) {
+        wheel.schedule(id, EXPIRY_TICKS);
+    }
+
+    int id = 0;
+    for (auto _: state) {
+        wheel.schedule(id, wheel.now() + EXPIRY_TICKS);
+        id = id + 1 == workers ? 0 : id + 1;
+    }
+}
+BENCHMARK(BM_Reschedule)->RangeMultiplier(10)->Range(100, 100000);
+
+static void BM_IdleTick(benchmark::State& state) {
+    int workers = state.range(0);
+    TimerWheel wheel;
+    for (int id = 0; id < workers; id++) {
+        wheel.schedule(id, TimerWheel::MAX_DELAY);
+    }
+
+    int fired = 0;
+    for (auto _: state) {
+        wheel.advance(wheel.now() + 1, [&](int) { fired++; });
+    }
+    benchmark::DoNotOptimize(fired);
+}
+BENCHMARK(BM_IdleTick)->RangeMultiplier(10)->Range(100, 100000);
+
+BENCHMARK_MAIN();
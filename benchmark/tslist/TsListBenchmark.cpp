@@ -0,0 +1,89 @@
+#include <benchmark/benchmark.h>
+
+#include "IntrusiveTsList.hpp"
+#include "RcuList.hpp"
+#include "TsList.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Full traversals from every thread over a list no one writes to, the
+// read mostly case RcuList is for
+
+static constexpr int ELEMENTS = 1024;
+
+template <typename List>
+static List& sharedList() {
+    static List list;
+    static bool filled = [] {
+        for (int i = 0; i < ELEMENTS; i++) {
+            list.pushFront(i);
+        }
+        return true;
+    }();
+    (void)filled;
+    return list;
+}
+
+template <typename List>
+static void BM_ForEach(benchmark::State& state) {
+    List& list = sharedList<List>();
+    int64_t sum = 0;
+    for (auto _: state) {
+        list.forEach([&sum](const int& val) { sum += val; });
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * ELEMENTS);
+}
+BENCHMARK_TEMPLATE(BM_ForEach, TsList<int>)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ForEach, RcuList<int>)->ThreadRange(1, 16)->UseRealTime();
+
+struct Item: TsListHook<Item> {
+    int val = 0;
+};
+
+// Pushes range(0) elements onto an empty list, then removes them all
+static void BM_TsListPush(benchmark::State& state) {
+    for (auto _: state) {
+        TsList<int> list;
+        for (int i = 0; i < state.range(0); i++) {
+            list.pushFront(i);
+        }
+        list.removeIf([](int&) { return true; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TsListPush)->Arg(1024);
+
+static void BM_IntrusiveTsListPush(benchmark::State& state) {
+    std::vector<Item> items(state.range(0));
+    for (auto _: state) {
+        IntrusiveTsList<Item> list;
+        for (Item& item: items) {
+            list.pushFront(item);
+        }
+        list.removeIf([](Item&) { return true; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_IntrusiveTsListPush)->Arg(1024);
+
+static void BM_IntrusiveForEach(benchmark::State& state) {
+    static std::vector<Item> items(ELEMENTS);
+    static IntrusiveTsList<Item> list;
+    if (state.thread_index() == 0 && list.empty()) {
+        for (int i = 0; i < ELEMENTS; i++) {
+            items[i].val = i;
+            list.pushFront(items[i]);
+        }
+    }
+    int64_t sum = 0;
+    for (auto _: state) {
+        list.forEach([&sum](Item& item) { sum += item.val; });
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * ELEMENTS);
+}
+BENCHMARK(BM_IntrusiveForEach)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,94 @@
+#include <benchmark/benchmark.h>
+
+#include "TsSkipList.hpp"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+
+// Lookups from several threads while one thread keeps inserting and
+// erasing, against a std::map behind a reader-writer lock
+
+static constexpr int KEYS = 1 << 16;
+
+// Thread 0 writes, the rest look up random keys
+template <typename Map>
+static void lookups(benchmark::State& state, Map& map) {
+    uint64_t rng = state.thread_index() * 0x9e3779b97f4a7c15ULL + 1;
+    int writes = 0;
+    for (auto _: state) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        int key = rng % KEYS;
+        if (state.thread_index() == 0) {
+            // Keys above KEYS come and go without disturbing the others
+            int churn = KEYS + writes++ % 1024;
+            map.insert(churn, churn);
+            map.erase(churn);
+        } else {
+            benchmark::DoNotOptimize(map.find(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+struct SkipList {
+    TsSkipList<int, int> map;
+
+    SkipList() {
+        for (int key = 0; key < KEYS; key++) {
+            map.insert(key, key);
+        }
+    }
+
+    void insert(int key, int val) {
+        map.insert(key, val);
+    }
+
+    void erase(int key) {
+        map.erase(key);
+    }
+
+    bool find(int key) {
+        int val;
+        return map.find(key, val);
+    }
+};
+
+struct LockedMap {
+    std::shared_mutex m;
+    std::map<int, int> map;
+
+    LockedMap() {
+        for (int key = 0; key < KEYS; key++) {
+            map.emplace(key, key);
+        }
+    }
+
+    void insert(int key, int val) {
+        std::unique_lock lock{m};
+        map.emplace(key, val);
+    }
+
+    void erase(int key) {
+        std::unique_lock lock{m};
+        map.erase(key);
+    }
+
+    bool find(int key) {
+        std::shared_lock lock{m};
+        return map.find(key) != map.end();
+    }
+};
+
+template <typename Map>
+static void BM_Lookups(benchmark::State& state) {
+    static Map map;
+    lookups(state, map);
+}
+BENCHMARK_TEMPLATE(BM_Lookups, SkipList)->ThreadRange(2, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Lookups, LockedMap)->ThreadRange(2, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,219 @@
+#include <benchmark/benchmark.h>
+
+#include "FineGrainedTsQueue.hpp"
+#include "LockFreeQueue.hpp"
+#include "RingQueue.hpp"
+#include "SpscQueue.hpp"
+#include "TsPriorityQueue.hpp"
+#include "TsQueue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <latch>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Every ITsQueue implementation used as one stage of a pipeline: producer
+// threads push a fixed number of elements and consumer threads block in
+// waitAndPop until they are handed a stop element. Arguments are the
+// number of producers and consumers, whether producers push in bursts or
+// steadily, and whether each thread is pinned to a core. Besides
+// throughput it reports percentiles of the time elements spend between
+// push and pop, which is what a stage adds to a task's latency.
+
+static constexpr size_t ITEMS = 1 << 15;
+static constexpr size_t BURST = 256;
+static constexpr std::chrono::microseconds BURST_PAUSE{50};
+// Every SAMPLE_EVERY-th element popped by a consumer has its latency kept
+static constexpr size_t SAMPLE_EVERY = 8;
+
+// Element of Size bytes carrying the time it was pushed at, in
+// nanoseconds since the epoch of steady_clock. STOP tells a consumer to
+// stop, and being later than any real push time it also comes out last of
+// the queues that pop oldest first.
+template <size_t Size>
+struct Payload {
+    static_assert(Size >= sizeof(uint64_t));
+
+    static constexpr uint64_t STOP = std::numeric_limits<uint64_t>::max();
+
+    uint64_t pushedAt = 0;
+    std::array<char, Size - sizeof(uint64_t)> data{};
+
+    friend bool operator>(const Payload& lhs, const Payload& rhs) {
+        return lhs.pushedAt > rhs.pushedAt;
+    }
+};
+
+template <typename Queue>
+struct ElementOf;
+
+template <template <typename...> class Queue, typename T, typename... Rest>
+struct ElementOf<Queue<T, Rest...>> {
+    using type = T;
+};
+
+// Oldest first, so the priority queue behaves as a FIFO
+template <typename T>
+class OldestFirstQueue: public TsPriorityQueue<T, std::greater<T>> {};
+
+static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Best effort and only on Linux, elsewhere threads are left to the
+// scheduler
+static void pinToCore(size_t index) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+    (void)index;
+#endif
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+template <typename Queue>
+static void BM_Stage(benchmark::State& state) {
+    using T = typename ElementOf<Queue>::type;
+    size_t producers = state.range(0);
+    size_t consumers = state.range(1);
+    bool burst = state.range(2) != 0;
+    bool pinned = state.range(3) != 0;
+    std::vector<uint64_t> latencies;
+    std::mutex latenciesMutex;
+
+    for (auto _: state) {
+        Queue queue;
+        std::atomic<size_t> producing = producers;
+        std::latch ready(producers + consumers + 1);
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < producers; i++) {
+            threads.emplace_back([&, i]() {
+                if (pinned) {
+                    pinToCore(i);
+                }
+                ready.arrive_and_wait();
+                size_t count = ITEMS / producers + (i < ITEMS % producers ? 1 : 0);
+                for (size_t pushed = 0; pushed < count; pushed++) {
+                    T val;
+                    val.pushedAt = now();
+                    queue.push(std::move(val));
+                    if (burst && (pushed + 1) % BURST == 0) {
+                        std::this_thread::sleep_for(BURST_PAUSE);
+                    }
+                }
+                // The last producer out tells every consumer to stop
+                if (producing.fetch_sub(1) == 1) {
+                    for (size_t c = 0; c < consumers; c++) {
+                        T stop;
+                        stop.pushedAt = T::STOP;
+                        queue.push(std::move(stop));
+                    }
+                }
+            });
+        }
+        for (size_t i = 0; i < consumers; i++) {
+            threads.emplace_back([&, i]() {
+                if (pinned) {
+                    pinToCore(producers + i);
+                }
+                std::vector<uint64_t> sampled;
+                sampled.reserve(ITEMS / SAMPLE_EVERY / consumers + 1);
+                ready.arrive_and_wait();
+                T val;
+                for (size_t popped = 0; queue.waitAndPop(val) && val.pushedAt != T::STOP; popped++) {
+                    if (popped % SAMPLE_EVERY == 0) {
+                        sampled.push_back(now() - val.pushedAt);
+                    }
+                }
+                std::scoped_lock lock{latenciesMutex};
+                latencies.insert(latencies.end(), sampled.begin(), sampled.end());
+            });
+        }
+
+        ready.arrive_and_wait();
+        auto start = std::chrono::steady_clock::now();
+        for (std::thread& thread: threads) {
+            thread.join();
+        }
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    state.SetItemsProcessed(state.iterations() * ITEMS);
+    state.SetBytesProcessed(state.iterations() * ITEMS * sizeof(T));
+    state.counters["p50_ns"] = percentile(latencies, 0.5);
+    state.counters["p99_ns"] = percentile(latencies, 0.99);
+    state.counters["p999_ns"] = percentile(latencies, 0.999);
+}
+
+// Producers and consumers for the multi producer multi consumer queues,
+// each steady and bursty, unpinned and pinned
+static void stageArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"producers", "consumers", "burst", "pinned"});
+    for (auto [producers, consumers]: {std::pair{1, 1}, {1, 4}, {4, 1}, {4, 4}}) {
+        for (int burst: {0, 1}) {
+            for (int pinned: {0, 1}) {
+                b->Args({producers, consumers, burst, pinned});
+            }
+        }
+    }
+    b->UseManualTime();
+}
+
+static void spscArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"producers", "consumers", "burst", "pinned"});
+    for (int burst: {0, 1}) {
+        for (int pinned: {0, 1}) {
+            b->Args({1, 1, burst, pinned});
+        }
+    }
+    b->UseManualTime();
+}
+
+// Payload size against 4 steady unpinned producers and consumers
+static void payloadArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"producers", "consumers", "burst", "pinned"});
+    b->Args({4, 4, 0, 0});
+    b->UseManualTime();
+}
+
+#define STAGE_BENCHMARKS(Queue, Args)                                    \
+    BENCHMARK_TEMPLATE(BM_Stage, Queue<Payload<64>>)->Apply(Args);       \
+    BENCHMARK_TEMPLATE(BM_Stage, Queue<Payload<8>>)->Apply(payloadArgs); \
+    BENCHMARK_TEMPLATE(BM_Stage, Queue<Payload<1024>>)->Apply(payloadArgs)
+
+STAGE_BENCHMARKS(TsQueue, stageArgs);
+STAGE_BENCHMARKS(FineGrainedTsQueue, stageArgs);
+STAGE_BENCHMARKS(OldestFirstQueue, stageArgs);
+STAGE_BENCHMARKS(RingQueue, stageArgs);
+STAGE_BENCHMARKS(LockFreeQueue, stageArgs);
+// Only correct with one producer and one consumer
+BENCHMARK_TEMPLATE(BM_Stage, SpscQueue<Payload<64>>)->Apply(spscArgs);
+BENCHMARK_TEMPLATE(BM_Stage, SpscQueue<Payload<8>>)->Apply(spscArgs);
+BENCHMARK_TEMPLATE(BM_Stage, SpscQueue<Payload<1024>>)->Apply(spscArgs);
+
+BENCHMARK_MAIN();
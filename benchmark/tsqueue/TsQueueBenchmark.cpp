@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+
+#include "FineGrainedTsQueue.hpp"
+#include "LockFreeQueue.hpp"
+#include "RingQueue.hpp"
+#include "SpscQueue.hpp"
+#include "TsQueue.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Threads split evenly into producers and consumers sharing one queue. All
+// threads run the same number of iterations, so every push is popped.
+
+template <typename Queue>
+static Queue& sharedQueue() {
+    static Queue queue;
+    return queue;
+}
+
+template <typename Queue>
+static void BM_Contention(benchmark::State& state) {
+    Queue& queue = sharedQueue<Queue>();
+    bool producer = state.thread_index() % 2 == 0;
+    uint64_t val = 0;
+    for (auto _: state) {
+        if (producer) {
+            queue.push(val++);
+        } else {
+            queue.waitAndPop(val);
+        }
+    }
+    benchmark::DoNotOptimize(val);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Contention, TsQueue<uint64_t>)->ThreadRange(2, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Contention, FineGrainedTsQueue<uint64_t>)->ThreadRange(2, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Contention, RingQueue<uint64_t>)->ThreadRange(2, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Contention, LockFreeQueue<uint64_t>)->ThreadRange(2, 16)->UseRealTime();
+// Only correct with one producer and one consumer
+BENCHMARK_TEMPLATE(BM_Contention, SpscQueue<uint64_t>)->Threads(2)->UseRealTime();
+
+// One producer and one consumer moving range(0) elements per call
+static void BM_SpscBatch(benchmark::State& state) {
+    static SpscQueue<uint64_t> queue;
+    size_t batch = state.range(0);
+    std::vector<uint64_t> buffer(batch);
+    bool producer = state.thread_index() == 0;
+    size_t moved = 0;
+    for (auto _: state) {
+        size_t done = 0;
+        while (done < batch) {
+            size_t count = producer ? queue.pushN(buffer.data(), batch - done) : queue.popN(buffer.data(), batch - done);
+            if (count == 0) {
+                std::this_thread::yield();
+            }
+            done += count;
+        }
+        moved += done;
+    }
+    state.SetItemsProcessed(moved);
+}
+BENCHMARK(BM_SpscBatch)->RangeMultiplier(4)->Range(1, 256)->Threads(2)->UseRealTime();
+
+BENCHMARK_MAIN();
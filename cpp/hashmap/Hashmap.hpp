@@ -161,6 +161,9 @@ public:
 
     iterator find(const K& key) {
         LOG_DEBUG("find");
+        if (mBucketCount == 0) {
+            return end();
+        }
         size_t bucketIdx = hashKey(key, mBucketCount);
         if (bucketIdx < mBucketCount) {
             for (auto start = mStore[bucketIdx].begin(); start != mStore[bucketIdx].end(); start++) {
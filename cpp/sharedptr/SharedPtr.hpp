@@ -1,25 +1,117 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "Logger.hpp"
 
+// Counts shared by every SharedPtr and WeakPtr to one object. The object
+// is destroyed when the last SharedPtr goes and the block itself when the
+// last of either does, the SharedPtrs together holding one weak count.
+class ControlBlock {
+public:
+    std::atomic<unsigned int> strong = 1;
+    std::atomic<unsigned int> weak = 1;
+
+    virtual ~ControlBlock() = default;
+    virtual void destroyObject() = 0;
+
+    void releaseStrong() {
+        if (strong.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            destroyObject();
+            releaseWeak();
+        }
+    }
+
+    void releaseWeak() {
+        if (weak.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+};
+
+// Block for an object allocated apart from it
+template <typename T>
+class PointerControlBlock: public ControlBlock {
+public:
+    explicit PointerControlBlock(T* ptr): ptr(ptr) {}
+
+    void destroyObject() override {
+        delete ptr;
+    }
+
+private:
+    T* ptr;
+};
+
+// Block with the object in it, so both take one allocation
+template <typename T>
+class InlineControlBlock: public ControlBlock {
+public:
+    template <typename... Args>
+    explicit InlineControlBlock(Args&&... args) {
+        new (storage) T(std::forward<Args>(args)...);
+    }
+
+    T* value() {
+        return std::launder(reinterpret_cast<T*>(storage));
+    }
+
+    void destroyObject() override {
+        value()->~T();
+    }
+
+private:
+    alignas(T) unsigned char storage[sizeof(T)];
+};
+
+template <typename T>
+class WeakPtr;
+
 template <typename T>
 class SharedPtr {
 public:
-    SharedPtr(): ptr(nullptr), refCount(new std::atomic<unsigned int>(1)) {
-        LOG_DEBUG("Default Constructor (%p). refCount: %p", this, refCount);
+    // Null pointers allocate nothing
+    SharedPtr() {
+        LOG_DEBUG("Default Constructor (%p)", this);
+    }
+    SharedPtr(std::nullptr_t) {}
+    SharedPtr(T* ptr): ptr(ptr), control(ptr != nullptr ? new PointerControlBlock<T>(ptr) : nullptr) {
+        LOG_DEBUG("Parameter pointer Constructor (%p): %p, %p", this, ptr, control);
+    }
+    SharedPtr(const SharedPtr& other): ptr(other.ptr), control(other.control) {
+        LOG_DEBUG("Copy Constructor (%p) other ptr: %p, other control: %p", this, other.ptr, other.control);
+        acquire();
     }
-    SharedPtr(T* ptr): ptr(ptr), refCount(new std::atomic<unsigned int>(1)) {
-        LOG_DEBUG("Parameter pointer Constructor (%p): %p, %p", this, ptr, refCount);
+    SharedPtr(SharedPtr&& other): ptr(other.ptr), control(other.control) {
+        LOG_DEBUG("Move Constructor (%p) other ptr: %p, other control: %p", this, other.ptr, other.control);
+        other.ptr = nullptr;
+        other.control = nullptr;
     }
-    SharedPtr(const SharedPtr& other): ptr(other.ptr), refCount(other.refCount) {
-        LOG_DEBUG("Copy Constructor (%p) other ptr: %p, other refCount: %p", this, other.ptr, other.refCount);
-        refCount->fetch_add(1, std::memory_order::relaxed);
+
+    // From a SharedPtr to a type T derives from
+    template <typename U> requires std::is_convertible_v<U*, T*>
+    SharedPtr(const SharedPtr<U>& other): ptr(other.ptr), control(other.control) {
+        acquire();
     }
-    SharedPtr(SharedPtr&& other): ptr(other.ptr), refCount(other.refCount) {
-        LOG_DEBUG("Move Constructor (%p) other ptr: %p, other refCount: %p", this, other.ptr, other.refCount);
+    template <typename U> requires std::is_convertible_v<U*, T*>
+    SharedPtr(SharedPtr<U>&& other): ptr(other.ptr), control(other.control) {
         other.ptr = nullptr;
-        other.refCount = nullptr;
+        other.control = nullptr;
+    }
+
+    // Aliasing: shares ownership with owner but points to ptr, typically
+    // a member of what owner points to
+    template <typename U>
+    SharedPtr(const SharedPtr<U>& owner, T* ptr): ptr(ptr), control(owner.control) {
+        acquire();
+    }
+    template <typename U>
+    SharedPtr(SharedPtr<U>&& owner, T* ptr): ptr(ptr), control(owner.control) {
+        owner.ptr = nullptr;
+        owner.control = nullptr;
     }
 
     SharedPtr<T>& operator=(const SharedPtr& other) {
@@ -27,10 +119,8 @@ public:
         if (this != &other) {
             release();
             ptr = other.ptr;
-            refCount = other.refCount; 
-            if (refCount) {
-                refCount->fetch_add(1, std::memory_order_relaxed);
-            }
+            control = other.control;
+            acquire();
         }
         return *this;
     }
@@ -40,34 +130,145 @@ public:
         if (this != &other) {
             release();
             ptr = other.ptr;
-            refCount = other.refCount; 
+            control = other.control;
             other.ptr = nullptr;
-            other.refCount = nullptr;
+            other.control = nullptr;
         }
         return *this;
     }
 
+    // 0 for a null pointer
     unsigned int get_count() const {
-        return refCount->load(std::memory_order::acquire);
+        return control != nullptr ? control->strong.load(std::memory_order::acquire) : 0;
+    }
+
+    void reset() {
+        release();
+        ptr = nullptr;
+        control = nullptr;
     }
 
     T* get() const { return ptr; }
-    T& operator*() { return *ptr; }
-    T* operator->() { return ptr; }
+    T& operator*() const { return *ptr; }
+    T* operator->() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
 
     ~SharedPtr() {
         release();
     }
 
 private:
+    template <typename U>
+    friend class SharedPtr;
+    template <typename U>
+    friend class WeakPtr;
+    template <typename U, typename... Args>
+    friend SharedPtr<U> makeShared(Args&&... args);
+
+    // Takes over a strong count the caller already holds
+    SharedPtr(T* ptr, ControlBlock* control): ptr(ptr), control(control) {}
+
+    void acquire() {
+        if (control != nullptr) {
+            control->strong.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
     void release() {
-        if (!refCount) return;
-        unsigned int oldCount = refCount->fetch_sub(1, std::memory_order_acq_rel);
-        if (oldCount == 1) {
-            delete ptr;
-            delete refCount;
+        if (control != nullptr) {
+            control->releaseStrong();
         }
     }
+
+    T* ptr = nullptr;
+    ControlBlock* control = nullptr;
+};
+
+// Constructs a T from args in the same allocation as its counts
+template <typename T, typename... Args>
+SharedPtr<T> makeShared(Args&&... args) {
+    auto* control = new InlineControlBlock<T>(std::forward<Args>(args)...);
+    return SharedPtr<T>(control->value(), control);
+}
+
+// Refers to an object owned by SharedPtrs without keeping it alive. lock
+// gets a SharedPtr to it if it still exists.
+template <typename T>
+class WeakPtr {
+public:
+    WeakPtr() = default;
+
+    template <typename U> requires std::is_convertible_v<U*, T*>
+    WeakPtr(const SharedPtr<U>& shared): ptr(shared.ptr), control(shared.control) {
+        acquire();
+    }
+
+    WeakPtr(const WeakPtr& other): ptr(other.ptr), control(other.control) {
+        acquire();
+    }
+
+    WeakPtr(WeakPtr&& other): ptr(other.ptr), control(other.control) {
+        other.ptr = nullptr;
+        other.control = nullptr;
+    }
+
+    WeakPtr& operator=(const WeakPtr& other) {
+        if (this != &other) {
+            release();
+            ptr = other.ptr;
+            control = other.control;
+            acquire();
+        }
+        return *this;
+    }
+
+    WeakPtr& operator=(WeakPtr&& other) {
+        if (this != &other) {
+            release();
+            ptr = other.ptr;
+            control = other.control;
+            other.ptr = nullptr;
+            other.control = nullptr;
+        }
+        return *this;
+    }
+
+    // A null SharedPtr once the object is gone
+    SharedPtr<T> lock() const {
+        if (control == nullptr) {
+            return {};
+        }
+        unsigned int count = control->strong.load(std::memory_order_relaxed);
+        while (count != 0) {
+            if (control->strong.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel,
+                    std::memory_order_relaxed)) {
+                return SharedPtr<T>(ptr, control);
+            }
+        }
+        return {};
+    }
+
+    bool expired() const {
+        return control == nullptr || control->strong.load(std::memory_order_acquire) == 0;
+    }
+
+    ~WeakPtr() {
+        release();
+    }
+
+private:
+    void acquire() {
+        if (control != nullptr) {
+            control->weak.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release() {
+        if (control != nullptr) {
+            control->releaseWeak();
+        }
+    }
+
     T* ptr = nullptr;
-    std::atomic<unsigned int>* refCount = nullptr;
+    ControlBlock* control = nullptr;
 };
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Logger.hpp"
+#include "SpinLock.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+// What an element of an IntrusiveTsList carries, by deriving from it.
+// Tag tells hooks apart when one type sits on several lists at once.
+template <typename T, typename Tag = void>
+class TsListHook {
+public:
+    TsListHook() = default;
+
+    // Being on a list is not part of a copy
+    TsListHook(const TsListHook&) {}
+
+    TsListHook& operator=(const TsListHook&) {
+        return *this;
+    }
+
+private:
+    template <typename, typename>
+    friend class IntrusiveTsList;
+
+    TsListHook* next = nullptr;
+    SpinLock lock;
+};
+
+// TsList whose links live in the elements. pushFront neither copies nor
+// allocates, and each element pays for a pointer and a one byte spinlock
+// instead of a node with its own mutex. Traversals lock hand over hand
+// like TsList. The list doesn't own its elements: they must stay alive
+// while on it, and once removeIf or remove returns them they are the
+// caller's again, to free or push elsewhere.
+template <typename T, typename Tag = void>
+class IntrusiveTsList {
+    using Hook = TsListHook<T, Tag>;
+
+public:
+    IntrusiveTsList() = default;
+
+    IntrusiveTsList(const IntrusiveTsList&) = delete;
+    IntrusiveTsList& operator=(const IntrusiveTsList&) = delete;
+
+    // item must not be on a list with the same tag
+    void pushFront(T& item) {
+        LOG_DEBUG("pushFront");
+        Hook& hook = item;
+        std::scoped_lock lk{head.lock};
+        hook.next = head.next;
+        head.next = &hook;
+    }
+
+    void forEach(std::function<void(T&)> fn) {
+        LOG_DEBUG("forEach");
+        std::unique_lock lk{head.lock};
+        Hook* cur = &head;
+        while (cur->next != nullptr) {
+            Hook* next = cur->next;
+            std::unique_lock nextLk{next->lock};
+            lk.unlock();
+            fn(element(next));
+            cur = next;
+            lk = std::move(nextLk);
+        }
+    }
+
+    // Unlinks every element pred holds for and calls removed, if given,
+    // on each once it is off the list. Returns how many there were.
+    size_t removeIf(std::function<bool(T&)> pred, std::function<void(T&)> removed = {}) {
+        LOG_DEBUG("removeIf");
+        size_t count = 0;
+        std::unique_lock lk{head.lock};
+        Hook* cur = &head;
+        while (cur->next != nullptr) {
+            Hook* next = cur->next;
+            std::unique_lock nextLk{next->lock};
+            if (pred(element(next))) {
+                cur->next = next->next;
+                next->next = nullptr;
+                // Nothing can reach next anymore, unlock it before it is
+                // handed back and maybe destroyed
+                nextLk.unlock();
+                count++;
+                if (removed) {
+                    removed(element(next));
+                }
+            } else {
+                lk.unlock();
+                cur = next;
+                lk = std::move(nextLk);
+            }
+        }
+        return count;
+    }
+
+    // Returns false if item is not on this list
+    bool remove(T& item) {
+        Hook* target = &static_cast<Hook&>(item);
+        return removeIf([target](T& cur) { return &static_cast<Hook&>(cur) == target; }) > 0;
+    }
+
+    // Only a snapshot while other threads push or remove
+    bool empty() {
+        std::scoped_lock lk{head.lock};
+        return head.next == nullptr;
+    }
+
+    // Elements still on the list are left as they are
+    ~IntrusiveTsList() = default;
+
+private:
+    static T& element(Hook* hook) {
+        return static_cast<T&>(*hook);
+    }
+
+    Hook head;
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process wide read-copy-update over epochs. Readers mark their critical
+// sections with a ReadGuard, which costs a store and a fence and never
+// waits. Writers unlink a node and retire it, and it is deleted once every
+// reader that could still hold it has left its section: a node retired in
+// epoch e is deleted once the global epoch reaches e + 2, and the epoch
+// only moves on when no reader is still in an older one.
+class Rcu {
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    // One per thread that ever entered a section, reused once the thread
+    // exits and never freed
+    struct Record {
+        // Epoch the thread's current section started in, 0 outside one
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> active;
+        Record* next;
+    };
+
+    // The calling thread's record and retired nodes
+    struct ThreadState {
+        Record* record = acquireRecord();
+        unsigned nesting = 0;
+        std::vector<Retired> retired;
+
+        ~ThreadState() {
+            tryAdvance();
+            reclaim(retired);
+            // Whatever can't be deleted yet is left to other threads
+            if (!retired.empty()) {
+                std::scoped_lock lock{orphansMutex};
+                orphans.insert(orphans.end(), retired.begin(), retired.end());
+            }
+            record->active.store(false, std::memory_order_release);
+        }
+    };
+
+public:
+    // Retired nodes per thread past which the epoch is advanced and the
+    // nodes old enough are deleted
+    static constexpr size_t RECLAIM_THRESHOLD = 64;
+
+    // Read side critical section, nodes reached inside it stay valid until
+    // it ends. Sections nest.
+    class ReadGuard {
+    public:
+        ReadGuard() {
+            enter();
+        }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        ~ReadGuard() {
+            exit();
+        }
+    };
+
+    static void enter() {
+        ThreadState& self = state();
+        if (self.nesting++ == 0) {
+            self.record->epoch.store(globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // Pairs with the fence in tryAdvance, either the advancing
+            // thread sees this section or it sees every unlink before it
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    static void exit() {
+        ThreadState& self = state();
+        if (--self.nesting == 0) {
+            self.record->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    // Deletes ptr once no reader can still hold it. It has to be
+    // unreachable for readers that start a section from now on.
+    template <typename T>
+    static void retire(T* ptr) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        ThreadState& self = state();
+        self.retired.push_back(Retired{ptr, [](void* p) { delete static_cast<T*>(p); },
+                globalEpoch.load(std::memory_order_relaxed)});
+        if (self.retired.size() >= RECLAIM_THRESHOLD) {
+            tryAdvance();
+            reclaim(self.retired);
+        }
+    }
+
+    // Waits for every section that started before the call to end. Must
+    // not be called from inside one.
+    static void synchronize() {
+        uint64_t target = globalEpoch.load() + 2;
+        while (globalEpoch.load() < target) {
+            if (!tryAdvance()) {
+                std::this_thread::yield();
+            }
+        }
+        reclaim(state().retired);
+    }
+
+private:
+    static ThreadState& state() {
+        thread_local ThreadState self;
+        return self;
+    }
+
+    static Record* acquireRecord() {
+        for (Record* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            bool active = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                    record->active.compare_exchange_strong(active, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        Record* record = new Record{};
+        record->active.store(true, std::memory_order_relaxed);
+        Record* head = records.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        return record;
+    }
+
+    // Moves the global epoch on if every reader inside a section started
+    // it in the current one, returns false if one is still behind
+    static bool tryAdvance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t epoch = globalEpoch.load();
+        for (Record* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            uint64_t local = record->epoch.load(std::memory_order_acquire);
+            if (local != 0 && local != epoch) {
+                return false;
+            }
+        }
+        globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+        return true;
+    }
+
+    // Deletes the retired nodes no reader can hold anymore, keeping the rest
+    static void reclaim(std::vector<Retired>& retired) {
+        {
+            std::unique_lock lock{orphansMutex, std::try_to_lock};
+            if (lock.owns_lock() && !orphans.empty()) {
+                retired.insert(retired.end(), orphans.begin(), orphans.end());
+                orphans.clear();
+            }
+        }
+
+        uint64_t epoch = globalEpoch.load();
+        size_t kept = 0;
+        for (Retired& node: retired) {
+            if (node.epoch + 2 <= epoch) {
+                node.deleter(node.ptr);
+            } else {
+                retired[kept++] = node;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    // Starts at 1 so that 0 can mean a thread is outside any section
+    static inline std::atomic<uint64_t> globalEpoch = 1;
+    static inline std::atomic<Record*> records = nullptr;
+    // Retired nodes of threads that exited before they could be deleted
+    static inline std::mutex orphansMutex;
+    static inline std::vector<Retired> orphans;
+};
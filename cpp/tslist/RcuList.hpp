@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Logger.hpp"
+#include "Rcu.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+// TsList for read mostly use. Readers traverse inside an Rcu read section
+// with plain loads, taking no lock and doing no read-modify-write, so
+// traversals from any number of threads don't contend. Writers are
+// serialized by one mutex, publish new nodes with a single store and
+// retire the ones they unlink to Rcu, which frees them once no reader can
+// still be on them. Elements are never changed in place: updateIf links
+// in an updated copy instead.
+template <typename T>
+class RcuList {
+    struct Node {
+        T val;
+        std::atomic<Node*> next;
+    };
+
+public:
+    RcuList() = default;
+
+    RcuList(const RcuList&) = delete;
+    RcuList& operator=(const RcuList&) = delete;
+
+    void pushFront(T val) {
+        LOG_DEBUG("pushFront");
+        Node* node = new Node{std::move(val), nullptr};
+        std::scoped_lock lock{writeMutex};
+        node->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        head.store(node, std::memory_order_release);
+    }
+
+    // Calls fn on every element, front to back. Elements pushed or removed
+    // meanwhile may or may not be seen. fn runs in a read section and must
+    // not wait for writers on this list.
+    void forEach(std::function<void(const T&)> fn) const {
+        Rcu::ReadGuard guard;
+        for (Node* node = head.load(std::memory_order_acquire); node != nullptr;
+                node = node->next.load(std::memory_order_acquire)) {
+            fn(node->val);
+        }
+    }
+
+    // Returns how many elements were removed
+    size_t removeIf(std::function<bool(const T&)> pred) {
+        LOG_DEBUG("removeIf");
+        std::scoped_lock lock{writeMutex};
+        size_t removed = 0;
+        std::atomic<Node*>* link = &head;
+        Node* node = link->load(std::memory_order_relaxed);
+        while (node != nullptr) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            if (pred(node->val)) {
+                // Readers already on node go on to next through it
+                link->store(next, std::memory_order_release);
+                Rcu::retire(node);
+                removed++;
+            } else {
+                link = &node->next;
+            }
+            node = next;
+        }
+        return removed;
+    }
+
+    // Replaces every element matching pred with a copy fn has been
+    // applied to. A reader sees either the old element or the new one.
+    // Returns how many elements were updated.
+    size_t updateIf(std::function<bool(const T&)> pred, std::function<void(T&)> fn) {
+        LOG_DEBUG("updateIf");
+        std::scoped_lock lock{writeMutex};
+        size_t updated = 0;
+        std::atomic<Node*>* link = &head;
+        Node* node = link->load(std::memory_order_relaxed);
+        while (node != nullptr) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            if (pred(node->val)) {
+                Node* copy = new Node{node->val, next};
+                fn(copy->val);
+                link->store(copy, std::memory_order_release);
+                Rcu::retire(node);
+                link = &copy->next;
+                updated++;
+            } else {
+                link = &node->next;
+            }
+            node = next;
+        }
+        return updated;
+    }
+
+    ~RcuList() {
+        Node* node = head.load();
+        while (node != nullptr) {
+            Node* next = node->next.load();
+            delete node;
+            node = next;
+        }
+    }
+
+private:
+    std::atomic<Node*> head = nullptr;
+    std::mutex writeMutex;
+};
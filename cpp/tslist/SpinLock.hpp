@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+// One byte lock for short critical sections. Spins on a plain load so
+// waiters don't keep taking the cache line from the holder, and yields
+// once it has spun for a while so a preempted holder can run.
+class SpinLock {
+public:
+    static constexpr int SPIN_LIMIT = 64;
+
+    void lock() {
+        while (true) {
+            if (!locked.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+            for (int spin = 0; locked.load(std::memory_order_relaxed); spin++) {
+                if (spin >= SPIN_LIMIT) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        locked.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> locked = false;
+};
@@ -4,6 +4,7 @@
 #include "UniquePtr.hpp"
 
 #include <functional>
+#include <utility>
 #include <mutex>
 
 template <typename T>
@@ -13,7 +14,7 @@ public:
 
     void pushFront(T val) {
         LOG_DEBUG("pushFront");
-        SharedPtr<T> v{new T{val}};
+        SharedPtr<T> v = makeShared<T>(std::move(val));
         UniquePtr<Node> newHead{new Node{v}};
         std::unique_lock lk{head->m};
         UniquePtr<Node> oldHead = std::move(head->next);
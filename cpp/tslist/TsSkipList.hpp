@@ -0,0 +1,340 @@
+#pragma once
+
+#include "Rcu.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+// Ordered map safe for concurrent use, a lazy skiplist after Herlihy, Lev,
+// Luchangco and Shavit. Lookups and iteration take no lock and never wait,
+// they run inside an Rcu read section so that erased nodes stay valid
+// until no reader can be on them. insert and erase lock only the nodes
+// around the one they link or unlink, so writers on different parts of the
+// map don't contend. Keys are unique and a value can't be changed once
+// inserted, erase and insert it again instead.
+template <typename K, typename V, typename Compare = std::less<K>>
+class TsSkipList {
+public:
+    static constexpr int MAX_LEVEL = 16;
+
+private:
+    struct Node;
+
+    // What the head and the nodes have in common
+    struct Link {
+        // next points to height pointers that outlive the link
+        Link(int height, std::atomic<Node*>* next): height(height), next(next) {
+            for (int level = 0; level < height; level++) {
+                new (&next[level]) std::atomic<Node*>(nullptr);
+            }
+        }
+
+        int height;
+        std::atomic<Node*>* next;
+        // Set once the node is linked at every level and before it is
+        // unlinked at any
+        std::atomic<bool> fullyLinked = false;
+        std::atomic<bool> marked = false;
+        std::mutex m;
+    };
+
+    // Allocated together with its next pointers, which follow it, so a
+    // lookup touches one allocation per node it passes
+    struct Node: Link {
+        Node(K key, V val, int height): Link(height, reinterpret_cast<std::atomic<Node*>*>(this + 1)),
+                key(std::move(key)), val(std::move(val)) {}
+
+        static void* operator new(size_t size, int height) {
+            return ::operator new(size + height * sizeof(std::atomic<Node*>));
+        }
+
+        static void operator delete(void* ptr) {
+            ::operator delete(ptr);
+        }
+
+        // Only called if the constructor throws
+        static void operator delete(void* ptr, int) {
+            ::operator delete(ptr);
+        }
+
+        const K key;
+        const V val;
+    };
+
+public:
+    TsSkipList(): head(MAX_LEVEL, headNext) {
+        head.fullyLinked.store(true, std::memory_order_relaxed);
+    }
+
+    TsSkipList(const TsSkipList&) = delete;
+    TsSkipList& operator=(const TsSkipList&) = delete;
+
+    // Returns false, leaving the map as it is, if key is already in it
+    bool insert(K key, V val) {
+        int height = randomHeight();
+        Link* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        Rcu::ReadGuard guard;
+        while (true) {
+            int found = findNode(key, preds, succs);
+            if (found != -1) {
+                Node* node = succs[found];
+                if (!node->marked.load(std::memory_order_acquire)) {
+                    // Another insert of the same key is still linking it
+                    while (!node->fullyLinked.load(std::memory_order_acquire)) {
+                        std::this_thread::yield();
+                    }
+                    return false;
+                }
+                // Being erased, find again once it is gone
+                continue;
+            }
+
+            std::unique_lock<std::mutex> locks[MAX_LEVEL];
+            if (!lockPreds(preds, succs, height, locks, [&](int level) {
+                    return succs[level] == nullptr || !succs[level]->marked.load(std::memory_order_acquire);
+                })) {
+                continue;
+            }
+
+            Node* node = new (height) Node(std::move(key), std::move(val), height);
+            for (int level = 0; level < height; level++) {
+                node->next[level].store(succs[level], std::memory_order_relaxed);
+            }
+            for (int level = 0; level < height; level++) {
+                preds[level]->next[level].store(node, std::memory_order_release);
+            }
+            node->fullyLinked.store(true, std::memory_order_release);
+            count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Copies the value of key into val, returns false if it is not in the map
+    bool find(const K& key, V& val) const {
+        Rcu::ReadGuard guard;
+        const Node* node = findLive(key);
+        if (node == nullptr) {
+            return false;
+        }
+        val = node->val;
+        return true;
+    }
+
+    bool contains(const K& key) const {
+        Rcu::ReadGuard guard;
+        return findLive(key) != nullptr;
+    }
+
+    // Returns false if key is not in the map
+    bool erase(const K& key) {
+        return eraseNode(key, nullptr);
+    }
+
+    // Removes the smallest key, returns false if the map was empty
+    bool popFront(K& key, V& val) {
+        // Held across the erase so that the node can't be freed and its
+        // address reused in between
+        Rcu::ReadGuard guard;
+        while (true) {
+            const Node* node = firstLive(head.next[0].load(std::memory_order_acquire));
+            if (node == nullptr) {
+                return false;
+            }
+            // Lost to another erase if this fails, try the next one
+            if (eraseNode(node->key, node)) {
+                key = node->key;
+                val = node->val;
+                return true;
+            }
+        }
+    }
+
+    // Calls fn on every entry in key order. Entries inserted or erased
+    // meanwhile may or may not be seen. fn runs in a read section and
+    // must not wait for writers on this map.
+    void forEach(std::function<void(const K&, const V&)> fn) const {
+        Rcu::ReadGuard guard;
+        for (const Node* node = firstLive(head.next[0].load(std::memory_order_acquire)); node != nullptr;
+                node = firstLive(node->next[0].load(std::memory_order_acquire))) {
+            fn(node->key, node->val);
+        }
+    }
+
+    // Like forEach over the keys in [from, to)
+    void forEachInRange(const K& from, const K& to, std::function<void(const K&, const V&)> fn) const {
+        Rcu::ReadGuard guard;
+        const Link* pred = &head;
+        for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+            const Node* cur = pred->next[level].load(std::memory_order_acquire);
+            while (cur != nullptr && compare(cur->key, from)) {
+                pred = cur;
+                cur = pred->next[level].load(std::memory_order_acquire);
+            }
+        }
+        for (const Node* node = firstLive(pred->next[0].load(std::memory_order_acquire));
+                node != nullptr && compare(node->key, to);
+                node = firstLive(node->next[0].load(std::memory_order_acquire))) {
+            fn(node->key, node->val);
+        }
+    }
+
+    // Only a snapshot while other threads insert or erase
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    ~TsSkipList() {
+        Node* node = head.next[0].load();
+        while (node != nullptr) {
+            Node* next = node->next[0].load();
+            delete node;
+            node = next;
+        }
+    }
+
+private:
+    // Unlinks the node of key, only if it is expected when that is given
+    bool eraseNode(const K& key, const Node* expected) {
+        Link* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        Rcu::ReadGuard guard;
+        Node* victim = nullptr;
+        std::unique_lock<std::mutex> victimLock;
+        while (true) {
+            int found = findNode(key, preds, succs);
+            if (victim == nullptr) {
+                if (found == -1) {
+                    return false;
+                }
+                Node* candidate = succs[found];
+                // Only a node that is fully linked and found at its top
+                // level can be unlinked at all of them
+                if ((expected != nullptr && candidate != expected) ||
+                        !candidate->fullyLinked.load(std::memory_order_acquire) || candidate->height - 1 != found ||
+                        candidate->marked.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                victimLock = std::unique_lock{candidate->m};
+                if (candidate->marked.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                // Marked under its lock, so of concurrent erases only this one
+                // goes on to unlink it
+                candidate->marked.store(true, std::memory_order_release);
+                victim = candidate;
+            }
+
+            std::unique_lock<std::mutex> locks[MAX_LEVEL];
+            if (!lockPreds(preds, succs, victim->height, locks, [&](int level) { return succs[level] == victim; })) {
+                continue;
+            }
+
+            for (int level = victim->height - 1; level >= 0; level--) {
+                preds[level]->next[level].store(victim->next[level].load(std::memory_order_relaxed),
+                        std::memory_order_release);
+            }
+            victimLock.unlock();
+            count.fetch_sub(1, std::memory_order_relaxed);
+            Rcu::retire(victim);
+            return true;
+        }
+    }
+
+    // Fills preds and succs with the nodes before and from key on every
+    // level, returns the highest level key was found on or -1
+    int findNode(const K& key, Link* preds[], Node* succs[]) {
+        int found = -1;
+        Link* pred = &head;
+        for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+            Node* cur = pred->next[level].load(std::memory_order_acquire);
+            while (cur != nullptr && compare(cur->key, key)) {
+                pred = cur;
+                cur = pred->next[level].load(std::memory_order_acquire);
+            }
+            if (found == -1 && cur != nullptr && !compare(key, cur->key)) {
+                found = level;
+            }
+            preds[level] = pred;
+            succs[level] = cur;
+        }
+        return found;
+    }
+
+    const Node* findLive(const K& key) const {
+        const Link* pred = &head;
+        for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+            const Node* cur = pred->next[level].load(std::memory_order_acquire);
+            while (cur != nullptr && compare(cur->key, key)) {
+                pred = cur;
+                cur = pred->next[level].load(std::memory_order_acquire);
+            }
+            if (cur != nullptr && !compare(key, cur->key)) {
+                return isLive(cur) ? cur : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // The first node from node on that is linked and not being erased
+    static const Node* firstLive(const Node* node) {
+        while (node != nullptr && !isLive(node)) {
+            node = node->next[0].load(std::memory_order_acquire);
+        }
+        return node;
+    }
+
+    static bool isLive(const Node* node) {
+        return node->fullyLinked.load(std::memory_order_acquire) && !node->marked.load(std::memory_order_acquire);
+    }
+
+    // Locks the distinct preds of the lowest height levels, bottom up so
+    // that locks are always taken from the greatest key down, and checks
+    // each level is still pred then succ. Returns false if another writer
+    // got there first, the caller's locks release whatever was taken.
+    template <typename SuccValid>
+    static bool lockPreds(Link* preds[], Node* succs[], int height, std::unique_lock<std::mutex> locks[],
+            SuccValid succValid) {
+        Link* locked = nullptr;
+        for (int level = 0; level < height; level++) {
+            Link* pred = preds[level];
+            if (pred != locked) {
+                locks[level] = std::unique_lock{pred->m};
+                locked = pred;
+            }
+            if (pred->marked.load(std::memory_order_acquire) ||
+                    pred->next[level].load(std::memory_order_acquire) != succs[level] || !succValid(level)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Each level above the first with probability 1/4
+    static int randomHeight() {
+        thread_local uint64_t state = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int height = 1;
+        for (uint64_t bits = state; height < MAX_LEVEL && (bits & 3) == 0; bits >>= 2) {
+            height++;
+        }
+        return height;
+    }
+
+    std::atomic<Node*> headNext[MAX_LEVEL];
+    Link head;
+    std::atomic<size_t> count = 0;
+    [[no_unique_address]] Compare compare;
+};
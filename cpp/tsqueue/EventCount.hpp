@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lets threads sleep until a condition they poll for may have changed,
+// without a mutex. Changers call notify after making the change, which is
+// free unless a waiter has gone to sleep since the last wakeup.
+class EventCount {
+public:
+    // The fence orders the change before the check for sleepers, pairing
+    // with the one in wait, so either the waiter sees the change or we see
+    // it sleeping
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!sleeping.load(std::memory_order_relaxed) || !sleeping.exchange(false)) {
+            return;
+        }
+        wakeAll();
+    }
+
+    // Retries attempt until it succeeds, sleeping until notified in between.
+    // Returns false if shutdown is set first.
+    template <typename Attempt>
+    bool wait(Attempt attempt, const std::atomic<bool>& shutdown) {
+        waiting.fetch_add(1);
+        bool success;
+        while (true) {
+            sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint32_t seen = epoch.load(std::memory_order_relaxed);
+            if ((success = attempt()) || shutdown.load()) {
+                break;
+            }
+            epoch.wait(seen, std::memory_order_relaxed);
+        }
+        waiting.fetch_sub(1);
+        return success;
+    }
+
+    void wakeAll() {
+        epoch.fetch_add(1, std::memory_order_relaxed);
+        epoch.notify_all();
+    }
+
+    // Threads inside wait
+    uint32_t waiters() const {
+        return waiting.load();
+    }
+
+private:
+    std::atomic<uint32_t> epoch = 0;
+    std::atomic<bool> sleeping = false;
+    std::atomic<uint32_t> waiting = 0;
+};
@@ -2,100 +2,196 @@
 
 #include "ITsQueue.hpp"
 #include "SharedPtr.hpp"
-#include "UniquePtr.hpp"
 #include "Logger.hpp"
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <mutex>
+#include <new>
+#include <utility>
 
+// Queue with a lock for each end, so that pushes and pops only contend
+// with each other. A dummy node sits at the head, and the value being
+// popped lives in the node after it, so a pop only has to look at the
+// head's next pointer to tell the queue is empty and never takes the tail
+// lock. Nodes popped off are kept in a pool that pushes allocate from.
 template <typename T>
 class FineGrainedTsQueue: public ITsQueue<T> {
-    struct Node;
+    struct Node {
+        std::atomic<Node*> next = nullptr;
+        // Constructed by push and destroyed by the pop that takes it, the
+        // dummy at the head never holds a value
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
 public:
-    FineGrainedTsQueue(): head{new Node{}}, tail{head.get()} {
-        LOG_DEBUG("Default Constructor: head=%p, head=%p, tail=%p", &head, head.get(), tail);
+    static constexpr size_t DEFAULT_POOL_SIZE = 256;
+
+    // Up to poolSize popped nodes are kept for reuse, 0 frees every one
+    explicit FineGrainedTsQueue(size_t poolSize = DEFAULT_POOL_SIZE): head{new Node}, tail{head},
+            poolSize(poolSize) {
+        LOG_DEBUG("Default Constructor: head=%p, tail=%p", head, tail);
     }
 
+    FineGrainedTsQueue(const FineGrainedTsQueue&) = delete;
+    FineGrainedTsQueue& operator=(const FineGrainedTsQueue&) = delete;
+
     // Pop from head
     SharedPtr<T> tryPop() override {
-        LOG_DEBUG("tryPop, return shared ptr");
-        std::lock_guard lk{headMutex};
-        if (head.get() == getTail()) {
+        std::unique_lock lk{headMutex};
+        Node* next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
             return {};
         }
-        UniquePtr<Node> oldHead = popHead();
-        return oldHead->val;
+        SharedPtr<T> res = makeShared<T>(std::move(*next->value()));
+        popHead(lk, next);
+        return res;
     }
 
     bool tryPop(T& val) override {
-        std::lock_guard lk{headMutex};
-        if (head.get() == getTail()) {
-            return {};
+        std::unique_lock lk{headMutex};
+        Node* next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
         }
-        
-        // Need to ensure copying is done before popping
-        // in case of exceptions when copying and data 
-        // is lost
-        val = std::move(*head->val);
-        popHead();
+        val = std::move(*next->value());
+        popHead(lk, next);
         return true;
     }
 
     SharedPtr<T> waitAndPop() override {
-        LOG_DEBUG("waitAndPop, return shared ptr");
         std::unique_lock lk{headMutex};
-        cv.wait(lk, [this]() { return head.get() != getTail(); });
-        
-        UniquePtr<Node> oldHead = popHead();
-        return oldHead->val;
+        Node* next = waitForNext(lk);
+        SharedPtr<T> res = makeShared<T>(std::move(*next->value()));
+        popHead(lk, next);
+        return res;
     }
 
     bool waitAndPop(T& val) override {
         std::unique_lock lk{headMutex};
-        cv.wait(lk, [this]() { return head.get() != getTail(); });
-        val = std::move(*head->val);
-        popHead();
+        Node* next = waitForNext(lk);
+        val = std::move(*next->value());
+        popHead(lk, next);
         return true;
     }
 
     // Push to tail
     void push(T val) override {
-        LOG_DEBUG("push");
-        SharedPtr<T> valPtr{new T{std::move(val)}};
-        UniquePtr<Node> newDummy{new Node{}};
+        Node* node;
         {
             std::lock_guard lk{tailMutex};
-            tail->val = valPtr;
-            tail->next = std::move(newDummy);
-            tail = tail->next.get();
+            node = allocate();
+            new (node->storage) T(std::move(val));
+            // Sequentially consistent, pairing with waiters in waitForNext
+            tail->next.store(node, std::memory_order_seq_cst);
+            tail = node;
+        }
+        // A consumer about to wait holds the head lock between seeing the
+        // queue empty and going to sleep, taking it here keeps the
+        // notification from falling in between
+        if (waiting.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard lk{headMutex};
         }
         cv.notify_one();
     }
 
-    Node* getTail() {
-        std::lock_guard lk{tailMutex};
-        return tail;
-    }
-
+    // Only a snapshot while other threads are pushing or popping
     bool empty() {
         std::lock_guard lk{headMutex};
-        return head.get() == getTail();
+        return head->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    ~FineGrainedTsQueue() {
+        Node* node = head->next.load();
+        while (node != nullptr) {
+            Node* next = node->next.load();
+            node->value()->~T();
+            delete node;
+            node = next;
+        }
+        delete head;
+        freeList(spare);
+        freeList(recycled.load());
     }
 
 private:
-    UniquePtr<Node> popHead() {
-        UniquePtr<Node> oldHead = std::move(head);
-        head = std::move(oldHead->next);
-        return oldHead;
+    Node* waitForNext(std::unique_lock<std::mutex>& lk) {
+        Node* next = head->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            return next;
+        }
+        waiting.fetch_add(1, std::memory_order_seq_cst);
+        cv.wait(lk, [&]() { return (next = head->next.load(std::memory_order_seq_cst)) != nullptr; });
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+        return next;
     }
 
-    struct Node {
-        SharedPtr<T> val;
-        UniquePtr<Node> next;
-    };
+    // Makes next, whose value has been moved out, the new dummy and
+    // recycles the old one once the head lock is released
+    void popHead(std::unique_lock<std::mutex>& lk, Node* next) {
+        next->value()->~T();
+        Node* oldHead = head;
+        head = next;
+        lk.unlock();
+        recycle(oldHead);
+    }
+
+    // Pushed onto recycled by pops and taken off all at once by pushes,
+    // which keeps the list free of ABA without either side locking
+    void recycle(Node* node) {
+        if (pooled.load(std::memory_order_relaxed) >= poolSize) {
+            delete node;
+            return;
+        }
+        pooled.fetch_add(1, std::memory_order_relaxed);
+        Node* top = recycled.load(std::memory_order_relaxed);
+        do {
+            node->next.store(top, std::memory_order_relaxed);
+        } while (!recycled.compare_exchange_weak(top, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Called with the tail lock held
+    Node* allocate() {
+        if (spare == nullptr) {
+            spare = recycled.exchange(nullptr, std::memory_order_acquire);
+            size_t taken = 0;
+            for (Node* node = spare; node != nullptr; node = node->next.load(std::memory_order_relaxed)) {
+                taken++;
+            }
+            pooled.fetch_sub(taken, std::memory_order_relaxed);
+        }
+        if (spare == nullptr) {
+            return new Node;
+        }
+        Node* node = spare;
+        spare = node->next.load(std::memory_order_relaxed);
+        node->next.store(nullptr, std::memory_order_relaxed);
+        return node;
+    }
+
+    static void freeList(Node* node) {
+        while (node != nullptr) {
+            Node* next = node->next.load();
+            delete node;
+            node = next;
+        }
+    }
 
-    UniquePtr<Node> head;
+    // Guarded by headMutex
+    Node* head;
+    // Guarded by tailMutex, as is spare
     Node* tail;
+    Node* spare = nullptr;
+    std::atomic<Node*> recycled = nullptr;
+    // Nodes on recycled, give or take the ones being moved to spare
+    std::atomic<size_t> pooled = 0;
+    size_t poolSize;
+    std::atomic<int> waiting = 0;
 
     std::mutex headMutex;
     std::mutex tailMutex;
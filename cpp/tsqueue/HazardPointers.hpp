@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Process wide hazard pointers, after Maged Michael's. A thread publishes
+// the nodes it is about to dereference in its slots, and a node that has
+// been unlinked is only deleted once no slot holds it. Retired nodes are
+// scanned for in batches, so memory goes back to the allocator shortly
+// after a burst instead of staying with the structure until it is
+// destroyed.
+class HazardPointers {
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+    };
+
+    // One per thread that ever used a hazard pointer, reused once the
+    // thread exits and never freed
+    struct Record {
+        std::atomic<void*> hazards[2];
+        std::atomic<bool> active;
+        Record* next;
+    };
+
+    // The calling thread's record and retired nodes
+    struct ThreadState {
+        Record* record = acquireRecord();
+        std::vector<Retired> retired;
+
+        ~ThreadState() {
+            for (std::atomic<void*>& hazard: record->hazards) {
+                hazard.store(nullptr);
+            }
+            scan(retired);
+            // Whatever is still protected is left to other threads' scans
+            if (!retired.empty()) {
+                std::scoped_lock lock{orphansMutex};
+                orphans.insert(orphans.end(), retired.begin(), retired.end());
+            }
+            record->active.store(false, std::memory_order_release);
+        }
+    };
+
+public:
+    static constexpr int SLOTS_PER_THREAD = 2;
+    // Retired nodes per thread past which a scan is run, in records
+    static constexpr size_t SCAN_FACTOR = 2;
+    static constexpr size_t MIN_SCAN_THRESHOLD = 64;
+
+    // Publishes what src points to in the calling thread's slot and
+    // returns it once src is seen to still point to it, after which it
+    // won't be deleted until the slot is cleared
+    template <typename T>
+    static T* protect(int slot, const std::atomic<T*>& src) {
+        std::atomic<void*>& hazard = state().record->hazards[slot];
+        T* ptr = src.load();
+        while (true) {
+            hazard.store(ptr);
+            T* current = src.load();
+            if (current == ptr) {
+                return ptr;
+            }
+            ptr = current;
+        }
+    }
+
+    static void clear(int slot) {
+        state().record->hazards[slot].store(nullptr, std::memory_order_release);
+    }
+
+    // Deletes ptr once no thread protects it. It has to be unreachable for
+    // threads that have not protected it yet.
+    template <typename T>
+    static void retire(T* ptr) {
+        ThreadState& self = state();
+        self.retired.push_back(Retired{ptr, [](void* p) { delete static_cast<T*>(p); }});
+        if (self.retired.size() >= std::max(MIN_SCAN_THRESHOLD, SCAN_FACTOR * SLOTS_PER_THREAD * recordCount.load())) {
+            scan(self.retired);
+        }
+    }
+
+private:
+    static ThreadState& state() {
+        thread_local ThreadState self;
+        return self;
+    }
+
+    static Record* acquireRecord() {
+        for (Record* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            bool active = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                    record->active.compare_exchange_strong(active, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        Record* record = new Record{};
+        record->active.store(true, std::memory_order_relaxed);
+        Record* head = records.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        recordCount.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    // Deletes the retired nodes no slot holds, keeping the rest
+    static void scan(std::vector<Retired>& retired) {
+        {
+            std::unique_lock lock{orphansMutex, std::try_to_lock};
+            if (lock.owns_lock() && !orphans.empty()) {
+                retired.insert(retired.end(), orphans.begin(), orphans.end());
+                orphans.clear();
+            }
+        }
+
+        // Pairs with the stores in protect, a thread that protected a node
+        // before it was unlinked is seen here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<void*> hazards;
+        for (Record* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            for (std::atomic<void*>& hazard: record->hazards) {
+                if (void* ptr = hazard.load()) {
+                    hazards.push_back(ptr);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        size_t kept = 0;
+        for (Retired& node: retired) {
+            if (std::binary_search(hazards.begin(), hazards.end(), node.ptr)) {
+                retired[kept++] = node;
+            } else {
+                node.deleter(node.ptr);
+            }
+        }
+        retired.resize(kept);
+    }
+
+    static inline std::atomic<Record*> records = nullptr;
+    static inline std::atomic<size_t> recordCount = 0;
+    // Retired nodes of threads that exited while they were still protected
+    static inline std::mutex orphansMutex;
+    static inline std::vector<Retired> orphans;
+};
@@ -1,126 +1,166 @@
 #pragma once
 
+#include "EventCount.hpp"
+#include "HazardPointers.hpp"
+#include "ITsQueue.hpp"
+#include "SharedPtr.hpp"
+
 #include <atomic>
-#include <optional>
+#include <new>
+#include <thread>
+#include <utility>
+
+// Unbounded lock free queue after Michael and Scott. Nodes are deleted
+// through hazard pointers as soon as no popper can still be reading them,
+// so no generation counters are needed to avoid ABA. waitAndPop sleeps on
+// an eventcount while the queue is empty.
+template <typename T>
+class LockFreeQueue: public ITsQueue<T> {
+    struct Node {
+        std::atomic<Node*> next = nullptr;
+        // Constructed by push and destroyed by the pop that takes it, the
+        // dummy at the head never holds a value
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
 
-class LockFreeQueue {
 public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    // Attempts made before waitAndPop sleeps
+    static constexpr int SPIN_LIMIT = 64;
+
     LockFreeQueue() {
         Node* dummy = new Node;
-        head = GenNode{dummy, 1};
-        tail = dummy;
-        stackTop = GenNode{new Node, 1};
+        head.store(dummy);
+        tail.store(dummy);
     }
 
-    std::optional<int> tryPop() {
-        // Synchronises with tryPop (head.compare_exchange_weak(...))
-        GenNode headPtr = head.load(std::memory_order::acquire);
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    void push(T val) override {
+        Node* node = new Node;
+        new (node->storage) T(std::move(val));
         while (true) {
-            // Synchronises with push (oldDummy->next.store)
-            Node* newHead = headPtr.ptr->next.load(std::memory_order::acquire);
-            if (newHead == nullptr) {
-                return std::nullopt;
+            Node* last = HazardPointers::protect(0, tail);
+            Node* next = last->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                // Help a push that linked its node but has not moved the tail
+                tail.compare_exchange_weak(last, next);
+                continue;
             }
-
-            GenNode newHeadPtr{newHead, headPtr.counter + 1};
-
-            // Synchronises with tryPop (head.load(...))
-            // Needs to release the memory else there could
-            // be a race between headPtr.ptr (read) and
-            // a write in getNewNode(...)
-            if (head.compare_exchange_weak(headPtr, newHeadPtr,
-                                           std::memory_order::acq_rel)) {
+            if (last->next.compare_exchange_weak(next, node, std::memory_order_release)) {
+                tail.compare_exchange_strong(last, node);
                 break;
             }
         }
-        int res{headPtr.ptr->data};
-        recycleNode(headPtr.ptr);
-        return res;
-    }
-
-    // 1. Need to create new dummy node
-    // 2. Exchange new and old dummy node
-    // 3. Write the data into the old dummy node
-    void push(int val) {
-        Node* newDummy = getNewNode();
-        newDummy->next.store(nullptr);
-        Node* oldDummy = tail.exchange(newDummy);
-        oldDummy->data = val;
-        // Synchronises with tryPop (headPtr.ptr->next.load)
-        oldDummy->next.store(newDummy, std::memory_order::release);
+        HazardPointers::clear(0);
+        notEmpty.notify();
     }
 
-    ~LockFreeQueue() {
-        GenNode headPtr = head.load(std::memory_order::relaxed);
-        Node* cur = headPtr.ptr;
-        while (cur) {
-            Node* nxt = cur->next;
-            delete cur;
-            cur = nxt;
+    bool waitAndPop(T& val) override {
+        for (int spin = 0; spin < SPIN_LIMIT; spin++) {
+            if (tryPop(val)) {
+                return true;
+            }
         }
+        return notEmpty.wait([&]() { return tryPop(val); }, shutdown);
+    }
 
-        GenNode stackPtr = stackTop.load(std::memory_order::relaxed);
-        cur = stackPtr.ptr;
-        while (cur) {
-            Node* nxt = cur->next;
-            delete cur;
-            cur = nxt;
+    SharedPtr<T> waitAndPop() override {
+        T val;
+        if (!waitAndPop(val)) {
+            return {};
         }
+        return makeShared<T>(std::move(val));
     }
 
-private:
-    struct Node;
-    Node* getNewNode() {
-        GenNode oldTop = stackTop.load(std::memory_order::relaxed);
+    bool tryPop(T& val) override {
+        Node* first;
+        Node* next;
         while (true) {
-            Node* ptr = oldTop.ptr;
-            if (ptr == nullptr) {
-                return new Node{};
+            first = HazardPointers::protect(0, head);
+            // Protected before head is checked again, so if head still is
+            // first then next has not been popped and retired yet
+            next = HazardPointers::protect(1, first->next);
+            if (head.load() != first) {
+                continue;
             }
-
-            // Synchronises with recycleNode (val->next.store(...))
-            Node* next = ptr->next.load(std::memory_order::acquire);
-            GenNode newTop{next, oldTop.counter + 1};
-            if (stackTop.compare_exchange_weak(oldTop, newTop,
-                                               std::memory_order::relaxed)) {
+            if (next == nullptr) {
+                HazardPointers::clear(0);
+                HazardPointers::clear(1);
+                return false;
+            }
+            Node* last = tail.load();
+            if (first == last) {
+                // The tail lags behind a node that is already linked
+                tail.compare_exchange_weak(last, next);
+                continue;
+            }
+            if (head.compare_exchange_weak(first, next)) {
                 break;
             }
         }
 
-        return oldTop.ptr;
+        // next is the new dummy, only the pop that moved the head onto it
+        // touches its value
+        val = std::move(*next->value());
+        next->value()->~T();
+        HazardPointers::clear(0);
+        HazardPointers::clear(1);
+        HazardPointers::retire(first);
+        return true;
     }
 
-    void recycleNode(Node* val) {
-        GenNode oldTop = stackTop.load(std::memory_order::relaxed);
-        while (true) {
-            // Synchronises with getNewNode (ptr->next.load)
-            // Needs to release the current view of memory for
-            // the load if not subsequent uses of that node in
-            // getNewNode could cause a data race when someone 
-            // wishes to read the node value previously
-            val->next.store(oldTop.ptr, std::memory_order::release);
-            GenNode newTop{val, oldTop.counter + 1};
-            if (stackTop.compare_exchange_weak(oldTop, newTop,
-                                               std::memory_order::relaxed)) {
-                break;
+    SharedPtr<T> tryPop() override {
+        T val;
+        if (!tryPop(val)) {
+            return {};
+        }
+        return makeShared<T>(std::move(val));
+    }
+
+    // Only a snapshot while other threads are pushing or popping. Takes
+    // hazard slot 0 like tryPop, so a concurrent pop can't free the head
+    // while its next is read.
+    bool empty() const {
+        Node* first = HazardPointers::protect(0, head);
+        bool empty = first->next.load() == nullptr;
+        HazardPointers::clear(0);
+        return empty;
+    }
+
+    // Wakes every blocked waitAndPop and waits for them to return
+    void stop() {
+        shutdown.store(true);
+        notEmpty.wakeAll();
+        while (notEmpty.waiters() > 0) {
+            std::this_thread::yield();
+        }
+        shutdown.store(false);
+    }
+
+    ~LockFreeQueue() {
+        stop();
+        Node* node = head.load();
+        bool dummy = true;
+        while (node != nullptr) {
+            Node* next = node->next.load();
+            if (!dummy) {
+                node->value()->~T();
             }
+            delete node;
+            node = next;
+            dummy = false;
         }
     }
-     
-    struct Node {
-        // Needs to be atomic as there could be 
-        // a read from tryPop while the push is
-        // writing the data into the node.
-        std::atomic<Node*> next;
-        int data;
-    };
-    
-    struct GenNode {
-        Node* ptr;
-        int counter;
-    };
 
-    std::atomic<GenNode> head;
-    std::atomic<Node*> tail;
-    std::atomic<GenNode> stackTop;
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<Node*> head;
+    alignas(CACHE_LINE_SIZE) std::atomic<Node*> tail;
+    alignas(CACHE_LINE_SIZE) EventCount notEmpty;
+    std::atomic<bool> shutdown = false;
 };
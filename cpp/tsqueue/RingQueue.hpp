@@ -0,0 +1,247 @@
+#pragma once
+
+#include "EventCount.hpp"
+#include "ITsQueue.hpp"
+#include "Logger.hpp"
+#include "SharedPtr.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+// Bounded multi producer multi consumer queue over a ring of slots, after
+// Dmitry Vyukov's. Every slot carries a sequence number telling whether it
+// is free or holds an element for the current lap, so producers and
+// consumers only contend on their own end's position and never take a
+// lock. push blocks while the queue is full and waitAndPop while it is
+// empty, both on an eventcount that costs nothing while no one sleeps.
+template <typename T>
+class RingQueue: public ITsQueue<T> {
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+    // Attempts made before a blocking call sleeps
+    static constexpr int SPIN_LIMIT = 64;
+
+    // Capacity is rounded up to a power of two
+    explicit RingQueue(size_t capacity = DEFAULT_CAPACITY):
+            mask(std::bit_ceil(std::max<size_t>(2, capacity)) - 1), slots(new Slot[mask + 1]) {
+        for (size_t i = 0; i <= mask; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    // Blocks while the queue is full. A push still blocked when the queue
+    // is stopped drops its element.
+    void push(T val) override {
+        for (int spin = 0; spin < SPIN_LIMIT; spin++) {
+            if (tryPush(std::move(val))) {
+                return;
+            }
+        }
+        if (!notFull.wait([&]() { return tryPush(std::move(val)); }, shutdown)) {
+            LOG_ERROR("Dropping element pushed to a stopped full queue");
+        }
+    }
+
+    // Leaves val untouched when the queue is full
+    bool tryPush(T&& val) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (slot.storage) T(std::move(val));
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    notEmpty.notify();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Moves as many of the n values in as fit with one claim on the tail,
+    // returns how many that was. Values not pushed are left untouched.
+    size_t pushN(T* values, size_t n) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (n > 0) {
+            count = 0;
+            while (count < n && slots[(pos + count) & mask].sequence.load(std::memory_order_acquire) == pos + count) {
+                count++;
+            }
+            if (count == 0) {
+                intptr_t diff = static_cast<intptr_t>(
+                        slots[pos & mask].sequence.load(std::memory_order_acquire) - pos);
+                if (diff < 0) {
+                    return 0;
+                }
+                pos = enqueuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Slot& slot = slots[(pos + i) & mask];
+            new (slot.storage) T(std::move(values[i]));
+            slot.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        if (count > 0) {
+            notEmpty.notify();
+        }
+        return count;
+    }
+
+    bool waitAndPop(T& val) override {
+        for (int spin = 0; spin < SPIN_LIMIT; spin++) {
+            if (tryPop(val)) {
+                return true;
+            }
+        }
+        return notEmpty.wait([&]() { return tryPop(val); }, shutdown);
+    }
+
+    SharedPtr<T> waitAndPop() override {
+        T val;
+        if (!waitAndPop(val)) {
+            return {};
+        }
+        return makeShared<T>(std::move(val));
+    }
+
+    bool tryPop(T& val) override {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    val = std::move(*slot.value());
+                    slot.value()->~T();
+                    // Free for the producer one lap ahead
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    notFull.notify();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    SharedPtr<T> tryPop() override {
+        T val;
+        if (!tryPop(val)) {
+            return {};
+        }
+        return makeShared<T>(std::move(val));
+    }
+
+    // Moves up to n elements out with one claim on the head, returns how
+    // many that was
+    size_t popN(T* out, size_t n) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (n > 0) {
+            count = 0;
+            while (count < n &&
+                    slots[(pos + count) & mask].sequence.load(std::memory_order_acquire) == pos + count + 1) {
+                count++;
+            }
+            if (count == 0) {
+                intptr_t diff = static_cast<intptr_t>(
+                        slots[pos & mask].sequence.load(std::memory_order_acquire) - (pos + 1));
+                if (diff < 0) {
+                    return 0;
+                }
+                pos = dequeuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (dequeuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Slot& slot = slots[(pos + i) & mask];
+            out[i] = std::move(*slot.value());
+            slot.value()->~T();
+            slot.sequence.store(pos + i + mask + 1, std::memory_order_release);
+        }
+        if (count > 0) {
+            notFull.notify();
+        }
+        return count;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Only a snapshot while other threads are pushing or popping
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t size() const {
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    // Wakes every blocked call and waits for them to return
+    void stop() {
+        shutdown.store(true);
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+        while (notEmpty.waiters() > 0 || notFull.waiters() > 0) {
+            std::this_thread::yield();
+        }
+        shutdown.store(false);
+    }
+
+    ~RingQueue() {
+        stop();
+        T val;
+        while (tryPop(val)) {}
+    }
+
+private:
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    // Each end on its own cache line so producers and consumers don't
+    // invalidate each other's
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePos = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeuePos = 0;
+    alignas(CACHE_LINE_SIZE) EventCount notEmpty;
+    alignas(CACHE_LINE_SIZE) EventCount notFull;
+    std::atomic<bool> shutdown = false;
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "ITsQueue.hpp"
+#include "SharedPtr.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+// Bounded queue for exactly one producer thread and one consumer thread.
+// Each side owns its index and keeps a cached copy of the other's, only
+// rereading it when the cache says the ring is full or empty, so in the
+// steady state a push or pop touches no cache line the other side writes
+// besides the slot itself. tryPush, tryPop and their batch forms are wait
+// free and execute no fences.
+//
+// Because of that a blocked push or waitAndPop can miss its wakeup in a
+// narrow race, so they never sleep longer than MAX_SLEEP at a time.
+template <typename T>
+class SpscQueue: public ITsQueue<T> {
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    // The side of the queue a blocked call waits on
+    struct Sleeper {
+        std::mutex m;
+        std::condition_variable cv;
+        std::atomic<bool> sleeping = false;
+    };
+
+public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+    // Attempts made before a blocking call sleeps
+    static constexpr int SPIN_LIMIT = 256;
+    static constexpr std::chrono::microseconds MAX_SLEEP{500};
+
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity = DEFAULT_CAPACITY):
+            mask(std::bit_ceil(std::max<size_t>(2, capacity)) - 1), slots(new Slot[mask + 1]) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only. Leaves val untouched when the queue is full.
+    bool tryPush(T&& val) {
+        if (!pushOne(val)) {
+            return false;
+        }
+        wake(consumer);
+        return true;
+    }
+
+    // Producer only. Moves in as many of the n values as fit and returns
+    // how many that was, publishing them all at once.
+    size_t pushN(T* values, size_t n) {
+        size_t tail = tailPos.load(std::memory_order_relaxed);
+        if (mask + 1 - (tail - cachedHead) < n) {
+            cachedHead = headPos.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(n, mask + 1 - (tail - cachedHead));
+        for (size_t i = 0; i < count; i++) {
+            new (slots[(tail + i) & mask].storage) T(std::move(values[i]));
+        }
+        if (count > 0) {
+            tailPos.store(tail + count, std::memory_order_release);
+            wake(consumer);
+        }
+        return count;
+    }
+
+    // Producer only. Blocks while the queue is full, a push still blocked
+    // when the queue is stopped drops its element.
+    void push(T val) override {
+        wait(producer, consumer, [&]() { return pushOne(val); });
+    }
+
+    // Consumer only
+    bool tryPop(T& val) override {
+        if (!popOne(val)) {
+            return false;
+        }
+        wake(producer);
+        return true;
+    }
+
+    // Consumer only. Moves out up to n elements and returns how many that
+    // was, freeing their slots at once.
+    size_t popN(T* out, size_t n) {
+        size_t head = headPos.load(std::memory_order_relaxed);
+        if (cachedTail - head < n) {
+            cachedTail = tailPos.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(n, cachedTail - head);
+        for (size_t i = 0; i < count; i++) {
+            Slot& slot = slots[(head + i) & mask];
+            out[i] = std::move(*slot.value());
+            slot.value()->~T();
+        }
+        if (count > 0) {
+            headPos.store(head + count, std::memory_order_release);
+            wake(producer);
+        }
+        return count;
+    }
+
+    SharedPtr<T> tryPop() override {
+        T val;
+        if (!tryPop(val)) {
+            return {};
+        }
+        return makeShared<T>(std::move(val));
+    }
+
+    // Consumer only
+    bool waitAndPop(T& val) override {
+        return wait(consumer, producer, [&]() { return popOne(val); });
+    }
+
+    SharedPtr<T> waitAndPop() override {
+        T val;
+        if (!waitAndPop(val)) {
+            return {};
+        }
+        return makeShared<T>(std::move(val));
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Exact from either side, a snapshot from any other thread
+    size_t size() const {
+        return tailPos.load(std::memory_order_acquire) - headPos.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Wakes both sides if blocked and waits for them to return
+    void stop() {
+        shutdown.store(true);
+        for (Sleeper* sleeper: {&producer, &consumer}) {
+            std::scoped_lock lock{sleeper->m};
+            sleeper->cv.notify_all();
+        }
+        while (waiters.load() > 0) {
+            std::this_thread::yield();
+        }
+        shutdown.store(false);
+    }
+
+    ~SpscQueue() {
+        stop();
+        size_t tail = tailPos.load();
+        for (size_t head = headPos.load(); head != tail; head++) {
+            slots[head & mask].value()->~T();
+        }
+    }
+
+private:
+    bool pushOne(T& val) {
+        size_t tail = tailPos.load(std::memory_order_relaxed);
+        if (tail - cachedHead > mask) {
+            cachedHead = headPos.load(std::memory_order_acquire);
+            if (tail - cachedHead > mask) {
+                return false;
+            }
+        }
+        new (slots[tail & mask].storage) T(std::move(val));
+        tailPos.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool popOne(T& val) {
+        size_t head = headPos.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = tailPos.load(std::memory_order_acquire);
+            if (head == cachedTail) {
+                return false;
+            }
+        }
+        Slot& slot = slots[head & mask];
+        val = std::move(*slot.value());
+        slot.value()->~T();
+        headPos.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // The flag is read without a fence, so a call that is just going to
+    // sleep may be missed and left to wake up by itself
+    void wake(Sleeper& sleeper) {
+        if (sleeper.sleeping.load(std::memory_order_relaxed)) {
+            std::scoped_lock lock{sleeper.m};
+            sleeper.cv.notify_one();
+        }
+    }
+
+    // Retries attempt, which must not wake anyone as it may run under
+    // the sleeper's lock, and wakes the other side once it succeeds
+    template <typename Attempt>
+    bool wait(Sleeper& sleeper, Sleeper& other, Attempt attempt) {
+        for (int spin = 0; spin < SPIN_LIMIT; spin++) {
+            if (attempt()) {
+                wake(other);
+                return true;
+            }
+        }
+
+        waiters.fetch_add(1);
+        bool success;
+        while (!(success = attempt()) && !shutdown.load()) {
+            std::unique_lock lock{sleeper.m};
+            sleeper.sleeping.store(true);
+            if ((success = attempt())) {
+                sleeper.sleeping.store(false);
+                break;
+            }
+            sleeper.cv.wait_for(lock, MAX_SLEEP);
+            sleeper.sleeping.store(false);
+        }
+        waiters.fetch_sub(1);
+        if (success) {
+            wake(other);
+        }
+        return success;
+    }
+
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    // Written by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> headPos = 0;
+    size_t cachedTail = 0;
+    // Written by the producer
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tailPos = 0;
+    size_t cachedHead = 0;
+    alignas(CACHE_LINE_SIZE) Sleeper producer;
+    alignas(CACHE_LINE_SIZE) Sleeper consumer;
+    std::atomic<int> waiters = 0;
+    std::atomic<bool> shutdown = false;
+};
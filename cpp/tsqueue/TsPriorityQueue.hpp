@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ITsQueue.hpp"
+#include "Logger.hpp"
+#include "SharedPtr.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// TsQueue that pops the greatest element under Compare first. Elements
+// that compare equal come out in no particular order.
+template <typename T, typename Compare = std::less<T>>
+class TsPriorityQueue: public ITsQueue<T> {
+public:
+    void push(T val) override {
+        std::unique_lock<std::mutex> lock(m);
+        heap.push_back(std::move(val));
+        std::push_heap(heap.begin(), heap.end(), compare);
+        cv.notify_one();
+    }
+
+    bool waitAndPop(T& item) override {
+        std::unique_lock<std::mutex> lock(m);
+        counter++;
+        cv.wait(lock, [this]() { return !empty() || shutdown; });
+        if (shutdown) {
+            counter--;
+            syncCv.notify_all();
+            return false;
+        }
+
+        item = popTop();
+        counter--;
+        cv.notify_one();
+        return true;
+    }
+
+    SharedPtr<T> waitAndPop() override {
+        std::unique_lock<std::mutex> lock(m);
+        counter++;
+        cv.wait(lock, [this]() { return !empty() || shutdown; });
+        if (shutdown) {
+            counter--;
+            syncCv.notify_all();
+            return {};
+        }
+
+        SharedPtr<T> res = makeShared<T>(popTop());
+        counter--;
+        cv.notify_one();
+        return res;
+    }
+
+    bool tryPop(T& val) override {
+        std::unique_lock lock(m);
+        if (empty()) {
+            return false;
+        }
+        val = popTop();
+        return true;
+    }
+
+    SharedPtr<T> tryPop() override {
+        std::unique_lock lock(m);
+        if (empty()) {
+            return {};
+        }
+        return makeShared<T>(popTop());
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    void stop() {
+        LOG_DEBUG("Stopping queue. sync counter=%u", counter);
+        std::unique_lock<std::mutex> lock(m);
+        shutdown = true;
+        cv.notify_all();
+        syncCv.wait(lock, [this]() { return counter == 0; });
+        shutdown = false;
+    }
+
+    ~TsPriorityQueue() {
+        stop();
+    }
+
+private:
+    // Moved out of the heap rather than copied from top()
+    T popTop() {
+        std::pop_heap(heap.begin(), heap.end(), compare);
+        T top = std::move(heap.back());
+        heap.pop_back();
+        return top;
+    }
+
+    std::mutex m;
+    std::vector<T> heap;
+    Compare compare;
+    std::condition_variable cv;
+    std::condition_variable syncCv;
+    unsigned int counter = 0;
+    bool shutdown = false;
+};
@@ -4,58 +4,103 @@
 #include "Logger.hpp"
 #include "SharedPtr.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
-#include <queue>
+#include <cstddef>
+#include <deque>
+#include <limits>
 #include <mutex>
+#include <ranges>
+#include <type_traits>
+#include <utility>
 
+// Queue behind a single mutex. Consumers only get notified while some are
+// waiting, and the batch calls take the lock once for a whole range, so a
+// thread that drains everything pending per wakeup pays for one lock
+// acquisition instead of one per element.
 template <typename T>
 class TsQueue: public ITsQueue<T> {
 public:
+    static constexpr size_t ALL = std::numeric_limits<size_t>::max();
+
     void push(T val) override {
-        std::unique_lock<std::mutex> lock(m);
-        q.push(std::move(val));
-        cv.notify_one();
+        bool notify;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            q.push_back(std::move(val));
+            notify = counter > 0;
+        }
+        if (notify) {
+            cv.notify_one();
+        }
+    }
+
+    // Pushes every element of range under one lock, moving them out when
+    // range is an rvalue and copying them otherwise
+    template <std::ranges::input_range Range>
+    void pushBatch(Range&& range) {
+        size_t pushed = 0;
+        bool notify;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            for (auto&& val: range) {
+                if constexpr (std::is_lvalue_reference_v<Range>) {
+                    q.push_back(val);
+                } else {
+                    q.push_back(std::move(val));
+                }
+                pushed++;
+            }
+            notify = counter > 0;
+        }
+        if (!notify || pushed == 0) {
+            return;
+        }
+        if (pushed == 1) {
+            cv.notify_one();
+        } else {
+            cv.notify_all();
+        }
     }
 
     bool waitAndPop(T& item) override {
-        bool success = true;
         std::unique_lock<std::mutex> lock(m);
-        counter++;
-        LOG_DEBUG("Consume sync");
-        cv.wait(lock, [this]() { return !empty() || shutdown; });
-        if (shutdown) {
-            success = false;
-            counter--;
+        if (!waitForElement(lock)) {
             return false;
         }
 
         item = std::move(q.front());
-        q.pop();
-        counter--;
-        cv.notify_one();
+        q.pop_front();
         LOG_DEBUG("After consume. size=%zu", size());
         return true;
     }
 
     SharedPtr<T> waitAndPop() override {
-        bool success = true;
         std::unique_lock<std::mutex> lock(m);
-        counter++;
-        cv.wait(lock, [this]() { return !empty() || shutdown; });
-        if (shutdown) {
-            success = false;
-            counter--;
+        if (!waitForElement(lock)) {
             return {};
         }
 
-        SharedPtr<T> res{new T(std::move(q.front()))};
-        q.pop();
-        counter--;
-        cv.notify_one();
+        SharedPtr<T> res = makeShared<T>(std::move(q.front()));
+        q.pop_front();
         LOG_DEBUG("After consume. size=%zu", size());
         return res;
-       
-    } 
+    }
+
+    // Like waitAndPop, also returning false once timeout passes with the
+    // queue still empty
+    template <typename Rep, typename Period>
+    bool waitAndPopFor(T& item, std::chrono::duration<Rep, Period> timeout) {
+        std::unique_lock<std::mutex> lock(m);
+        if (!waitForElement(lock, std::chrono::steady_clock::now() + timeout)) {
+            return false;
+        }
+
+        item = std::move(q.front());
+        q.pop_front();
+        return true;
+    }
 
     bool tryPop(T& val) override {
         std::unique_lock lock(m);
@@ -64,7 +109,7 @@ public:
         }
 
         val = std::move(q.front());
-        q.pop();
+        q.pop_front();
         return true;
     }
 
@@ -74,11 +119,29 @@ public:
             return {};
         }
 
-        SharedPtr<T> res{new T{std::move(q.front())}};
-        q.pop();
+        SharedPtr<T> res = makeShared<T>(std::move(q.front()));
+        q.pop_front();
         return res;
     };
 
+    // Moves up to max elements to the back of out without waiting and
+    // returns how many that was. When out is empty and everything fits
+    // the two deques are swapped, so taking all pending elements costs the
+    // same however many there are.
+    size_t drain(std::deque<T>& out, size_t max = ALL) {
+        std::unique_lock lock(m);
+        size_t count = std::min(max, q.size());
+        if (count == q.size() && out.empty()) {
+            out.swap(q);
+            return count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            out.push_back(std::move(q.front()));
+            q.pop_front();
+        }
+        return count;
+    }
+
     bool empty() const {
         return q.empty();
     }
@@ -86,7 +149,7 @@ public:
     size_t size() const {
         return q.size();
     }
-    
+
     void stop() {
         LOG_DEBUG("Stopping queue. sync counter=%u", counter);
         std::unique_lock<std::mutex> lock(m);
@@ -99,10 +162,33 @@ public:
     ~TsQueue() {
         stop();
     }
-    
+
 private:
+    // Waits with m held until the queue has an element, returns false if
+    // the queue is stopped or the deadline passes first
+    bool waitForElement(std::unique_lock<std::mutex>& lock,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+        if (!empty()) {
+            return true;
+        }
+        counter++;
+        LOG_DEBUG("Consume sync");
+        auto ready = [this]() { return !empty() || shutdown; };
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            cv.wait(lock, ready);
+        } else {
+            cv.wait_until(lock, deadline, ready);
+        }
+        counter--;
+        if (shutdown) {
+            syncCv.notify_all();
+            return false;
+        }
+        return !empty();
+    }
+
     std::mutex m;
-    std::queue<T> q;
+    std::deque<T> q;
     std::condition_variable cv;
     std::condition_variable syncCv;
     unsigned int counter = 0;
@@ -1,26 +1,32 @@
+#include "Client.hpp"
 #include "Logger.hpp"
-#include "Network.hpp"
-#include "Util.hpp"
 
+#include <future>
 #include <iostream>
-#include <sys/socket.h>
-#include <unistd.h>
+#include <string>
+#include <vector>
 
 int main() {
-    int fd = connectToHost(nullptr, "8999");
-    if (fd == -1) {
-        LOG_ERROR("Error connecting to host");
+    Client client{nullptr, "8999"};
+    if (!client.connect()) {
+        LOG_ERROR("Error connecting to master");
         return 1;
     }
 
-    while (true) {
-        std::string line;
-        getline(std::cin, line);
-        std::cout << "Received: [" << line << "]\n";
-        if (!Send(fd, {line.c_str()})) {
-            continue;
-        }
+    // Every line is submitted as the payload of a task without waiting for
+    // the previous ones, results are printed in submission order
+    std::vector<std::future<TaskResult>> results;
+    std::string line;
+    while (getline(std::cin, line)) {
+        Scheduler::Task task;
+        task.set_type(Scheduler::TaskType::TASK_ONE);
+        task.set_payload(line);
+        results.push_back(client.submit(std::move(task)));
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        TaskResult result = results[i].get();
+        std::cout << "Task " << i << " success=" << result.success
+                << " result size=" << result.result.size() << "\n";
     }
-    
-    close(fd);
 }
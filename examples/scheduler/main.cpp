@@ -9,13 +9,19 @@ void sighandler(int s) {
     master1->stop();
 }
 
-void masterThread() {
+void masterThread(const char* stateDirectory) {
     Master master{nullptr, "8999"};
     master1 = &master;
     if (!master.init()) {
         LOG_ERROR("Error init master");
         return;
     }
+    if (stateDirectory != nullptr && !master.restore(stateDirectory)) {
+        LOG_ERROR("Error restoring master state");
+        return;
+    }
+    // Repeated cacheable tasks are served from the last few thousand results
+    master.enableResultCache(4096);
     if (!master.listen()) {
         LOG_ERROR("Error listening on master");
         return;
@@ -24,8 +30,10 @@ void masterThread() {
     LOG_INFO("Master thread ending!");
 }
 
-int main() {
+int main(int argc, char** argv) {
     LOG_INFO("Starting master");
-    std::thread t{masterThread};
+    // Tasks survive a restart when given a directory to log them to
+    const char* stateDirectory = argc > 1 ? argv[1] : nullptr;
+    std::thread t{masterThread, stateDirectory};
     t.join();
 }
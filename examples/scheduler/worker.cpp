@@ -4,11 +4,12 @@
 
 #include <thread>
 
-void runWorker(int s) {
-    Worker worker{nullptr, "8999", std::chrono::seconds{s}};
+void runWorker(int s, int capacity) {
+    Worker worker{nullptr, "8999", std::chrono::seconds{s}, capacity};
     if (!worker.connect()) {
         return;
     }
+    worker.setReconnectTimeout(std::chrono::seconds{60});
     worker.run();
 }
 
@@ -23,12 +24,17 @@ int main(int argc, char** argv) {
         char* arg = argv[2];
         s = atoi(arg);
     }
+    int capacity = 1;
+    if (argc > 3) {
+        char* arg = argv[3];
+        capacity = atoi(arg);
+    }
     LOG_INFO("Worker count=%d", cnt);
     Vector<std::thread> workers;
     using namespace std::chrono_literals;
     for (int i = 0; i < cnt; i++) {
         std::this_thread::sleep_for(2s);
-        workers.emplace_back(std::move(std::thread{runWorker, s}));
+        workers.emplace_back(std::move(std::thread{runWorker, s, capacity}));
     }
     for (auto& t: workers) {
         t.join();
@@ -1,4 +1,5 @@
 #include "Logger.hpp"
+#include "Network.hpp"
 #include "Util.hpp"
 
 #include <arpa/inet.h>
@@ -7,6 +8,7 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 int connectToHost(const char* hostname, const char* port) {
@@ -49,29 +51,108 @@ int connectToHost(const char* hostname, const char* port) {
     return fd;
 }
 
-bool Send(int fd, const String& s) {
-    if (send(fd, s.c_str(), s.size(), 0) == -1) {
-        LOG_ERROR("Error sending data errno=%d, msg=%s", errno, strerror(errno));
-        return false;
+static bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t bytes = send(fd, data, len, 0);
+        if (bytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Error sending data errno=%d, msg=%s", errno, strerror(errno));
+            return false;
+        }
+        data += bytes;
+        len -= bytes;
     }
+    return true;
+}
 
+static bool recvAll(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t bytes = recv(fd, data, len, 0);
+        if (bytes == 0) {
+            LOG_INFO("fd=%d socket disconnected", fd);
+            return false;
+        }
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Error receiving data for socket=%d errno=%d, msg=%s", fd, errno, strerror(errno));
+            return false;
+        }
+        data += bytes;
+        len -= bytes;
+    }
     return true;
 }
 
-bool Receive(int fd, String& s) {
-    char buffer[MAX_MESSAGE_SIZE];
-    ssize_t bytes = recv(fd, buffer, MAX_MESSAGE_SIZE, 0);
-    if (bytes == 0) {
-        LOG_INFO("workerFd=%d socket disconnected", fd);
+bool Send(int fd, const char* data, size_t len) {
+    if (len > MAX_MESSAGE_SIZE) {
+        LOG_ERROR("Message of size=%zu exceeds max message size=%u", len, MAX_MESSAGE_SIZE);
+        return false;
+    }
+
+    uint32_t header = htonl(static_cast<uint32_t>(len));
+    iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = FRAME_HEADER_SIZE;
+    iov[1].iov_base = const_cast<char*>(data);
+    iov[1].iov_len = len;
+
+    // Header and payload go out in a single syscall, only falling back
+    // to send for whatever remains after a short write
+    ssize_t bytes = writev(fd, iov, 2);
+    if (bytes == -1) {
+        if (errno != EINTR) {
+            LOG_ERROR("Error sending data errno=%d, msg=%s", errno, strerror(errno));
+            return false;
+        }
+        bytes = 0;
+    }
+
+    size_t written = static_cast<size_t>(bytes);
+    if (written < FRAME_HEADER_SIZE) {
+        const char* h = reinterpret_cast<const char*>(&header);
+        if (!sendAll(fd, h + written, FRAME_HEADER_SIZE - written)) {
+            return false;
+        }
+        written = FRAME_HEADER_SIZE;
+    }
+    written -= FRAME_HEADER_SIZE;
+    return sendAll(fd, data + written, len - written);
+}
+
+bool Send(int fd, const std::string& s) {
+    return Send(fd, s.data(), s.size());
+}
+
+bool Send(int fd, const String& s) {
+    return Send(fd, s.c_str(), s.size());
+}
+
+bool Receive(int fd, std::string& s) {
+    uint32_t header;
+    if (!recvAll(fd, reinterpret_cast<char*>(&header), FRAME_HEADER_SIZE)) {
         return false;
     }
 
-    if (bytes < 0) {
-        LOG_ERROR("Error sending data for socket=%d errno=%d, msg=%s", fd, errno, strerror(errno));
+    size_t len = ntohl(header);
+    if (len > MAX_MESSAGE_SIZE) {
+        LOG_ERROR("Received frame of size=%zu exceeding max message size=%u from socket=%d", len, MAX_MESSAGE_SIZE, fd);
         return false;
     }
 
-    s = {buffer, static_cast<size_t>(bytes)};
-    return true;
+    s.resize(len);
+    return recvAll(fd, s.data(), len);
 }
 
+bool Receive(int fd, String& s) {
+    std::string buffer;
+    if (!Receive(fd, buffer)) {
+        return false;
+    }
+
+    s = {buffer.data(), buffer.size()};
+    return true;
+}
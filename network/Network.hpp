@@ -2,6 +2,14 @@
 
 #include "String.hpp"
 
+#include <string>
+
 int connectToHost(const char* hostname, const char* port);
+
+// Messages are framed with a 4 byte big endian length prefix so that
+// several messages can be in flight on a stream socket at once
+bool Send(int fd, const char* data, size_t len);
+bool Send(int fd, const std::string& s);
 bool Send(int fd, const String& s);
+bool Receive(int fd, std::string& s);
 bool Receive(int fd, String& s);
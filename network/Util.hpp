@@ -1,3 +1,5 @@
+#pragma once
+
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -5,7 +7,10 @@
 #include <utility>
 #include <String.hpp>
 
-static constexpr unsigned int MAX_MESSAGE_SIZE = 256;
+// Largest frame accepted by Receive, large enough for a task payload of a
+// few megabytes. Results are streamed in smaller chunks.
+static constexpr unsigned int MAX_MESSAGE_SIZE = 8 * 1024 * 1024;
+static constexpr unsigned int FRAME_HEADER_SIZE = 4;
 
 inline std::pair<String, void*> getInAddr(struct addrinfo* sa) {
     if (sa->ai_family == AF_INET) {
@@ -0,0 +1,288 @@
+#include "Client.hpp"
+#include "Logger.hpp"
+#include "Network.hpp"
+#include "Protocol.hpp"
+#include "Vector.hpp"
+
+#include <algorithm>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Client::Client(const char* hostname, const char* port): hostname(hostname), port(port) {}
+
+void Client::setResumedHandler(ResumedHandler handler) {
+    resumedHandler = std::move(handler);
+}
+
+bool Client::connect(int session) {
+    // Joins the threads of a connection that was lost
+    close();
+
+    int rfd = connectToHost(hostname, port);
+    if (rfd == -1) {
+        LOG_ERROR("Client failed to connect");
+        return false;
+    }
+    fd = rfd;
+
+    if (!handshake(session)) {
+        LOG_ERROR("Client handshake with master failed");
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        shutdown = false;
+    }
+    sender = std::thread{&Client::sendLoop, this};
+    receiver = std::thread{&Client::receiveLoop, this};
+    return true;
+}
+
+bool Client::handshake(int session) {
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_CLIENT_HANDSHAKE_REQ);
+    if (session > 0) {
+        msg.mutable_heartbeat()->set_id(session);
+    }
+    if (!sendMessage(fd, msg)) {
+        return false;
+    }
+
+    std::string frame;
+    Scheduler::Message response;
+    if (!Receive(fd, frame) || !response.ParseFromString(frame)) {
+        return false;
+    }
+    if (response.type() != Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_RES) {
+        LOG_ERROR("Invalid response from master for client handshake");
+        return false;
+    }
+    sessionId = response.heartbeat().id();
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        if (response.heartbeat().has_next_request_id()) {
+            nextRequestId = std::max(nextRequestId, response.heartbeat().next_request_id());
+        }
+        resumedBelow = nextRequestId;
+    }
+    LOG_INFO("Client handshake success, assigned id=%d", sessionId);
+    return true;
+}
+
+std::future<TaskResult> Client::submit(Scheduler::Task task) {
+    std::future<TaskResult> future;
+    submit(std::move(task), future);
+    return future;
+}
+
+uint64_t Client::submit(Scheduler::Task task, std::future<TaskResult>& result) {
+    SharedPtr<Request> request = makeShared<Request>();
+    result = request->promise.get_future();
+    size_t size = task.payload().size();
+    uint64_t id;
+    {
+        std::unique_lock<std::mutex> lock{m};
+        cv.wait(lock, [&]{
+            return shutdown || pendingBytes == 0 || pendingBytes + size <= MAX_BATCH_BYTES;
+        });
+        if (shutdown) {
+            request->promise.set_value(TaskResult{});
+            return 0;
+        }
+
+        id = nextRequestId++;
+        task.set_id(id);
+        outstanding.insert({id, request});
+        *pending.mutable_task_batch()->add_tasks() = std::move(task);
+        pendingBytes += size;
+    }
+    cv.notify_all();
+    return id;
+}
+
+void Client::sendLoop() {
+    // Swapped with pending so that both keep their allocated tasks
+    Scheduler::Message batch;
+    std::string buffer;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{m};
+            cv.wait(lock, [this]{ return shutdown || pending.task_batch().tasks_size() > 0; });
+            if (shutdown) {
+                break;
+            }
+            batch.Swap(&pending);
+            pendingBytes = 0;
+        }
+        cv.notify_all();
+
+        batch.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_REQ);
+        if (!sendMessage(fd, batch, PROTOCOL_VERSION, buffer)) {
+            LOG_ERROR("Client error submitting %d tasks", batch.task_batch().tasks_size());
+            // Wakes the receiver, which fails everything outstanding
+            ::shutdown(fd, SHUT_RDWR);
+            break;
+        }
+        batch.Clear();
+    }
+    LOG_TRACE("Client send loop ended");
+}
+
+void Client::receiveLoop() {
+    std::string frame;
+    Scheduler::Message msg;
+    while (Receive(fd, frame)) {
+        if (!msg.ParseFromString(frame) || !upgradeMessage(msg)) {
+            LOG_ERROR("Client error deserializing message");
+            continue;
+        }
+
+        switch (msg.type()) {
+            case (Scheduler::MessageType::MESSAGE_TYPE_RESULT_CHUNK): {
+                handleChunk(msg.result_chunk());
+                break;
+            }
+            case (Scheduler::MessageType::MESSAGE_TYPE_TASK_RES): {
+                handleResponse(*msg.mutable_task_response());
+                break;
+            }
+            default: {
+                LOG_ERROR("Client invalid message type here type=%d", msg.type());
+                break;
+            }
+        }
+    }
+    LOG_INFO("Client connection to master closed");
+
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        shutdown = true;
+    }
+    cv.notify_all();
+    failOutstanding();
+}
+
+void Client::handleChunk(const Scheduler::ResultChunk& chunk) {
+    SharedPtr<Request> request;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        auto it = outstanding.find(chunk.id());
+        if (it != outstanding.end()) {
+            request = it->second;
+        }
+    }
+    if (!request) {
+        if (chunk.id() < resumedBelow && resumedHandler) {
+            handleResumedChunk(chunk);
+        } else {
+            LOG_ERROR("Client received a result chunk for unknown task=%llu", chunk.id());
+        }
+        return;
+    }
+
+    // Only the receiver touches the partial result. A stream starting over
+    // comes from another copy of the task after the first worker was lost.
+    if (chunk.offset() == 0) {
+        request->partial.clear();
+    } else if (chunk.offset() != request->partial.size()) {
+        LOG_ERROR("Client received a result chunk out of order for task=%llu", chunk.id());
+    }
+    request->partial.append(chunk.data());
+}
+
+void Client::handleResponse(Scheduler::TaskResponse& response) {
+    SharedPtr<Request> request;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        auto it = outstanding.find(response.id());
+        if (it != outstanding.end()) {
+            request = it->second;
+            outstanding.erase(response.id());
+        }
+    }
+    if (!request) {
+        if (response.id() < resumedBelow && resumedHandler) {
+            handleResumedResponse(response);
+        } else {
+            LOG_ERROR("Client received a response for unknown task=%llu", response.id());
+        }
+        return;
+    }
+
+    TaskResult result;
+    result.success = response.success();
+    if (response.has_result()) {
+        result.result = std::move(*response.mutable_result());
+    } else {
+        result.result = std::move(request->partial);
+    }
+    request->promise.set_value(std::move(result));
+}
+
+void Client::handleResumedChunk(const Scheduler::ResultChunk& chunk) {
+    auto it = resumedPartials.find(chunk.id());
+    if (it == resumedPartials.end()) {
+        it = resumedPartials.insert({chunk.id(), std::string{}}).first;
+    }
+    if (chunk.offset() == 0) {
+        it->second.clear();
+    }
+    it->second.append(chunk.data());
+}
+
+void Client::handleResumedResponse(Scheduler::TaskResponse& response) {
+    TaskResult result;
+    result.success = response.success();
+    if (response.has_result()) {
+        result.result = std::move(*response.mutable_result());
+    } else {
+        auto it = resumedPartials.find(response.id());
+        if (it != resumedPartials.end()) {
+            result.result = std::move(it->second);
+        }
+    }
+    resumedPartials.erase(response.id());
+    resumedHandler(response.id(), std::move(result));
+}
+
+void Client::failOutstanding() {
+    std::scoped_lock<std::mutex> lock{m};
+    Vector<uint64_t> ids;
+    for (auto& [id, request]: outstanding) {
+        request->promise.set_value(TaskResult{});
+        ids.push_back(id);
+    }
+    for (uint64_t id: ids) {
+        outstanding.erase(id);
+    }
+    // Tasks the sender never got to are not sent on a later connection
+    pending.Clear();
+    pendingBytes = 0;
+}
+
+void Client::close() {
+    if (fd == -1) {
+        return;
+    }
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        shutdown = true;
+    }
+    cv.notify_all();
+    ::shutdown(fd, SHUT_RDWR);
+    if (sender.joinable()) {
+        sender.join();
+    }
+    if (receiver.joinable()) {
+        receiver.join();
+    }
+    ::close(fd);
+    fd = -1;
+    failOutstanding();
+}
+
+Client::~Client() {
+    close();
+}
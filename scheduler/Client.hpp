@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Hashmap.hpp"
+#include "message.pb.h"
+#include "SharedPtr.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct TaskResult {
+    // Also false when the result could not be delivered, e.g. because the
+    // connection to the master was lost
+    bool success = false;
+    std::string result;
+};
+
+// Submits tasks to a master and hands back their results. Submissions are
+// pipelined: submit only queues the task, a sender thread writes whatever
+// has been queued as one batch and a receiver thread completes futures as
+// results come back, in whatever order they finish.
+class Client {
+    struct Request {
+        std::promise<TaskResult> promise;
+        // Streamed result reassembled here until the response arrives
+        std::string partial;
+    };
+
+public:
+    // Queued payload bytes past which submit waits for the sender to take
+    // the batch so that it stays well within a frame
+    static constexpr size_t MAX_BATCH_BYTES = 1024 * 1024;
+
+    // Gets results of requests submitted before the session was resumed,
+    // by the id they were submitted with
+    using ResumedHandler = std::function<void(uint64_t requestId, TaskResult result)>;
+
+    Client(const char* hostname, const char* port);
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    // Resuming a session, e.g. after the master restarted, routes results
+    // of tasks submitted in it to this client. The master's results carry
+    // the request ids they were submitted with, and the master says which
+    // id to continue from so new requests never reuse one. Can be called
+    // again once the connection is lost or closed, futures outstanding on
+    // the old connection have then already completed unsuccessfully.
+    bool connect(int session = -1);
+    // Called from the receiver thread, so has to be set before connect.
+    // Without one such results are dropped.
+    void setResumedHandler(ResumedHandler handler);
+    int session() const {
+        return sessionId;
+    }
+    std::future<TaskResult> submit(Scheduler::Task task);
+    // Same as above, returning the id the task was submitted with so that
+    // tasks submitted after it can depend on it
+    uint64_t submit(Scheduler::Task task, std::future<TaskResult>& result);
+    // Outstanding futures complete unsuccessfully
+    void close();
+    ~Client();
+
+private:
+    bool handshake(int session);
+    void sendLoop();
+    void receiveLoop();
+    void handleChunk(const Scheduler::ResultChunk& chunk);
+    void handleResponse(Scheduler::TaskResponse& response);
+    void handleResumedChunk(const Scheduler::ResultChunk& chunk);
+    void handleResumedResponse(Scheduler::TaskResponse& response);
+    void failOutstanding();
+    int fd = -1;
+    int sessionId = -1;
+    const char* hostname = nullptr;
+    const char* port = nullptr;
+    std::mutex m;
+    std::condition_variable cv;
+    // Tasks submitted since the sender last ran, swapped out in one go
+    Scheduler::Message pending;
+    size_t pendingBytes = 0;
+    // Keyed by the id the task was submitted with, the master echoes it
+    Hashmap<uint64_t, SharedPtr<Request>> outstanding;
+    uint64_t nextRequestId = 1;
+    // Ids below this were submitted before the current connection, only
+    // written before the receiver starts
+    uint64_t resumedBelow = 1;
+    ResumedHandler resumedHandler;
+    // Streamed results of such requests, only touched by the receiver
+    Hashmap<uint64_t, std::string> resumedPartials;
+    bool shutdown = false;
+    std::thread sender;
+    std::thread receiver;
+};
@@ -0,0 +1,39 @@
+#include "ClientRequests.hpp"
+
+#include <algorithm>
+
+bool ClientRequests::add(uint64_t requestId, uint64_t taskId) {
+    nextRequest = std::max(nextRequest, requestId + 1);
+    if (requests.contains(requestId)) {
+        return false;
+    }
+    requests.insert({requestId, taskId});
+    return true;
+}
+
+void ClientRequests::complete(uint64_t requestId, bool success) {
+    requests.erase(requestId);
+    if (success || failed.contains(requestId)) {
+        return;
+    }
+    failed.insert({requestId, true});
+    failedOrder.push_back(requestId);
+    if (failedOrder.size() > MAX_FAILED) {
+        failed.erase(failedOrder.front());
+        failedOrder.pop_front();
+    }
+}
+
+bool ClientRequests::resolve(const google::protobuf::RepeatedField<uint64_t>& dependsOn,
+        Vector<uint64_t>& dependencies) {
+    for (uint64_t dependency: dependsOn) {
+        if (failed.contains(dependency)) {
+            return false;
+        }
+        auto it = requests.find(dependency);
+        if (it != requests.end()) {
+            dependencies.push_back(it->second);
+        }
+    }
+    return true;
+}
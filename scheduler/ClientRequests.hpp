@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Hashmap.hpp"
+#include "Vector.hpp"
+
+#include <google/protobuf/repeated_field.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Ids one client submitted its pending tasks with, mapped to the task ids
+// they run as, along with its most recent requests that failed. Clients
+// name dependencies by their own ids and may submit a task after one it
+// depends on has already failed, which has to fail it too.
+class ClientRequests {
+public:
+    // Failed requests remembered per client. A dependency that failed
+    // longer ago than this is taken to have succeeded.
+    static constexpr size_t MAX_FAILED = 4096;
+
+    // Returns false, leaving the pending request as it is, if requestId is
+    // already pending
+    bool add(uint64_t requestId, uint64_t taskId);
+    // Forgets a request that is done, remembering it if it failed
+    void complete(uint64_t requestId, bool success);
+    // Appends the task ids of the pending requests among dependsOn to
+    // dependencies. Returns false if any of them failed. Those neither
+    // pending nor failed have succeeded already.
+    bool resolve(const google::protobuf::RepeatedField<uint64_t>& dependsOn, Vector<uint64_t>& dependencies);
+
+    size_t pending() const {
+        return requests.size();
+    }
+
+    // Past every id added so far, so a client resuming the session doesn't
+    // reuse the id of a request whose result is still to come
+    uint64_t nextRequestId() const {
+        return nextRequest;
+    }
+
+private:
+    Hashmap<uint64_t, uint64_t> requests;
+    // Used as a set, in the order they failed
+    Hashmap<uint64_t, bool> failed;
+    std::deque<uint64_t> failedOrder;
+    uint64_t nextRequest = 1;
+};
@@ -1,74 +1,573 @@
 #include "Distributor.hpp"
+#include "Logger.hpp"
 #include "message.pb.h"
-#include "Util.hpp"
+#include "Protocol.hpp"
 
 #include <thread>
 
-void Distributor::addTask(const Scheduler::Task& task) {
-    taskQueue.push(std::move(task));
+Distributor::Distributor(UniquePtr<IPlacementPolicy> policy, std::chrono::milliseconds taskTimeout,
+        double speculationFactor): policy(std::move(policy)), taskTimeout(taskTimeout),
+        speculationFactor(speculationFactor) {}
+
+uint64_t Distributor::addTask(Scheduler::Task task, uint64_t priority) {
+    if (!task.has_id()) {
+        task.set_id(reserveTaskId());
+    }
+    uint64_t id = task.id();
+    SharedPtr<InflightTask> entry = makeShared<InflightTask>();
+    entry->task = std::move(task);
+    entry->priority = priority;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        inflight.insert({id, entry});
+    }
+    taskQueue.push(QueuedTask{.id = id, .dispatch = 0, .speculative = false, .priority = priority});
+    return id;
+}
+
+uint64_t Distributor::reserveTaskId() {
+    return nextTaskId.fetch_add(1, std::memory_order::relaxed);
+}
+
+void Distributor::setNextTaskId(uint64_t nextTaskId) {
+    this->nextTaskId.store(nextTaskId, std::memory_order::relaxed);
+}
+
+void Distributor::addWorker(int workerFd, WorkerId id, uint32_t version, int capacity) {
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        workers.add(WorkerLoad{.id = id, .fd = workerFd, .capacity = capacity, .version = version,
+                .sendLock = makeShared<std::mutex>()});
+        policy->addWorker(id);
+    }
+    cv.notify_one();
+}
+
+void Distributor::removeWorker(WorkerId id) {
+    std::scoped_lock<std::mutex> lock{m};
+    if (workers.remove(id)) {
+        policy->removeWorker(id);
+    }
+
+    // Only happens on disconnect, so a scan of the table is fine
+    Vector<uint64_t> lost;
+    for (auto& [taskId, entry]: inflight) {
+        if (dropWorker(*entry, id) && entry->workers.size() == 0) {
+            lost.push_back(taskId);
+        }
+    }
+    for (uint64_t taskId: lost) {
+        SharedPtr<InflightTask> entry = inflight.at(taskId);
+        LOG_INFO("Task %llu lost with worker=%d", taskId, id);
+        fail(taskId, *entry);
+    }
+}
+
+void Distributor::adoptTasks(WorkerId id, const google::protobuf::RepeatedField<uint64_t>& taskIds) {
+    std::scoped_lock<std::mutex> lock{m};
+    WorkerLoad* worker = workers.find(id);
+    if (worker == nullptr) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    for (uint64_t taskId: taskIds) {
+        workers.acquire(*worker);
+        auto it = inflight.find(taskId);
+        if (it == inflight.end()) {
+            continue;
+        }
+        // Counts as a dispatch so that a queued copy is skipped
+        InflightTask& entry = *it->second;
+        entry.workers.push_back(id);
+        entry.dispatched = now;
+        entry.dispatches++;
+        armTimeout(entry, now);
+    }
+    LOG_INFO("Worker %d resumed with %d tasks", id, taskIds.size());
+}
+
+bool Distributor::claimResult(WorkerId id, uint64_t taskId) {
+    std::scoped_lock<std::mutex> lock{m};
+    auto it = inflight.find(taskId);
+    if (it == inflight.end()) {
+        return false;
+    }
+    InflightTask& entry = *it->second;
+    if (entry.owner == -1) {
+        entry.owner = id;
+    }
+    return entry.owner == id;
+}
+
+bool Distributor::completeTask(WorkerId id, uint64_t taskId) {
+    bool first = false;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        WorkerLoad* worker = workers.find(id);
+        if (worker != nullptr) {
+            workers.release(*worker);
+        }
+
+        auto it = inflight.find(taskId);
+        if (it != inflight.end()) {
+            SharedPtr<InflightTask> entry = it->second;
+            if (entry->owner == -1 || entry->owner == id) {
+                first = true;
+                // A result from a resumed worker may arrive before the
+                // task was ever dispatched
+                if (entry->dispatches > 0) {
+                    double duration = std::chrono::duration<double, std::milli>(
+                            Clock::now() - entry->dispatched).count();
+                    meanDuration = meanDuration == 0 ? duration : meanDuration + 0.1 * (duration - meanDuration);
+                }
+                releaseTimeout(*entry);
+                releaseStraggler(*entry);
+                inflight.erase(taskId);
+            } else {
+                dropWorker(*entry, id);
+            }
+        }
+    }
+    cv.notify_one();
+    return first;
+}
+
+void Distributor::updateLoad(WorkerId id, const Scheduler::HeartbeatData& data) {
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        WorkerLoad* worker = workers.find(id);
+        if (worker == nullptr) {
+            return;
+        }
+        if (data.has_capacity()) {
+            workers.setCapacity(*worker, data.capacity());
+        }
+        if (data.has_load()) {
+            worker->load = data.load();
+        }
+    }
+    cv.notify_one();
+}
+
+void Distributor::setSuspect(WorkerId id, bool suspect) {
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        WorkerLoad* worker = workers.find(id);
+        if (worker == nullptr || worker->suspect == suspect) {
+            return;
+        }
+        workers.setSuspect(*worker, suspect);
+    }
+    LOG_INFO("Worker %d is %s", id, suspect ? "suspected to have failed" : "no longer suspect");
+    cv.notify_one();
+}
+
+size_t Distributor::drainAbandoned(std::deque<uint64_t>& out) {
+    return abandoned.drain(out);
 }
 
-void Distributor::addWorker(int workerFd) {
-    workerQueue.push(workerFd);
+size_t Distributor::pendingTimeouts() {
+    std::scoped_lock<std::mutex> lock{m};
+    return timeouts.size();
+}
+
+size_t Distributor::pendingStragglers() {
+    std::scoped_lock<std::mutex> lock{m};
+    return stragglers.size();
 }
 
 void Distributor::start() {
     svcThread = std::thread{&Distributor::svc, this};
+    watchThread = std::thread{&Distributor::watch, this};
 }
 
 void Distributor::svc() {
     while (!shutdown) {
-        int workerFd;
-        bool success = workerQueue.waitAndPop(workerFd);
-        if (!success || shutdown) {
+        if (!waitForWorker()) {
             break;
         }
 
-        Scheduler::Task task;
-        success = taskQueue.waitAndPop(task);
+        QueuedTask queued;
+        bool success = taskQueue.waitAndPop(queued);
         if (!success || shutdown) {
             break;
         }
 
-        if (!sendTask(workerFd, task)) {
-            LOG_ERROR("Error in sending task, ending svc loop");
-            break;
+        // The worker that had a free slot may have gone away while we
+        // were waiting for a task, so placement waits again if needed.
+        // Speculative copies are only worth running on a free worker, and
+        // a task completed or dispatched again since it was queued is
+        // skipped.
+        WorkerLoad worker;
+        if (!acquireWorker(queued, worker, !queued.speculative)) {
+            continue;
+        }
+        uint32_t attempt;
+        if (SharedPtr<InflightTask> entry = track(worker, queued, attempt); entry.get() != nullptr) {
+            assign(worker, entry->task, attempt, queued.speculative);
         }
+
+        // Place whatever else is already queued while there are free
+        // slots so that it goes out in as few messages as possible
+        int placed = 1;
+        while (placed < MAX_BATCH_SIZE && hasCapacity() && taskQueue.tryPop(queued)) {
+            if (!acquireWorker(queued, worker, false)) {
+                if (!queued.speculative) {
+                    taskQueue.push(queued);
+                }
+                break;
+            }
+            if (SharedPtr<InflightTask> entry = track(worker, queued, attempt); entry.get() != nullptr) {
+                assign(worker, entry->task, attempt, queued.speculative);
+                placed++;
+            }
+        }
+
+        flush();
     }
 }
 
-bool Distributor::sendTask(int workerFd, const Scheduler::Task& task) {
-    Scheduler::Message msg;
-    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ);
+bool Distributor::waitForWorker() {
+    std::unique_lock<std::mutex> lock{m};
+    cv.wait(lock, [this]{ return workers.hasCapacity() || shutdown; });
+    return !shutdown;
+}
+
+bool Distributor::hasCapacity() {
+    std::scoped_lock<std::mutex> lock{m};
+    return workers.hasCapacity();
+}
 
-    std::string taskSerialized;
-    if (!task.SerializeToString(&taskSerialized)) {
-        LOG_ERROR("Error serializing task msg");
+bool Distributor::acquireWorker(const QueuedTask& queued, WorkerLoad& worker, bool block) {
+    std::unique_lock<std::mutex> lock{m};
+    WorkerLoad* selected = nullptr;
+    bool stale = false;
+    auto ready = [&]{
+        auto it = inflight.find(queued.id);
+        stale = it == inflight.end() || it->second->dispatches != queued.dispatch;
+        if (shutdown || stale) {
+            return true;
+        }
+        selected = select(*it->second, queued.speculative);
+        return selected != nullptr;
+    };
+    if (!ready() && !block) {
+        return false;
+    }
+    cv.wait(lock, ready);
+    if (shutdown || stale) {
         return false;
     }
 
-    msg.set_data(taskSerialized);
+    workers.acquire(*selected);
+    worker = *selected;
+    return true;
+}
 
-    std::string buffer;
-    if (!msg.SerializeToString(&buffer)) {
-        LOG_ERROR("Error serializing data to string. workerFd=%d", workerFd);
-        return false;
+WorkerLoad* Distributor::select(InflightTask& entry, bool speculative) {
+    WorkerLoad* selected = policy->select(entry.task, workers);
+    if (selected == nullptr || entry.workers.size() == 0) {
+        return selected;
     }
 
-    if (send(workerFd, buffer.data(), buffer.size(), 0) == -1) {
-        LOG_ERROR("Error sending data to worker=%d", workerFd);
+    // A task dispatched again should go to a worker that isn't already
+    // running it, if there is one with a free slot
+    auto isRunning = [&entry](WorkerId id) {
+        for (size_t i = 0; i < entry.workers.size(); i++) {
+            if (entry.workers[i] == id) {
+                return true;
+            }
+        }
         return false;
+    };
+    if (!isRunning(selected->id)) {
+        return selected;
+    }
+
+    WorkerLoad* best = nullptr;
+    for (size_t i = 0; i < workers.size(); i++) {
+        WorkerLoad& w = workers[i];
+        if (w.spare() > 0 && !isRunning(w.id) && (best == nullptr || lessLoaded(w, *best))) {
+            best = &w;
+        }
+    }
+    if (best != nullptr || speculative) {
+        return best;
+    }
+    return selected;
+}
+
+SharedPtr<Distributor::InflightTask> Distributor::track(const WorkerLoad& worker, const QueuedTask& queued,
+        uint32_t& attempt) {
+    std::scoped_lock<std::mutex> lock{m};
+    auto it = inflight.find(queued.id);
+    if (it == inflight.end() || it->second->dispatches != queued.dispatch) {
+        // Completed or dispatched again since it was placed
+        WorkerLoad* w = workers.find(worker.id);
+        if (w != nullptr) {
+            workers.release(*w);
+        }
+        return SharedPtr<InflightTask>{nullptr};
+    }
+
+    // The table keeps the task alive until it completes, and the copy
+    // holds on to it in case that happens before it is assigned
+    SharedPtr<InflightTask> entry = it->second;
+    Clock::time_point now = Clock::now();
+    attempt = entry->dispatches;
+    entry->workers.push_back(worker.id);
+    entry->dispatched = now;
+    entry->dispatches++;
+    armTimeout(*entry, now);
+    releaseStraggler(*entry);
+    if (speculationFactor > 0 && !entry->speculated) {
+        entry->straggler = stragglers.insert(stragglers.end(), Deadline{.dispatched = now, .taskId = queued.id});
+    }
+    return entry;
+}
+
+void Distributor::assign(const WorkerLoad& worker, const Scheduler::Task& task, uint32_t attempt,
+        bool speculative) {
+    size_t bytes = task.payload().size();
+    Assignment* assignment = nullptr;
+    for (Assignment& a: assignments) {
+        if (a.id == worker.id && a.bytes + bytes <= MAX_BATCH_BYTES) {
+            a.bytes += bytes;
+            assignment = &a;
+            break;
+        }
+    }
+    if (assignment == nullptr) {
+        assignment = &assignments.emplace_back(Assignment{
+            .id = worker.id, .fd = worker.fd, .sendLock = worker.sendLock, .version = worker.version,
+            .bytes = bytes, .msg = arena.create<Scheduler::Message>()});
+    }
+
+    // Copies are marked so that workers and logs can tell them apart
+    Scheduler::Task* copy = assignment->msg->mutable_task_batch()->add_tasks();
+    *copy = task;
+    if (attempt > 0) {
+        copy->set_attempt(attempt);
     }
+    if (speculative) {
+        copy->set_speculative(true);
+    }
+}
 
+void Distributor::flush() {
+    for (Assignment& a: assignments) {
+        if (!sendAssignment(a)) {
+            requeue(a);
+        }
+    }
+    assignments.clear();
+    arena.reset();
+}
+
+bool Distributor::sendAssignment(Assignment& a) {
+    Scheduler::TaskBatch* batch = a.msg->mutable_task_batch();
+    if (batch->tasks_size() == 1) {
+        // A lone task is sent as is, moving it out of the batch rather
+        // than copying it
+        Scheduler::Task* task = batch->mutable_tasks()->UnsafeArenaReleaseLast();
+        a.msg->set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ);
+        a.msg->unsafe_arena_set_allocated_task(task);
+    } else {
+        a.msg->set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_REQ);
+    }
+
+    std::scoped_lock<std::mutex> lock{*a.sendLock};
+    if (!sendMessage(a.fd, *a.msg, a.version, arena.sendBuffer())) {
+        LOG_ERROR("Error sending tasks to worker=%d", a.id);
+        return false;
+    }
     return true;
 }
 
+bool Distributor::sendToWorker(WorkerId id, Scheduler::Message& msg, std::string& buffer) {
+    WorkerLoad worker;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        WorkerLoad* found = workers.find(id);
+        if (found == nullptr) {
+            return false;
+        }
+        worker = *found;
+    }
+    std::scoped_lock<std::mutex> lock{*worker.sendLock};
+    return sendMessage(worker.fd, msg, worker.version, buffer);
+}
+
+void Distributor::requeue(Assignment& a) {
+    // The message may have been downgraded for a version 1 peer
+    if (!upgradeMessage(*a.msg)) {
+        return;
+    }
+
+    Vector<uint64_t> ids;
+    if (a.msg->has_task()) {
+        ids.push_back(a.msg->task().id());
+    } else {
+        for (const Scheduler::Task& task: a.msg->task_batch().tasks()) {
+            ids.push_back(task.id());
+        }
+    }
+    LOG_ERROR("Requeueing %zu tasks from worker=%d", ids.size(), a.id);
+
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        WorkerLoad* worker = workers.find(a.id);
+        for (uint64_t id: ids) {
+            if (worker != nullptr) {
+                workers.release(*worker);
+            }
+            auto it = inflight.find(id);
+            if (it == inflight.end()) {
+                continue;
+            }
+            InflightTask& entry = *it->second;
+            if (dropWorker(entry, a.id) && entry.workers.size() == 0) {
+                redispatch(entry);
+            }
+        }
+    }
+    cv.notify_one();
+}
+
+bool Distributor::dropWorker(InflightTask& entry, WorkerId id) {
+    for (size_t i = 0; i < entry.workers.size(); i++) {
+        if (entry.workers[i] == id) {
+            entry.workers[i] = entry.workers[entry.workers.size() - 1];
+            entry.workers.pop_back();
+            if (entry.owner == id) {
+                entry.owner = -1;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void Distributor::redispatch(InflightTask& entry, bool speculative) {
+    releaseStraggler(entry);
+    // Skipped if the task completes or is dispatched again before this
+    // comes up
+    taskQueue.push(QueuedTask{.id = entry.task.id(), .dispatch = entry.dispatches,
+            .speculative = speculative, .priority = entry.priority});
+}
+
+void Distributor::fail(uint64_t taskId, InflightTask& entry) {
+    entry.failures++;
+    if (entry.failures < MAX_FAILURES) {
+        // Armed again when the task is
+        timeouts.cancel(entry.timer);
+        redispatch(entry);
+        return;
+    }
+    LOG_ERROR("Abandoning task %llu after %u failures", taskId, entry.failures);
+    releaseTimeout(entry);
+    releaseStraggler(entry);
+    inflight.erase(taskId);
+    abandoned.push(taskId);
+}
+
+void Distributor::armTimeout(InflightTask& entry, Clock::time_point now) {
+    if (entry.timer == -1) {
+        if (freeTimers.size() > 0) {
+            entry.timer = freeTimers[freeTimers.size() - 1];
+            freeTimers.pop_back();
+        } else {
+            entry.timer = timerTasks.size();
+            timerTasks.push_back(0);
+        }
+        timerTasks[entry.timer] = entry.task.id();
+    }
+    // Rounded up so that a task never times out early
+    timeouts.schedule(entry.timer, tick(now + taskTimeout) + 1);
+}
+
+void Distributor::releaseTimeout(InflightTask& entry) {
+    if (entry.timer == -1) {
+        return;
+    }
+    timeouts.cancel(entry.timer);
+    freeTimers.push_back(entry.timer);
+    entry.timer = -1;
+}
+
+void Distributor::releaseStraggler(InflightTask& entry) {
+    if (!entry.straggler.has_value()) {
+        return;
+    }
+    stragglers.erase(*entry.straggler);
+    entry.straggler.reset();
+}
+
+uint64_t Distributor::tick(Clock::time_point time) const {
+    return (time - epoch) / WATCH_INTERVAL;
+}
+
+void Distributor::watch() {
+    std::unique_lock<std::mutex> lock{m};
+    while (!shutdown) {
+        watchCv.wait_for(lock, WATCH_INTERVAL, [this]{ return shutdown; });
+        if (shutdown) {
+            break;
+        }
+        Clock::time_point now = Clock::now();
+        checkTimeouts(now);
+        checkStragglers(now);
+    }
+}
+
+void Distributor::checkTimeouts(Clock::time_point now) {
+    // Timers are given back when their task leaves the table, so every one
+    // that fires is for a task still in it
+    Vector<uint64_t> expired;
+    timeouts.advance(tick(now), [&](int timer) {
+        expired.push_back(timerTasks[timer]);
+    });
+    for (uint64_t taskId: expired) {
+        // The worker keeps its slot, it may still be running the task
+        SharedPtr<InflightTask> entry = inflight.at(taskId);
+        LOG_INFO("Task %llu timed out", taskId);
+        fail(taskId, *entry);
+    }
+}
+
+void Distributor::checkStragglers(Clock::time_point now) {
+    if (speculationFactor <= 0 || meanDuration == 0) {
+        return;
+    }
+
+    std::chrono::duration<double, std::milli> threshold{meanDuration * speculationFactor};
+    // Deadlines leave with their dispatch, so every one here is for a task
+    // still running
+    while (!stragglers.empty() && now - stragglers.front().dispatched >= threshold) {
+        // Try again once a slot frees up
+        if (!workers.hasCapacity()) {
+            break;
+        }
+        uint64_t taskId = stragglers.front().taskId;
+        SharedPtr<InflightTask> entry = inflight.at(taskId);
+        LOG_INFO("Task %llu is straggling, running a speculative copy", taskId);
+        entry->speculated = true;
+        redispatch(*entry, true);
+    }
+}
+
 void Distributor::stop() {
-    shutdown = true;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        shutdown = true;
+    }
+    cv.notify_all();
+    watchCv.notify_all();
     taskQueue.stop();
-    workerQueue.stop();
     if (svcThread.joinable()) {
         svcThread.join();
     }
+    if (watchThread.joinable()) {
+        watchThread.join();
+    }
 }
-
@@ -1,22 +1,198 @@
 #pragma once
 
 #include "message.pb.h"
+#include "MessageArena.hpp"
+#include "PlacementPolicy.hpp"
+#include "Protocol.hpp"
+#include "SharedPtr.hpp"
+#include "TimerWheel.hpp"
+#include "TsPriorityQueue.hpp"
 #include "TsQueue.hpp"
+#include "UniquePtr.hpp"
+#include "Vector.hpp"
+#include "Worker.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
 
 class Distributor {
+    using Clock = std::chrono::steady_clock;
+
+    struct Assignment {
+        WorkerId id;
+        int fd;
+        SharedPtr<std::mutex> sendLock;
+        uint32_t version;
+        // Payload bytes batched so far
+        size_t bytes;
+        // Allocated on the distributor's arena
+        Scheduler::Message* msg;
+    };
+
+    struct Deadline {
+        Clock::time_point dispatched;
+        uint64_t taskId;
+    };
+
+    // A task that has not produced a result yet, from when it is added
+    // until its result is in or it is abandoned
+    struct InflightTask {
+        Scheduler::Task task;
+        // Workers running a copy of the task, none while it is queued. More
+        // than one after a timeout or once it has been speculated on.
+        Vector<WorkerId> workers;
+        // Worker whose result is relayed, the first one to send any of it
+        WorkerId owner = -1;
+        Clock::time_point dispatched;
+        // Bumped on every dispatch so that stale queue entries can be
+        // skipped
+        uint32_t dispatches = 0;
+        uint32_t failures = 0;
+        bool speculated = false;
+        uint64_t priority = 0;
+        // Id of the task's timeout on the wheel, taken on its first
+        // dispatch and given back once the task leaves the table
+        int timer = -1;
+        // Its place among the stragglers while it runs and has not been
+        // speculated on
+        std::optional<std::list<Deadline>::iterator> straggler;
+    };
+
+    // The queue only holds ids, tasks live in the in flight table
+    struct QueuedTask {
+        uint64_t id;
+        // Dispatches of the task when it was queued
+        uint32_t dispatch;
+        bool speculative;
+        uint64_t priority;
+    };
+
+    // Higher priority first, then older tasks first
+    struct QueueOrder {
+        bool operator()(const QueuedTask& a, const QueuedTask& b) const {
+            return a.priority < b.priority || (a.priority == b.priority && a.id > b.id);
+        }
+    };
+
 public:
-    void addTask(const Scheduler::Task& task);
-    void addWorker(int workerFd);
+    // Upper bound on the number of tasks sent to a worker in one message
+    static constexpr int MAX_BATCH_SIZE = 64;
+    // Payload bytes past which a batch is closed so that batches stay well
+    // within a frame. A single larger payload is still sent on its own.
+    static constexpr size_t MAX_BATCH_BYTES = 256 * 1024;
+    // Times a task may time out or lose its worker before it is abandoned
+    static constexpr uint32_t MAX_FAILURES = 3;
+    // How often in flight tasks are checked for timeouts and stragglers
+    static constexpr std::chrono::milliseconds WATCH_INTERVAL{100};
+
+    // A task that has not completed within taskTimeout is dispatched
+    // again. With a speculationFactor, a task running for that many times
+    // the mean task duration is duplicated onto another worker with a free
+    // slot and the first result wins. 0 disables speculation.
+    Distributor(UniquePtr<IPlacementPolicy> policy = UniquePtr<IPlacementPolicy>{new LeastLoadedPolicy},
+            std::chrono::milliseconds taskTimeout = std::chrono::minutes{5},
+            double speculationFactor = 0);
+    // Returns the id assigned to the task. Tasks that already have an id,
+    // such as reserved ones or those restored from a log, keep it. Queued
+    // tasks are dispatched highest priority first.
+    uint64_t addTask(Scheduler::Task task, uint64_t priority = 0);
+    uint64_t reserveTaskId();
+    // Ids handed out from here on start at nextTaskId
+    void setNextTaskId(uint64_t nextTaskId);
+    void addWorker(int workerFd, WorkerId id, uint32_t version = PROTOCOL_VERSION, int capacity = 1);
+    // Tasks that were only running on the worker are dispatched again
+    void removeWorker(WorkerId id);
+    // Records that a worker resuming its session is still running or
+    // holding the results of these tasks, so that they are not dispatched
+    // again. Takes a slot on the worker for every id as each is answered.
+    void adoptTasks(WorkerId id, const google::protobuf::RepeatedField<uint64_t>& taskIds);
+    // Claims a task's result for a worker. Returns false if another copy
+    // of the task already started sending its result.
+    bool claimResult(WorkerId id, uint64_t taskId);
+    // Frees the worker's slot. Returns true if this is the task's result,
+    // false if it is a late duplicate that should be dropped.
+    bool completeTask(WorkerId id, uint64_t taskId);
+    void updateLoad(WorkerId id, const Scheduler::HeartbeatData& data);
+    // Sends msg to the worker in between the task batches the distributor
+    // sends it, so frames written from other threads never interleave with
+    // them. Returns false if the worker is gone or the write failed.
+    bool sendToWorker(WorkerId id, Scheduler::Message& msg, std::string& buffer);
+    // Suspect workers keep their tasks but are not given new ones
+    void setSuspect(WorkerId id, bool suspect);
+    // Moves the tasks given up on after MAX_FAILURES to out, returns how
+    // many there were
+    size_t drainAbandoned(std::deque<uint64_t>& out);
+    // Dispatched tasks with a timeout armed
+    size_t pendingTimeouts();
+    // Running tasks that may still be speculated on
+    size_t pendingStragglers();
     void svc();
     void start();
     void stop();
 
 private:
-    bool sendTask(int workerFd, const Scheduler::Task& task);
-    TsQueue<Scheduler::Task> taskQueue;
-    TsQueue<int> workerQueue;
+    bool waitForWorker();
+    bool hasCapacity();
+    bool acquireWorker(const QueuedTask& queued, WorkerLoad& worker, bool block = true);
+    WorkerLoad* select(InflightTask& entry, bool speculative);
+    SharedPtr<InflightTask> track(const WorkerLoad& worker, const QueuedTask& queued, uint32_t& attempt);
+    void assign(const WorkerLoad& worker, const Scheduler::Task& task, uint32_t attempt, bool speculative);
+    void flush();
+    bool sendAssignment(Assignment& a);
+    void requeue(Assignment& a);
+    bool dropWorker(InflightTask& entry, WorkerId id);
+    void redispatch(InflightTask& entry, bool speculative = false);
+    void fail(uint64_t taskId, InflightTask& entry);
+    // Arms the task's timeout taskTimeout from now
+    void armTimeout(InflightTask& entry, Clock::time_point now);
+    // Gives back the task's timer as it leaves the table
+    void releaseTimeout(InflightTask& entry);
+    // Takes the task out of the stragglers once it is no longer running
+    // the dispatch they hold
+    void releaseStraggler(InflightTask& entry);
+    uint64_t tick(Clock::time_point time) const;
+    void watch();
+    void checkTimeouts(Clock::time_point now);
+    void checkStragglers(Clock::time_point now);
+    TsPriorityQueue<QueuedTask, QueueOrder> taskQueue;
+    // Tasks placed during the current wakeup, grouped by worker
+    Vector<Assignment> assignments;
+    MessageArena arena;
+    std::atomic<uint64_t> nextTaskId = 1;
+    WorkerPool workers;
+    UniquePtr<IPlacementPolicy> policy;
+    // Everything below is guarded by m
+    Hashmap<uint64_t, SharedPtr<InflightTask>> inflight;
+    // One timer per dispatched task, cancelled when it completes, ticking
+    // every WATCH_INTERVAL from when the distributor was created
+    TimerWheel timeouts;
+    Clock::time_point epoch = Clock::now();
+    // Task each timer is for, and the timers no task holds
+    Vector<uint64_t> timerTasks;
+    Vector<int> freeTimers;
+    // Dispatches in the order they happened, which is also the order they
+    // start straggling in. Each is removed as its task completes or is
+    // dispatched again, so only running tasks are in here.
+    std::list<Deadline> stragglers;
+    std::chrono::milliseconds taskTimeout;
+    double speculationFactor;
+    // Moving average of how long tasks take, in milliseconds
+    double meanDuration = 0;
+    TsQueue<uint64_t> abandoned;
+    std::mutex m;
+    std::condition_variable cv;
+    // Separate so that the watcher never takes a wakeup meant for svc
+    std::condition_variable watchCv;
     bool shutdown = false;
     std::thread svcThread;
+    std::thread watchThread;
 };
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// FNV-1a, used wherever a key has to hash to the same value in every
+// process (std::hash makes no such promise).
+inline uint64_t fnv1a(std::string_view s) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c: s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Finalizer of MurmurHash3. FNV leaves similar strings, like consecutive
+// ids, close together, this spreads them over the whole range.
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
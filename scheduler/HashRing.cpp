@@ -0,0 +1,41 @@
+#include "HashRing.hpp"
+#include "Hash.hpp"
+
+#include <string>
+
+uint64_t HashRing::pointHash(int node, int replica) const {
+    std::string s = std::to_string(node) + "#" + std::to_string(replica);
+    return mix64(fnv1a(s));
+}
+
+void HashRing::add(int node) {
+    for (int i = 0; i < virtualNodes; i++) {
+        ring[pointHash(node, i)] = node;
+    }
+}
+
+void HashRing::remove(int node) {
+    for (int i = 0; i < virtualNodes; i++) {
+        auto it = ring.find(pointHash(node, i));
+        if (it != ring.end() && it->second == node) {
+            ring.erase(it);
+        }
+    }
+}
+
+int HashRing::lookup(uint64_t hash, const std::function<bool(int)>& accept) const {
+    if (ring.empty()) {
+        return -1;
+    }
+
+    auto it = ring.lower_bound(hash);
+    for (size_t visited = 0; visited < ring.size(); visited++, it++) {
+        if (it == ring.end()) {
+            it = ring.begin();
+        }
+        if (!accept || accept(it->second)) {
+            return it->second;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+
+// Consistent hashing ring with virtual nodes.
+class HashRing {
+public:
+    explicit HashRing(int virtualNodes = 64): virtualNodes(virtualNodes) {}
+
+    void add(int node);
+    void remove(int node);
+
+    // Walks clockwise from hash and returns the first node for which
+    // accept returns true, or -1 if no node is accepted.
+    int lookup(uint64_t hash, const std::function<bool(int)>& accept = {}) const;
+
+    bool empty() const {
+        return ring.empty();
+    }
+
+    size_t size() const {
+        return ring.size() / virtualNodes;
+    }
+
+private:
+    uint64_t pointHash(int node, int replica) const;
+
+    std::map<uint64_t, int> ring;
+    int virtualNodes;
+};
@@ -1,60 +1,184 @@
-#include "Hashmap.hpp"
 #include "Worker.hpp"
 #include "Master.hpp"
 #include "HeartbeatMonitor.hpp"
+#include "PhiAccrual.hpp"
 #include "Vector.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <mutex>
 
-HeartbeatMonitor::HeartbeatMonitor(Master* master, std::chrono::seconds expirationTime):
-        master(master), expirationTime(expirationTime) {}
+HeartbeatMonitor::HeartbeatMonitor(Master* master, std::chrono::milliseconds heartbeatInterval,
+        int maxWorkers): master(master), slots(new Slot[maxWorkers]), maxWorkers(maxWorkers),
+        defaultInterval(heartbeatInterval), suspectDeviations(phiDeviations(SUSPECT_PHI)),
+        failDeviations(phiDeviations(FAIL_PHI)), start(Clock::now()) {
+    for (int i = 0; i < maxWorkers; i++) {
+        slots[i].lastHeartbeat.store(INACTIVE, std::memory_order::relaxed);
+    }
+}
+
+HeartbeatMonitor::Clock::rep HeartbeatMonitor::elapsed() const {
+    return (Clock::now() - start).count();
+}
+
+uint64_t HeartbeatMonitor::deadline(const Slot& slot, Clock::rep lastHeartbeat, double deviations) const {
+    double mean = slot.mean.load(std::memory_order::relaxed);
+    double stdDev = std::max(std::sqrt(slot.variance.load(std::memory_order::relaxed)), MIN_STD_DEV.count());
+    Millis silence{mean + deviations * stdDev};
+    Clock::duration time = Clock::duration{lastHeartbeat} +
+            std::chrono::duration_cast<Clock::duration>(silence);
+    // Rounded up so that a worker is never acted on early
+    return time / TICK + 1;
+}
+
+bool HeartbeatMonitor::validId(WorkerId id) const {
+    if (id < 0 || id >= maxWorkers) {
+        LOG_ERROR("Worker id=%d out of range of the heartbeat monitor", id);
+        return false;
+    }
+    return true;
+}
 
 void HeartbeatMonitor::registerHeartbeat(WorkerId id) {
-    std::scoped_lock<std::mutex> lock{m};
-    if (!workers.contains(id)) {
+    if (!validId(id)) {
+        return;
+    }
+    Slot& slot = slots[id];
+    Clock::rep lastHeartbeat = slot.lastHeartbeat.load(std::memory_order::relaxed);
+    if (lastHeartbeat == INACTIVE) {
         LOG_ERROR("Registering heartbeat for invalid worker id=%d", id);
         return;
     }
 
-    workers.insert({id, getNow()});
+    Clock::rep now = elapsed();
+    ArrivalEstimate estimate{
+        .mean = slot.mean.load(std::memory_order::relaxed),
+        .variance = slot.variance.load(std::memory_order::relaxed)};
+    // Every frame from a worker is registered, but it only promises one
+    // per interval, so shorter gaps say nothing about how long a silence
+    // to expect and are counted as a full interval
+    Millis interval{Clock::duration{now - lastHeartbeat}};
+    estimate.add(std::max(interval.count(), slot.interval.load(std::memory_order::relaxed)));
+    slot.mean.store(estimate.mean, std::memory_order::relaxed);
+    slot.variance.store(estimate.variance, std::memory_order::relaxed);
+    slot.lastHeartbeat.store(now, std::memory_order::relaxed);
+
+    if (slot.suspect.load(std::memory_order::relaxed)) {
+        setSuspect(id, false);
+    }
 }
 
 void HeartbeatMonitor::addWorker(WorkerId id) {
+    addWorker(id, std::chrono::duration_cast<std::chrono::milliseconds>(defaultInterval));
+}
+
+void HeartbeatMonitor::addWorker(WorkerId id, std::chrono::milliseconds heartbeatInterval) {
+    if (!validId(id)) {
+        return;
+    }
+    // Seeded with a quarter of the interval as the deviation until the
+    // worker's own heartbeats have been seen
+    Slot& slot = slots[id];
+    Clock::rep now = elapsed();
+    double interval = Millis{heartbeatInterval}.count();
+    slot.interval.store(interval, std::memory_order::relaxed);
+    slot.mean.store(interval, std::memory_order::relaxed);
+    slot.variance.store(std::pow(interval / 4, 2), std::memory_order::relaxed);
+    slot.suspect.store(false, std::memory_order::relaxed);
+    slot.lastHeartbeat.store(now, std::memory_order::relaxed);
+
     std::scoped_lock<std::mutex> lock{m};
-    workers.insert({id, getNow()});
+    wheel.schedule(id, deadline(slot, now, suspectDeviations));
     cv.notify_one();
 }
 
 void HeartbeatMonitor::disconnectWorker(WorkerId id) {
-    workers.erase(id);
+    if (!validId(id)) {
+        return;
+    }
+    slots[id].lastHeartbeat.store(INACTIVE, std::memory_order::relaxed);
+    std::scoped_lock<std::mutex> lock{m};
+    wheel.cancel(id);
 }
 
-void HeartbeatMonitor::checkWorkers() {
-    LOG_TRACE("Checking workers now. Number of workers=%zu", workers.size());
-    Vector<WorkerId> disconnectedWorkers;
-    for (auto& [k, v]: workers) {
-        Timepoint now = getNow();
-        std::chrono::seconds x = std::chrono::duration_cast<std::chrono::seconds>(now - v);
-        LOG_TRACE("Worker %d: now - last heartbeat = %llds", k, x.count());
-        if (hasExpired(x)) {
-            disconnectedWorkers.push_back(k);
-        }
+bool HeartbeatMonitor::suspected(WorkerId id) const {
+    return validId(id) && slots[id].suspect.load(std::memory_order::relaxed);
+}
+
+bool HeartbeatMonitor::failed(WorkerId id) const {
+    if (!validId(id)) {
+        return false;
     }
+    const Slot& slot = slots[id];
+    Clock::rep lastHeartbeat = slot.lastHeartbeat.load(std::memory_order::relaxed);
+    return lastHeartbeat != INACTIVE &&
+            deadline(slot, lastHeartbeat, failDeviations) <= Clock::duration{elapsed()} / TICK;
+}
 
-    for (WorkerId id: disconnectedWorkers) {
-        master->handleDisconnect(id);
+void HeartbeatMonitor::setSuspect(WorkerId id, bool suspect) {
+    // Both the event loop and the monitor may clear a suspicion, only the
+    // first one to do so passes it on
+    if (slots[id].suspect.exchange(suspect, std::memory_order::relaxed) != suspect) {
+        master->distributor.setSuspect(id, suspect);
     }
 }
 
 void HeartbeatMonitor::svc() {
+    std::unique_lock<std::mutex> lock{m};
     while (!shutdown) {
-        using namespace std::chrono_literals;
-        std::this_thread::sleep_for(5s);
-        std::unique_lock<std::mutex> lock{m};
-        cv.wait(lock, [this]{ return workers.size() != 0 || shutdown; });
+        cv.wait(lock, [this]{ return wheel.size() != 0 || shutdown; });
+        cv.wait_for(lock, TICK, [this]{ return shutdown; });
         if (shutdown) break;
-        checkWorkers();
+
+        // Each timer is armed for the next threshold the worker would
+        // cross, suspicion first and then failure
+        Vector<WorkerId> suspected;
+        Vector<WorkerId> recovered;
+        Vector<WorkerId> failed;
+        uint64_t now = Clock::duration{elapsed()} / TICK;
+        wheel.advance(now, [&](int id) {
+            Slot& slot = slots[id];
+            Clock::rep lastHeartbeat = slot.lastHeartbeat.load(std::memory_order::relaxed);
+            if (lastHeartbeat == INACTIVE) {
+                return;
+            }
+
+            uint64_t suspectAt = deadline(slot, lastHeartbeat, suspectDeviations);
+            if (suspectAt > now) {
+                if (slot.suspect.load(std::memory_order::relaxed)) {
+                    recovered.push_back(id);
+                }
+                wheel.schedule(id, suspectAt);
+                return;
+            }
+            uint64_t failAt = deadline(slot, lastHeartbeat, failDeviations);
+            if (failAt > now) {
+                suspected.push_back(id);
+                wheel.schedule(id, failAt);
+                return;
+            }
+            // Armed until the master disconnects the worker, and in case
+            // it is heard from before then
+            failed.push_back(id);
+            wheel.schedule(id, now + 1);
+        });
+        if (suspected.size() == 0 && recovered.size() == 0 && failed.size() == 0) {
+            continue;
+        }
+
+        lock.unlock();
+        for (WorkerId id: recovered) {
+            setSuspect(id, false);
+        }
+        for (WorkerId id: suspected) {
+            setSuspect(id, true);
+        }
+        for (WorkerId id: failed) {
+            LOG_INFO("Worker %d failed, phi passed %.1f", id, FAIL_PHI);
+            master->reportFailedWorker(id);
+        }
+        lock.lock();
     }
 }
 
@@ -63,7 +187,10 @@ void HeartbeatMonitor::activate() {
 }
 
 void HeartbeatMonitor::stop() {
-    shutdown = true;
+    {
+        std::scoped_lock<std::mutex> lock{m};
+        shutdown = true;
+    }
     cv.notify_one();
     if (monitorThread.joinable()) {
         monitorThread.join();
@@ -74,4 +201,3 @@ void HeartbeatMonitor::stop() {
 HeartbeatMonitor::~HeartbeatMonitor() {
     stop();
 }
-
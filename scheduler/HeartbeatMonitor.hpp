@@ -1,20 +1,64 @@
 #pragma once
 
-#include "Hashmap.hpp"
+#include "TimerWheel.hpp"
 #include "Worker.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
-#include <ctime>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 
 class Master;
+// Phi accrual failure detector for the connected workers, see
+// PhiAccrual.hpp. A worker whose phi passes SUSPECT_PHI stops being given
+// new tasks, and one whose phi passes FAIL_PHI is reported to the master,
+// which disconnects it from its event loop.
 class HeartbeatMonitor {
-    using Timepoint = std::chrono::time_point<std::chrono::system_clock>;
+    using Clock = std::chrono::steady_clock;
+    using Millis = std::chrono::duration<double, std::milli>;
+
+    // Only the event loop writes a slot, the monitor reads it when the
+    // worker's timer fires. The fields are updated independently, a torn
+    // read only skews one estimate.
+    struct Slot {
+        // Since start, INACTIVE without a worker
+        std::atomic<Clock::rep> lastHeartbeat;
+        // Interval the worker heartbeats at, in milliseconds
+        std::atomic<double> interval;
+        // Inter-arrival estimate in milliseconds
+        std::atomic<double> mean;
+        std::atomic<double> variance;
+        std::atomic<bool> suspect;
+    };
+
 public:
-    HeartbeatMonitor(Master* master, std::chrono::seconds expirationTime);
+    // Resolution of expiry, also how often the monitor wakes up while it
+    // has workers
+    static constexpr std::chrono::milliseconds TICK{100};
+    // Worker ids are fds, so this bounds the fds that can be workers
+    static constexpr int DEFAULT_MAX_WORKERS = 1 << 16;
+    static constexpr double SUSPECT_PHI = 3;
+    static constexpr double FAIL_PHI = 8;
+    // Floor on the standard deviation so that a very regular worker isn't
+    // failed by a little jitter
+    static constexpr Millis MIN_STD_DEV{150};
+
+    // heartbeatInterval is assumed for workers that don't give their own
+    HeartbeatMonitor(Master* master, std::chrono::milliseconds heartbeatInterval,
+            int maxWorkers = DEFAULT_MAX_WORKERS);
+    // Lock free, never waits on the monitor
     void registerHeartbeat(WorkerId id);
     void addWorker(WorkerId id);
+    // The worker's estimate is seeded with the interval it heartbeats at
+    void addWorker(WorkerId id, std::chrono::milliseconds heartbeatInterval);
+    // Whether the worker's phi is past SUSPECT_PHI
+    bool suspected(WorkerId id) const;
+    // Whether the worker's phi is past FAIL_PHI as of now. A worker is
+    // reported failed every tick until it is disconnected, which has to
+    // check this as it may have been heard from since.
+    bool failed(WorkerId id) const;
     void svc();
     void stop();
     void activate();
@@ -22,24 +66,30 @@ public:
     ~HeartbeatMonitor();
 
 private:
-    void checkWorkers();
-    Timepoint getNow();
-    inline bool hasExpired(std::chrono::seconds time);
+    static constexpr Clock::rep INACTIVE = -1;
+
+    Clock::rep elapsed() const;
+    // Tick at which the worker's phi reaches a threshold that is
+    // deviations standard deviations past its mean
+    uint64_t deadline(const Slot& slot, Clock::rep lastHeartbeat, double deviations) const;
+    bool validId(WorkerId id) const;
+    void setSuspect(WorkerId id, bool suspect);
 
     Master* master = nullptr;
-    Hashmap<WorkerId, Timepoint> workers;
-    std::chrono::seconds expirationTime;
+    std::unique_ptr<Slot[]> slots;
+    int maxWorkers;
+    // For workers that don't give their interval
+    Millis defaultInterval;
+    double suspectDeviations;
+    double failDeviations;
+    // Timers are armed for the deadline implied by the last heartbeat the
+    // monitor saw. Heartbeats don't touch them, a timer that fires for a
+    // worker that has heard from since is just armed again.
+    TimerWheel wheel;
+    Clock::time_point start;
+    // Guards the wheel
     std::mutex m;
     std::condition_variable cv;
     std::thread monitorThread;
     bool shutdown = false;
 };
-
-inline bool HeartbeatMonitor::hasExpired(std::chrono::seconds time) {
-    return time > expirationTime;
-}
-
-
-inline HeartbeatMonitor::Timepoint HeartbeatMonitor::getNow() {
-    return std::chrono::system_clock::now();
-}
@@ -1,11 +1,15 @@
 #include "Master.hpp"
 #include "Logger.hpp"
+#include "TaskLog.hpp"
 #include "Util.hpp"
 #include "message.pb.h"
 #include "UniquePtr.hpp"
 #include "HeartbeatMonitor.hpp"
 #include "Network.hpp"
+#include "Protocol.hpp"
+#include "ResultCache.hpp"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cstring>
 #include <cerrno>
@@ -17,10 +21,16 @@
 #include <netdb.h>
 #include <unistd.h>
 
+// Ident of the user event that wakes the event loop for failed workers
+static constexpr uintptr_t WAKEUP_EVENT = 0;
+
 using namespace std::chrono_literals;
-Master::Master(const char* hostname, const char* port): fd(0),
-        hostname(hostname), port(port),
-        heartbeatMonitor{UniquePtr<HeartbeatMonitor>{new HeartbeatMonitor(this, 20s)}} {}
+Master::Master(const char* hostname, const char* port,
+        UniquePtr<IPlacementPolicy> placementPolicy): fd(0),
+        hostname(hostname), port(port), distributor(std::move(placementPolicy)),
+        // Assumed for version 1 workers, which don't say how often they
+        // heartbeat
+        heartbeatMonitor{UniquePtr<HeartbeatMonitor>{new HeartbeatMonitor(this, 1s)}} {}
 
 bool Master::init() {
     addrinfo *res, hints, *p;
@@ -80,14 +90,37 @@ bool Master::listen() {
     return true;
 }
 
+bool Master::restore(const char* directory) {
+    taskLog = UniquePtr<TaskLog>{new TaskLog(directory)};
+    // Tasks come back in submission order, so dependencies are added first
+    bool success = taskLog->open([this](const Scheduler::LogRecord& record) {
+        addTask(record.id(), record.client_id(), record.request_id(), record.task());
+    });
+    if (!success) {
+        LOG_ERROR("Error restoring task log from %s", directory);
+        return false;
+    }
+    // Ids of tasks and sessions from before the restart are not reused as
+    // workers and clients may still come back with them
+    distributor.setNextTaskId(taskLog->nextTaskId());
+    nextClientId = taskLog->nextClientId();
+    releaseReady();
+    LOG_INFO("Restored %zu tasks from %s", taskLog->pendingTasks(), directory);
+    return true;
+}
+
+void Master::enableResultCache(size_t capacity) {
+    deduplicate = true;
+    if (capacity > 0) {
+        resultCache = UniquePtr<ResultCache>{new ResultCache(capacity)};
+    }
+}
+
 bool Master::run() {
     if (fd == 0) {
         return false;
     }
     
-    // Start monitors
-    heartbeatMonitor->activate();
-
     // Initialise kqueue
     struct kevent evSet;
     if ((kq = kqueue()) == -1) {
@@ -95,6 +128,17 @@ bool Master::run() {
         return false;
     }
 
+    // The heartbeat monitor reports failed workers through it
+    EV_SET(&evSet, WAKEUP_EVENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if (kevent(kq, &evSet, 1, nullptr, 0, nullptr) == -1) {
+        LOG_ERROR("Error kevent when adding the wakeup event");
+        return false;
+    }
+
+    // Start monitors
+    heartbeatMonitor->activate();
+    distributor.start();
+
     // Listen on master socket
     EV_SET(&evSet, fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
     if (kevent(kq, &evSet, 1, nullptr, 0, nullptr) == -1) {
@@ -117,12 +161,29 @@ bool Master::run() {
             LOG_ERROR("Error in kevent");
             return false;
         }
+        if (nfds == 0) {
+            [[maybe_unused]] AllocationStats stats = MessageArena::stats();
+            LOG_TRACE("Arena overflow blocks=%llu (%llu bytes), buffer growths=%llu, resets=%llu",
+                    stats.blockAllocations, stats.blockBytes, stats.bufferGrowths, stats.resets);
+            if (resultCache.get() != nullptr) {
+                LOG_TRACE("Result cache entries=%zu hits=%llu misses=%llu",
+                        resultCache->size(), resultCache->hits(), resultCache->misses());
+            }
+        }
 
         for (int i = 0; i < nfds; i++) {
+            if (eventList[i].filter == EVFILT_USER) {
+                handleFailedWorkers();
+                continue;
+            }
             if (eventList[i].flags & EV_EOF) {
                 handleDisconnect(eventList[i].ident);
                 continue;
             }
+            if (eventList[i].filter == EVFILT_WRITE) {
+                flushClient(eventList[i].ident);
+                continue;
+            }
 
             int rfd = eventList[i].ident;
             if (rfd == fd) {
@@ -130,7 +191,7 @@ bool Master::run() {
                 continue;
             } 
 
-            String s;
+            std::string& s = arena.recvBuffer();
             if (!Receive(rfd, s)) {
                 LOG_ERROR("Error receiving data from fd=%d", rfd);
                 handleDisconnect(rfd);
@@ -142,23 +203,48 @@ bool Master::run() {
                 handleDisconnect(rfd);
             }
         }
+        routeAbandoned();
+        // After every submission of the wakeup is in the graph so that
+        // ranks take them into account
+        releaseReady();
+        // Submissions and completions of the whole wakeup share a flush
+        if (taskLog.get() != nullptr && !taskLog->sync()) {
+            LOG_ERROR("Error syncing task log");
+        }
+
+        // Every message handled in this wakeup was allocated on the arena
+        arena.reset();
     }
     LOG_INFO("Master run loop ended!");
+    // Lets workers and clients see the master go rather than wait on it
+    for (auto& [workerFd, id]: workerFds) {
+        close(workerFd);
+    }
+    for (auto& [clientFd, id]: clientFds) {
+        close(clientFd);
+    }
     barrier.arrive_and_wait();
     return true;
 }
 
-bool Master::handle(int fd, const String& s) {
-    Scheduler::Message message;
-    if (!message.ParseFromString(s.toStdString())) {
+bool Master::handle(int fd, const std::string& s) {
+    Scheduler::Message& message = *arena.create<Scheduler::Message>();
+    if (!message.ParseFromString(s)) {
         LOG_ERROR("Error deserializing mesage from fd=%d", fd);
         return false;
     }
+    if (!upgradeMessage(message)) {
+        return false;
+    }
 
     bool res = true;
     switch (message.type()) {
         case (Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_REQ): {
-            res = sendHandshakeResponse(fd);
+            res = sendHandshakeResponse(fd, message);
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_CLIENT_HANDSHAKE_REQ): {
+            res = sendClientHandshakeResponse(fd, message);
             break;
         }
         default: {
@@ -175,22 +261,51 @@ bool Master::handle(int fd, const String& s) {
 }
  
 bool Master::handleClient(int clientFd, const Scheduler::Message& msg) {
-    return true;
+    bool res = true;
+    switch (msg.type()) {
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ): {
+            res = handleSubmit(clientFd, msg.task());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_REQ): {
+            for (const Scheduler::Task& task: msg.task_batch().tasks()) {
+                res = handleSubmit(clientFd, task) && res;
+            }
+            break;
+        }
+        default: {
+            LOG_ERROR("Invalid message type=%d from clientFd=%d", msg.type(), clientFd);
+            break;
+        }
+    }
+    return res;
 }
 
-bool Master::handleWorker(int workerFd, const Scheduler::Message& message) {
+bool Master::handleWorker(int workerFd, Scheduler::Message& message) {
+    // Any frame shows the worker is alive, workers only send explicit
+    // heartbeats when they have nothing else to send
+    heartbeatMonitor->registerHeartbeat(workerFds.at(workerFd));
+
     bool res = true;
     switch (message.type()) {
         case (Scheduler::MessageType::MESSAGE_TYPE_HEARTBEAT): {
-            res = handleHeartbeat(workerFd);
+            res = handleHeartbeat(workerFd, message);
             break;
         }
         case (Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_REQ): {
-            res = sendHandshakeResponse(workerFd);
+            res = sendHandshakeResponse(workerFd, message);
             break;
         }
         case (Scheduler::MessageType::MESSAGE_TYPE_TASK_RES): {
-            res = handleTaskResponse(workerFd, message.data());
+            res = handleTaskResponse(workerFd, message.task_response());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES): {
+            res = handleTaskResponseBatch(workerFd, message.task_response_batch());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_RESULT_CHUNK): {
+            res = handleResultChunk(workerFd, message);
             break;
         }
         default: {
@@ -204,6 +319,8 @@ bool Master::handleWorker(int workerFd, const Scheduler::Message& message) {
 void Master::handleDisconnect(int fd) {
     if (workerFds.contains(fd)) {
         handleDisconnectWorker(fd);
+    } else if (clientFds.contains(fd)) {
+        handleDisconnectClient(fd);
     } else {
         LOG_ERROR("Attempting to disconnect an unknown worker fd=%d", fd);
         return;
@@ -217,48 +334,435 @@ void Master::handleDisconnect(int fd) {
     close(fd);
 }
 
+void Master::reportFailedWorker(WorkerId id) {
+    failedWorkers.push(id);
+    // Before run() there is no event loop to wake
+    if (kq == 0) {
+        return;
+    }
+    struct kevent kev;
+    EV_SET(&kev, WAKEUP_EVENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    if (kevent(kq, &kev, 1, nullptr, 0, nullptr) == -1) {
+        LOG_ERROR("Error waking the event loop for worker %d %d: %s", id, errno, strerror(errno));
+    }
+}
+
+void Master::handleFailedWorkers() {
+    std::deque<WorkerId> failed;
+    failedWorkers.drain(failed);
+    for (WorkerId id: failed) {
+        // It may have been heard from, or disconnected and its fd reused,
+        // since it was reported
+        if (workerFds.contains(id) && heartbeatMonitor->failed(id)) {
+            handleDisconnect(id);
+        }
+    }
+}
+
 void Master::handleDisconnectWorker(int workerFd) {
     LOG_INFO("Disconnect workerFd=%d", fd);
-    heartbeatMonitor->disconnectWorker(workerFds.at(workerFd));
+    WorkerId id = workerFds.at(workerFd);
+    heartbeatMonitor->disconnectWorker(id);
+    distributor.removeWorker(id);
     workerFds.erase(workerFd);
+    workerConnections.erase(workerFd);
+}
+
+void Master::handleDisconnectClient(int clientFd) {
+    LOG_INFO("Disconnect clientFd=%d", clientFd);
+    // Results of its outstanding tasks are dropped when they arrive, unless
+    // it resumes its session first
+    clientSessions.erase(clientFds.at(clientFd));
+    clientFds.erase(clientFd);
+    // Credits of chunks that were still queued go back to their workers
+    auto output = clientOutputs.find(clientFd);
+    if (output != clientOutputs.end()) {
+        SharedPtr<ClientOutput> dropped = output->second;
+        clientOutputs.erase(clientFd);
+        dropped->outbox.clear();
+    }
 }
 
-bool Master::sendHandshakeResponse(int workerFd) {
+bool Master::sendHandshakeResponse(int workerFd, const Scheduler::Message& request) {
     LOG_TRACE("Sending handshake response to workerfd=%d", workerFd);
     if (workerFds.contains(workerFd)) {
         LOG_ERROR("Handshake requested from a worker that has already shook hands! fd=%d", workerFd);
         return false;
     }
 
+    // Speak the older of the two versions for the rest of the session
+    uint32_t version = std::min(messageVersion(request), PROTOCOL_VERSION);
+    // Version 1 workers only report their capacity in heartbeats
+    int capacity = 1;
+    if (request.has_heartbeat() && request.heartbeat().has_capacity()) {
+        capacity = request.heartbeat().capacity();
+    }
     int id = workerFd;
-    Scheduler::HeartbeatData hData;
-    hData.set_id(id);
-    std::string serialized;
-    if (!hData.SerializeToString(&serialized)) {
-        LOG_ERROR("Error serializing heartbeat data workerFd=%d, workerId=%d", workerFd, workerFds.at(workerFd));
+    Scheduler::Message& msg = *arena.create<Scheduler::Message>();
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_RES);
+    msg.mutable_heartbeat()->set_id(id);
+
+    if (!sendMessage(workerFd, msg, version, arena.sendBuffer())) {
+        LOG_ERROR("Error sending handshake response to workerFd=%d", workerFd);
+        return false;
+    }
+    distributor.addWorker(workerFd, id, version, capacity);
+    // A worker resuming its session after losing us, possibly to a restart,
+    // keeps the tasks it still holds results for
+    if (request.has_heartbeat() && request.heartbeat().id() != -1) {
+        LOG_INFO("Worker %d resumed as %d", request.heartbeat().id(), id);
+        distributor.adoptTasks(id, request.heartbeat().tasks());
+    }
+    workerFds.insert({workerFd, id});
+    workerConnections.insert({workerFd, makeShared<int>(workerFd)});
+    if (request.has_heartbeat() && request.heartbeat().has_heartbeat_interval_ms()) {
+        heartbeatMonitor->addWorker(id, std::chrono::milliseconds{request.heartbeat().heartbeat_interval_ms()});
+    } else {
+        heartbeatMonitor->addWorker(id);
+    }
+    return true;
+}
+
+bool Master::sendClientHandshakeResponse(int clientFd, const Scheduler::Message& request) {
+    if (workerFds.contains(clientFd) || clientFds.contains(clientFd)) {
+        LOG_ERROR("Handshake requested from a client that has already shook hands! fd=%d", clientFd);
         return false;
     }
 
-    Scheduler::Message msg;
+    // A client may resume a session that is not live, results of the
+    // session's tasks are then routed to it
+    int id;
+    if (request.has_heartbeat() && request.heartbeat().id() > 0 && request.heartbeat().id() < nextClientId &&
+            !clientSessions.contains(request.heartbeat().id())) {
+        id = request.heartbeat().id();
+        LOG_INFO("Client resumed session id=%d", id);
+    } else {
+        id = nextClientId++;
+    }
+    Scheduler::Message& msg = *arena.create<Scheduler::Message>();
     msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_RES);
-    msg.set_data(serialized);
+    msg.mutable_heartbeat()->set_id(id);
+    auto requests = clientRequests.find(id);
+    msg.mutable_heartbeat()->set_next_request_id(
+            requests != clientRequests.end() ? requests->second->nextRequestId() : 1);
+    clientOutputs.insert({clientFd, makeShared<ClientOutput>()});
+    if (!sendToClient(clientFd, msg)) {
+        LOG_ERROR("Error sending handshake response to clientFd=%d", clientFd);
+        clientOutputs.erase(clientFd);
+        return false;
+    }
+    clientFds.insert({clientFd, id});
+    clientSessions.insert({id, clientFd});
+    LOG_INFO("Client connected clientFd=%d id=%d", clientFd, id);
+    return true;
+}
+
+bool Master::handleSubmit(int clientFd, const Scheduler::Task& task) {
+    if (serveCached(clientFd, task)) {
+        return true;
+    }
+
+    // Ids are handed out by the distributor so clients can't collide, the
+    // client's own id is kept to tag the result with
+    uint64_t id = distributor.reserveTaskId();
+    uint64_t requestId = task.id();
+    int clientId = clientFds.at(clientFd);
+    if (taskLog.get() != nullptr) {
+        taskLog->submit(id, task, clientId, requestId);
+    }
+    addTask(id, clientId, requestId, task);
+    LOG_TRACE("Client fd=%d submitted request=%llu as task=%llu", clientFd, requestId, id);
+    return true;
+}
+
+void Master::addTask(uint64_t id, int clientId, uint64_t requestId, Scheduler::Task task) {
+    taskOwners.insert({id, TaskOwner{.clientId = clientId, .requestId = requestId}});
+
+    // Dependencies are given as the client's ids
+    auto it = clientRequests.find(clientId);
+    if (it == clientRequests.end()) {
+        it = clientRequests.insert({clientId, makeShared<ClientRequests>()}).first;
+    }
+    ClientRequests& requests = *it->second;
+    Vector<uint64_t> dependencies;
+    bool resolved = requests.resolve(task.depends_on(), dependencies);
+    // Tasks depending on one that shares another's execution wait for that
+    uint64_t runsAs = id;
+    bool shared = resolved && coalesce(id, task, dependencies, runsAs);
+    if (!requests.add(requestId, runsAs)) {
+        LOG_ERROR("Client=%d submitted request=%llu again while it is pending", clientId, requestId);
+    }
+    if (!resolved) {
+        // A dependency failed before this was submitted, it fails the same
+        // way as if it had been waiting on it
+        LOG_INFO("Task=%llu depends on a failed request of client=%d", id, clientId);
+        Scheduler::TaskResponse failure;
+        failure.set_success(false);
+        failure.set_id(id);
+        routeResponse(failure);
+        return;
+    }
+    if (shared) {
+        return;
+    }
+    task.set_id(id);
+    graph.add(id, std::move(task), dependencies);
+}
 
-    if (!msg.SerializeToString(&serialized)) {
-        LOG_ERROR("Error serializing msg heartbeat data workerFd=%d, workerId=%d", workerFd, id);
+bool Master::serveCached(int clientFd, const Scheduler::Task& task) {
+    if (resultCache.get() == nullptr || !task.cacheable()) {
+        return false;
+    }
+    std::string content = ResultCache::content(task);
+    std::string result;
+    if (!resultCache->get(ResultCache::key(content), content, result)) {
         return false;
     }
 
-    if (send(workerFd, serialized.data(), serialized.size(), 0) == -1) {
-        LOG_ERROR("Error sending heartbeat %d: %s", errno, strerror(errno));
+    Scheduler::Message& msg = *arena.create<Scheduler::Message>();
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+    Scheduler::TaskResponse* response = msg.mutable_task_response();
+    response->set_id(task.id());
+    response->set_success(true);
+    response->set_result(std::move(result));
+    if (!sendToClient(clientFd, msg)) {
+        LOG_ERROR("Error sending cached result of request=%llu to clientFd=%d", task.id(), clientFd);
+    }
+    LOG_TRACE("Answered request=%llu of clientFd=%d from the result cache", task.id(), clientFd);
+    return true;
+}
+
+bool Master::coalesce(uint64_t id, const Scheduler::Task& task, const Vector<uint64_t>& dependencies,
+        uint64_t& leader) {
+    if (!deduplicate || !task.cacheable()) {
         return false;
     }
-    distributor.addWorker(workerFd);
-    workerFds.insert({workerFd, id});
-    heartbeatMonitor->addWorker(id);
+    std::string content = ResultCache::content(task);
+    uint64_t key = ResultCache::key(content);
+    Vector<uint64_t> sorted = dependencies;
+    std::sort(sorted.data(), sorted.data() + sorted.size());
+    auto it = leaders.find(key);
+    if (it == leaders.end()) {
+        leaders.insert({key, id});
+        coalesced.insert({id, makeShared<Coalesced>(Coalesced{
+                .key = key, .content = std::move(content), .dependencies = std::move(sorted), .followers = {}})});
+        return false;
+    }
+    // A task that only shares the key, or that waits on other tasks, runs
+    // on its own without becoming a leader
+    Coalesced& entry = *coalesced.at(it->second);
+    if (entry.content != content || entry.dependencies.size() != sorted.size()
+            || !std::equal(sorted.data(), sorted.data() + sorted.size(), entry.dependencies.data())) {
+        return false;
+    }
+    entry.followers.push_back(id);
+    leader = it->second;
+    LOG_TRACE("Task=%llu shares the execution of task=%llu", id, leader);
     return true;
 }
 
-bool Master::handleHeartbeat(int workerFd) {
+void Master::releaseReady() {
+    Scheduler::Task task;
+    uint64_t rank;
+    while (graph.popReady(task, rank)) {
+        distributor.addTask(std::move(task), rank);
+    }
+}
+
+bool Master::findOwner(uint64_t taskId, TaskOwner& owner, int& clientFd) {
+    auto it = taskOwners.find(taskId);
+    if (it == taskOwners.end()) {
+        return false;
+    }
+    owner = it->second;
+    auto session = clientSessions.find(owner.clientId);
+    if (session == clientSessions.end()) {
+        return false;
+    }
+    clientFd = session->second;
+    return true;
+}
+
+bool Master::handleResultChunk(int workerFd, Scheduler::Message& msg) {
+    Scheduler::ResultChunk& chunk = *msg.mutable_result_chunk();
+    uint32_t size = chunk.data().size();
+    uint64_t taskId = chunk.id();
+
+    // Chunks are relayed as they arrive rather than reassembled here. The
+    // worker only gets its credit back once every client the chunk goes
+    // to has taken it, so a slow client throttles the workers producing
+    // for it and never the master. Only the first copy of a task to start
+    // streaming is relayed, the chunks of any other copy are acknowledged
+    // and dropped
+    SharedPtr<ChunkCredit> credit = makeShared<ChunkCredit>(ChunkCredit{
+        .workerFd = WeakPtr<int>(workerConnections.at(workerFd)), .taskId = taskId, .size = size});
+    if (distributor.claimResult(workerFds.at(workerFd), taskId)) {
+        relayChunk(taskId, msg, credit);
+        // Tasks sharing this one's execution get the same stream
+        auto it = coalesced.find(taskId);
+        if (it != coalesced.end()) {
+            for (uint64_t follower: it->second->followers) {
+                relayChunk(follower, msg, credit);
+            }
+        }
+    }
+    returnCredit(*credit);
+    return true;
+}
+
+void Master::relayChunk(uint64_t taskId, Scheduler::Message& msg, const SharedPtr<ChunkCredit>& credit) {
+    TaskOwner owner;
+    int clientFd;
+    if (!findOwner(taskId, owner, clientFd)) {
+        return;
+    }
+    msg.mutable_result_chunk()->set_id(owner.requestId);
+    credit->pending++;
+    if (!sendToClient(clientFd, msg, [this, credit]() { returnCredit(*credit); })) {
+        LOG_ERROR("Error relaying result chunk of task=%llu to clientFd=%d", taskId, clientFd);
+        credit->pending--;
+    }
+}
+
+void Master::returnCredit(ChunkCredit& credit) {
+    if (--credit.pending > 0) {
+        return;
+    }
+    // The worker's window went with its connection
+    SharedPtr<int> workerFd = credit.workerFd.lock();
+    if (!workerFd) {
+        return;
+    }
+    Scheduler::Message& ack = *arena.create<Scheduler::Message>();
+    ack.set_type(Scheduler::MessageType::MESSAGE_TYPE_CHUNK_ACK);
+    ack.mutable_chunk_ack()->set_id(credit.taskId);
+    ack.mutable_chunk_ack()->set_size(credit.size);
+    // The distributor writes task batches to the same socket
+    if (!distributor.sendToWorker(workerFds.at(*workerFd), ack, arena.sendBuffer())) {
+        LOG_ERROR("Error acknowledging result chunk to workerFd=%d", *workerFd);
+    }
+}
+
+bool Master::sendToClient(int clientFd, Scheduler::Message& msg, Outbox::Done done) {
+    auto it = clientOutputs.find(clientFd);
+    if (it == clientOutputs.end()) {
+        return false;
+    }
+    std::string data;
+    if (!serializeMessage(msg, PROTOCOL_VERSION, data)) {
+        return false;
+    }
+    Outbox& outbox = it->second->outbox;
+    // Anything already queued goes first once the socket is writable
+    bool idle = outbox.empty();
+    if (!outbox.push(std::move(data), std::move(done))) {
+        return false;
+    }
+    if (idle) {
+        flushClient(clientFd);
+    }
+    return true;
+}
+
+void Master::flushClient(int clientFd) {
+    auto it = clientOutputs.find(clientFd);
+    if (it == clientOutputs.end()) {
+        return;
+    }
+    // Held as the callbacks of written frames run
+    SharedPtr<ClientOutput> output = it->second;
+    if (!output->outbox.flush(clientFd)) {
+        // The read side sees the disconnect, until then nothing more is
+        // written and credits go back to the workers
+        LOG_ERROR("Error writing to clientFd=%d", clientFd);
+        output->outbox.clear();
+    }
+
+    bool pending = !output->outbox.empty();
+    if (pending == output->watching) {
+        return;
+    }
+    struct kevent kev;
+    EV_SET(&kev, clientFd, EVFILT_WRITE, pending ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+    if (kevent(kq, &kev, 1, nullptr, 0, nullptr) == -1) {
+        LOG_ERROR("Error %s watching clientFd=%d for writes %d: %s", pending ? "starting" : "stopping",
+                clientFd, errno, strerror(errno));
+        return;
+    }
+    output->watching = pending;
+}
+
+void Master::routeResponse(const Scheduler::TaskResponse& response) {
+    if (!response.has_id()) {
+        return;
+    }
+    uint64_t taskId = response.id();
+    if (taskLog.get() != nullptr) {
+        taskLog->complete(taskId);
+    }
+    // Tasks that depend on a failed one fail with it
+    Vector<uint64_t> failed;
+    graph.complete(taskId, response.success(), failed);
+
+    TaskOwner owner;
+    int clientFd;
+    bool found = findOwner(taskId, owner, clientFd);
+    auto it = taskOwners.find(taskId);
+    if (it != taskOwners.end()) {
+        auto requests = clientRequests.find(it->second.clientId);
+        if (requests != clientRequests.end()) {
+            requests->second->complete(it->second.requestId, response.success());
+        }
+        taskOwners.erase(taskId);
+    }
+
+    if (found) {
+        Scheduler::Message& msg = *arena.create<Scheduler::Message>();
+        msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+        Scheduler::TaskResponse* routed = msg.mutable_task_response();
+        *routed = response;
+        routed->set_id(owner.requestId);
+        if (!sendToClient(clientFd, msg)) {
+            LOG_ERROR("Error sending result of task=%llu to clientFd=%d", taskId, clientFd);
+        }
+    }
+
+    // Streamed results never pass through here whole so are not cached
+    auto shared = coalesced.find(taskId);
+    if (shared != coalesced.end()) {
+        SharedPtr<Coalesced> entry = shared->second;
+        leaders.erase(entry->key);
+        coalesced.erase(taskId);
+        if (resultCache.get() != nullptr && response.success() && !response.has_result_size()) {
+            resultCache->put(entry->key, entry->content, response.result());
+        }
+        for (uint64_t follower: entry->followers) {
+            Scheduler::TaskResponse copy = response;
+            copy.set_id(follower);
+            routeResponse(copy);
+        }
+    }
+
+    for (uint64_t id: failed) {
+        Scheduler::TaskResponse failure;
+        failure.set_success(false);
+        failure.set_id(id);
+        routeResponse(failure);
+    }
+}
+
+void Master::routeAbandoned() {
+    std::deque<uint64_t> abandoned;
+    distributor.drainAbandoned(abandoned);
+    for (uint64_t taskId: abandoned) {
+        Scheduler::TaskResponse response;
+        response.set_success(false);
+        response.set_id(taskId);
+        routeResponse(response);
+    }
+}
+
+bool Master::handleHeartbeat(int workerFd, const Scheduler::Message& msg) {
     if (fd == 0) {
         return false;
     }
@@ -268,8 +772,11 @@ bool Master::handleHeartbeat(int workerFd) {
         return false;
     }
 
-    // TODO: Keep track of heartbeats and disconnect if not recv
-    heartbeatMonitor->registerHeartbeat(workerFds.at(workerFd));
+    // Liveness was already registered by handleWorker
+    WorkerId id = workerFds.at(workerFd);
+    if (msg.has_heartbeat()) {
+        distributor.updateLoad(id, msg.heartbeat());
+    }
     return true;
 }
 
@@ -292,13 +799,21 @@ void Master::handleNewConnection() {
     LOG_INFO("Accepted new connection fd=%d", newFd);
 }
 
-bool Master::handleTaskResponse(int workerFd, const std::string& data) {
-    Scheduler::TaskResponse msg;
-    if (!msg.ParseFromString(data)) {
-        LOG_ERROR("Error deserializing task response from worker=%d", workerFd);
-        return false;
+bool Master::handleTaskResponse(int workerFd, const Scheduler::TaskResponse& response) {
+    // Late results of a task that was dispatched more than once are dropped
+    if (distributor.completeTask(workerFds.at(workerFd), response.id())) {
+        routeResponse(response);
+    }
+    return true;
+}
+
+bool Master::handleTaskResponseBatch(int workerFd, const Scheduler::TaskResponseBatch& responses) {
+    WorkerId id = workerFds.at(workerFd);
+    for (const Scheduler::TaskResponse& response: responses.responses()) {
+        if (distributor.completeTask(id, response.id())) {
+            routeResponse(response);
+        }
     }
-    distributor.addWorker(workerFd);
     return true;
 }
 
@@ -311,4 +826,5 @@ Master::~Master() {
     LOG_TRACE("Master destructor");
     close(fd);
     heartbeatMonitor->stop();
+    distributor.stop();
 }
@@ -1,42 +1,155 @@
 #pragma once
 
+#include "ClientRequests.hpp"
 #include "Distributor.hpp"
 #include "Hashmap.hpp"
+#include "MessageArena.hpp"
+#include "Outbox.hpp"
+#include "PlacementPolicy.hpp"
+#include "SharedPtr.hpp"
+#include "TaskGraph.hpp"
+#include "TsQueue.hpp"
 #include "Worker.hpp"
 #include "String.hpp"
 #include "UniquePtr.hpp"
 
 #include <barrier>
+#include <string>
 
 class HeartbeatMonitor;
+class ResultCache;
+class TaskLog;
 class Master {
+    // Client a submitted task's result is routed back to, on whichever
+    // connection its session is live
+    struct TaskOwner {
+        int clientId;
+        // Id the client submitted the task with, results carry it back in
+        // place of the distributor's id
+        uint64_t requestId;
+    };
+
+    // Identical cacheable tasks submitted while one is pending, they get
+    // its result rather than running themselves. Tasks are identical if
+    // they have the same content and wait on the same tasks.
+    struct Coalesced {
+        uint64_t key;
+        std::string content;
+        // Sorted
+        Vector<uint64_t> dependencies;
+        Vector<uint64_t> followers;
+    };
+
+    // Messages for a client, written as its socket takes them
+    struct ClientOutput {
+        Outbox outbox;
+        // Whether the socket is watched for becoming writable
+        bool watching = false;
+    };
+
+    // Credit for a streamed result chunk, returned to the worker once
+    // every client the chunk is relayed to has taken it
+    struct ChunkCredit {
+        // Expires when the worker disconnects
+        WeakPtr<int> workerFd;
+        uint64_t taskId;
+        uint32_t size;
+        // Relayed copies still queued, plus one while they are being queued
+        int pending = 1;
+    };
+
 public:
-    Master(const char* hostname, const char* port);
+    Master(const char* hostname, const char* port,
+            UniquePtr<IPlacementPolicy> placementPolicy = UniquePtr<IPlacementPolicy>{new LeastLoadedPolicy});
     bool init();
     bool listen();
+    // Logs tasks to directory and picks up the backlog a previous run left
+    // there. Has to be called before run.
+    bool restore(const char* directory);
+    // Cacheable tasks identical to a pending one share its execution, and
+    // up to capacity recent results are answered without running them
+    // again. A capacity of 0 only coalesces pending tasks.
+    void enableResultCache(size_t capacity);
     bool run();
     void stop();
     ~Master();
 
 private:
-    bool handle(int fd, const String& s);
+    bool handle(int fd, const std::string& s);
     bool handleClient(int clientFd, const Scheduler::Message& msg);
-    bool handleWorker(int workerFd, const Scheduler::Message& msg);
+    bool handleWorker(int workerFd, Scheduler::Message& msg);
     void handleDisconnect(int fd);
     void handleDisconnectWorker(int workerFd);
+    void handleDisconnectClient(int clientFd);
+    // Called from the heartbeat monitor's thread, hands the worker to the
+    // event loop to disconnect
+    void reportFailedWorker(WorkerId id);
+    // Disconnects the reported workers that are still failed
+    void handleFailedWorkers();
+    bool sendClientHandshakeResponse(int clientFd, const Scheduler::Message& request);
+    bool handleSubmit(int clientFd, const Scheduler::Task& task);
+    void addTask(uint64_t id, int clientId, uint64_t requestId, Scheduler::Task task);
+    // Answers a task from the result cache
+    bool serveCached(int clientFd, const Scheduler::Task& task);
+    // Makes the task wait on an identical pending one instead of running,
+    // setting leader to that one's id
+    bool coalesce(uint64_t id, const Scheduler::Task& task, const Vector<uint64_t>& dependencies, uint64_t& leader);
+    // Hands the tasks whose dependencies have completed to the distributor
+    void releaseReady();
+    bool handleResultChunk(int workerFd, Scheduler::Message& msg);
+    void routeResponse(const Scheduler::TaskResponse& response);
+    // Fails the tasks the distributor gave up on back to their clients
+    void routeAbandoned();
+    bool findOwner(uint64_t taskId, TaskOwner& owner, int& clientFd);
+    void relayChunk(uint64_t taskId, Scheduler::Message& msg, const SharedPtr<ChunkCredit>& credit);
+    void returnCredit(ChunkCredit& credit);
+    // Queues the message for the client. Returns false, without calling
+    // done, if the client is gone or the message can't be framed.
+    bool sendToClient(int clientFd, Scheduler::Message& msg, Outbox::Done done = {});
+    // Writes what the client's socket takes and watches it for becoming
+    // writable while anything is left
+    void flushClient(int clientFd);
     void handleNewConnection();
-    bool handleHeartbeat(int workerFd);
-    bool sendHandshakeResponse(int workerFd);
-    bool handleTaskResponse(int workerFd, const std::string& data);
+    bool handleHeartbeat(int workerFd, const Scheduler::Message& msg);
+    bool sendHandshakeResponse(int workerFd, const Scheduler::Message& request);
+    bool handleTaskResponse(int workerFd, const Scheduler::TaskResponse& response);
+    bool handleTaskResponseBatch(int workerFd, const Scheduler::TaskResponseBatch& responses);
     int fd = 0;
     int kq = 0;
     bool shutdown = false;
+    // Workers the heartbeat monitor found failed, the event loop is woken
+    // to take them
+    TsQueue<WorkerId> failedWorkers;
     const char* hostname;
     const char* port;
     Hashmap<int, WorkerId> workerFds;
+    // Handle on each worker connection that chunk credits hold weakly, so
+    // that credits outliving the connection aren't sent to a reused fd
+    Hashmap<int, SharedPtr<int>> workerConnections;
+    // Client fd to the id it was given in the handshake
     Hashmap<int, int> clientFds;
+    // Live client sessions to their fd
+    Hashmap<int, int> clientSessions;
+    Hashmap<int, SharedPtr<ClientOutput>> clientOutputs;
+    Hashmap<uint64_t, TaskOwner> taskOwners;
+    // Requests of every client, for tasks that depend on them
+    Hashmap<int, SharedPtr<ClientRequests>> clientRequests;
+    // Every pending task, ready or not
+    TaskGraph graph;
+    bool deduplicate = false;
+    // Content key of every pending cacheable task that runs to its id
+    Hashmap<uint64_t, uint64_t> leaders;
+    // Running task to the tasks waiting on it
+    Hashmap<uint64_t, SharedPtr<Coalesced>> coalesced;
+    // Only set with a non zero capacity
+    UniquePtr<ResultCache> resultCache;
+    int nextClientId = 1;
     Distributor distributor;
+    // Reset after every event loop wakeup
+    MessageArena arena;
     UniquePtr<HeartbeatMonitor> heartbeatMonitor;
+    // Only set once restore is called
+    UniquePtr<TaskLog> taskLog;
     std::barrier<std::function<void()>> barrier{2, []{}};
 
     friend class HeartbeatMonitor;
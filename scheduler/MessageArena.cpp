@@ -0,0 +1,56 @@
+#include "MessageArena.hpp"
+
+#include <atomic>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> blockAllocations = 0;
+std::atomic<uint64_t> blockBytes = 0;
+std::atomic<uint64_t> bufferGrowths = 0;
+std::atomic<uint64_t> resets = 0;
+}
+
+MessageArena::MessageArena(size_t initialBlockSize):
+        initialBlock(new char[initialBlockSize]),
+        arena(options(initialBlock.get(), initialBlockSize)) {}
+
+google::protobuf::ArenaOptions MessageArena::options(char* block, size_t size) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = size;
+    options.block_alloc = &MessageArena::allocateBlock;
+    options.block_dealloc = &MessageArena::deallocateBlock;
+    return options;
+}
+
+void* MessageArena::allocateBlock(size_t size) {
+    blockAllocations.fetch_add(1, std::memory_order::relaxed);
+    blockBytes.fetch_add(size, std::memory_order::relaxed);
+    return ::operator new(size);
+}
+
+void MessageArena::deallocateBlock(void* block, size_t) {
+    ::operator delete(block);
+}
+
+void MessageArena::reset() {
+    arena.Reset();
+    if (recvBuf.capacity() != recvCapacity) {
+        recvCapacity = recvBuf.capacity();
+        bufferGrowths.fetch_add(1, std::memory_order::relaxed);
+    }
+    if (sendBuf.capacity() != sendCapacity) {
+        sendCapacity = sendBuf.capacity();
+        bufferGrowths.fetch_add(1, std::memory_order::relaxed);
+    }
+    resets.fetch_add(1, std::memory_order::relaxed);
+}
+
+AllocationStats MessageArena::stats() {
+    return AllocationStats{
+        .blockAllocations = blockAllocations.load(std::memory_order::relaxed),
+        .blockBytes = blockBytes.load(std::memory_order::relaxed),
+        .bufferGrowths = bufferGrowths.load(std::memory_order::relaxed),
+        .resets = resets.load(std::memory_order::relaxed),
+    };
+}
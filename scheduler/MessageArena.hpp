@@ -0,0 +1,70 @@
+#pragma once
+
+#include <google/protobuf/arena.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Only covers what the arenas manage, not every heap allocation made while
+// handling a message
+struct AllocationStats {
+    // Heap blocks arenas had to allocate because a reset cycle did not
+    // fit in their initial block
+    uint64_t blockAllocations;
+    uint64_t blockBytes;
+    // Times a reusable receive or serialization buffer had to grow
+    uint64_t bufferGrowths;
+    uint64_t resets;
+};
+
+// Arena for the protobuf messages handled in one iteration of an event
+// loop. Messages and their repeated fields are bump allocated out of an
+// initial block owned by the arena, and the block and buffers are kept
+// across resets, so they cost no heap allocation once warmed up as long
+// as an iteration fits in the block. String fields longer than the small
+// string buffer, such as payloads and results, still allocate their
+// characters on the heap.
+class MessageArena {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+    explicit MessageArena(size_t initialBlockSize = DEFAULT_BLOCK_SIZE);
+    MessageArena(const MessageArena&) = delete;
+    MessageArena& operator=(const MessageArena&) = delete;
+
+    template <typename T>
+    T* create() {
+        return google::protobuf::Arena::CreateMessage<T>(&arena);
+    }
+
+    // Buffer to receive frames into
+    std::string& recvBuffer() {
+        return recvBuf;
+    }
+
+    // Buffer to serialize outgoing messages into
+    std::string& sendBuffer() {
+        return sendBuf;
+    }
+
+    // Frees every message created since the last reset
+    void reset();
+
+    // Totals across every arena in the process
+    static AllocationStats stats();
+
+private:
+    static void* allocateBlock(size_t size);
+    static void deallocateBlock(void* block, size_t size);
+    static google::protobuf::ArenaOptions options(char* block, size_t size);
+
+    // Declared before the arena as the arena's bookkeeping lives in it
+    std::unique_ptr<char[]> initialBlock;
+    google::protobuf::Arena arena;
+    std::string recvBuf;
+    std::string sendBuf;
+    size_t recvCapacity = 0;
+    size_t sendCapacity = 0;
+};
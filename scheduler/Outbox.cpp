@@ -0,0 +1,92 @@
+#include "Outbox.hpp"
+#include "Logger.hpp"
+#include "Util.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Frames gathered into one sendmsg call
+static constexpr size_t MAX_FRAMES_PER_WRITE = 16;
+
+bool Outbox::push(std::string message, Done done) {
+    if (message.size() > MAX_MESSAGE_SIZE) {
+        LOG_ERROR("Message of size=%zu exceeds max message size=%u", message.size(), MAX_MESSAGE_SIZE);
+        return false;
+    }
+    queued += FRAME_HEADER_SIZE + message.size();
+    frames.push_back(Frame{
+        .header = htonl(static_cast<uint32_t>(message.size())),
+        .data = std::move(message),
+        .done = std::move(done)});
+    return true;
+}
+
+bool Outbox::flush(int fd) {
+    while (!frames.empty()) {
+        // Header and data of the first few frames, skipping what of the
+        // front one is already out
+        iovec iov[2 * MAX_FRAMES_PER_WRITE];
+        int count = 0;
+        size_t skip = offset;
+        for (size_t i = 0; i < frames.size() && i < MAX_FRAMES_PER_WRITE; i++) {
+            Frame& frame = frames[i];
+            if (skip < FRAME_HEADER_SIZE) {
+                iov[count++] = {reinterpret_cast<char*>(&frame.header) + skip, FRAME_HEADER_SIZE - skip};
+                skip = 0;
+            } else {
+                skip -= FRAME_HEADER_SIZE;
+            }
+            if (skip < frame.data.size()) {
+                iov[count++] = {frame.data.data() + skip, frame.data.size() - skip};
+            }
+            skip = 0;
+        }
+
+        msghdr hdr{};
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = count;
+        ssize_t bytes = sendmsg(fd, &hdr, MSG_DONTWAIT);
+        if (bytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            LOG_ERROR("Error sending data fd=%d errno=%d, msg=%s", fd, errno, strerror(errno));
+            return false;
+        }
+
+        size_t written = static_cast<size_t>(bytes);
+        queued -= written;
+        while (written > 0) {
+            size_t left = FRAME_HEADER_SIZE + frames.front().data.size() - offset;
+            if (written < left) {
+                offset += written;
+                break;
+            }
+            written -= left;
+            finish();
+        }
+    }
+    return true;
+}
+
+void Outbox::clear() {
+    while (!frames.empty()) {
+        queued -= FRAME_HEADER_SIZE + frames.front().data.size() - offset;
+        finish();
+    }
+}
+
+void Outbox::finish() {
+    Done done = std::move(frames.front().done);
+    frames.pop_front();
+    offset = 0;
+    if (done) {
+        done();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+
+// Frames waiting to go out on one connection. flush writes as much as the
+// socket takes without blocking and leaves the rest for when it is
+// writable again, so one slow reader never holds up the thread writing to
+// every other connection. Frames go out whole and in the order they were
+// pushed. Not thread safe.
+class Outbox {
+public:
+    // Called once a frame has been handed to the socket in full, or when
+    // it is dropped by clear
+    using Done = std::function<void()>;
+
+    Outbox() = default;
+    Outbox(const Outbox&) = delete;
+    Outbox& operator=(const Outbox&) = delete;
+
+    // Queues message as one frame. Returns false, calling nothing, if it
+    // is too large to frame.
+    bool push(std::string message, Done done = {});
+
+    // Writes queued frames until the socket would block. Returns false on
+    // a write error, the frames are left queued.
+    bool flush(int fd);
+
+    // Drops every queued frame, calling their done callbacks in order.
+    // Frames still queued when the outbox is destroyed are dropped without
+    // calling anything.
+    void clear();
+
+    bool empty() const {
+        return frames.empty();
+    }
+
+    // Bytes still to be written, headers included
+    size_t size() const {
+        return queued;
+    }
+
+private:
+    struct Frame {
+        uint32_t header;
+        std::string data;
+        Done done;
+    };
+
+    // Pops the front frame and calls its callback
+    void finish();
+
+    std::deque<Frame> frames;
+    // Bytes of the front frame already written, header included
+    size_t offset = 0;
+    size_t queued = 0;
+};
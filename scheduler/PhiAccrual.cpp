@@ -0,0 +1,30 @@
+#include "PhiAccrual.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+double phi(double elapsed, double mean, double stdDev) {
+    double z = (elapsed - mean) / stdDev;
+    // Probability of the next heartbeat arriving even later than this
+    double later = 0.5 * std::erfc(z / std::sqrt(2.0));
+    if (later <= 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return -std::log10(later);
+}
+
+double phiDeviations(double threshold) {
+    // phi is monotonic in z, so bisect for the z where it hits threshold
+    double low = -10;
+    double high = 40;
+    for (int i = 0; i < 100; i++) {
+        double mid = (low + high) / 2;
+        if (phi(mid, 0, 1) < threshold) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
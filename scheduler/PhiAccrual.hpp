@@ -0,0 +1,30 @@
+#pragma once
+
+// Phi accrual failure detection. Heartbeat inter-arrival times are modelled
+// as a normal distribution and phi is how unlikely it is, on a log10
+// scale, that a worker which is still alive has been silent for elapsed.
+// phi = 1 means a 10% chance of a false positive, phi = 3 a 0.1% chance.
+
+// Returns phi for a silence of elapsed given the mean and standard
+// deviation of the inter-arrival time. All in the same unit.
+double phi(double elapsed, double mean, double stdDev);
+
+// Number of standard deviations past the mean at which phi reaches
+// threshold, so a detector can compute when a worker becomes suspect
+// instead of polling phi.
+double phiDeviations(double threshold);
+
+// Exponentially weighted estimate of the mean and variance of the
+// inter-arrival time.
+struct ArrivalEstimate {
+    static constexpr double ALPHA = 0.1;
+
+    double mean;
+    double variance;
+
+    void add(double interval) {
+        double diff = interval - mean;
+        mean += ALPHA * diff;
+        variance = (1 - ALPHA) * (variance + ALPHA * diff * diff);
+    }
+};
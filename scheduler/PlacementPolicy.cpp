@@ -0,0 +1,130 @@
+#include "PlacementPolicy.hpp"
+#include "Hash.hpp"
+#include "Logger.hpp"
+
+void WorkerPool::add(const WorkerLoad& worker) {
+    if (index.contains(worker.id)) {
+        LOG_ERROR("Worker id=%d already in pool", worker.id);
+        return;
+    }
+    index.insert({worker.id, workers.size()});
+    workers.push_back(worker);
+    freeSlots += worker.spare();
+}
+
+bool WorkerPool::remove(WorkerId id) {
+    if (!index.contains(id)) {
+        return false;
+    }
+
+    // Swap with the last worker so that removal is O(1)
+    size_t i = index.at(id);
+    size_t last = workers.size() - 1;
+    freeSlots -= workers[i].spare();
+    if (i != last) {
+        workers[i] = workers[last];
+        index.insert({workers[i].id, i});
+    }
+    workers.pop_back();
+    index.erase(id);
+    return true;
+}
+
+WorkerLoad* WorkerPool::find(WorkerId id) {
+    if (!index.contains(id)) {
+        return nullptr;
+    }
+    return &workers[index.at(id)];
+}
+
+void WorkerPool::acquire(WorkerLoad& worker) {
+    freeSlots -= worker.spare();
+    worker.inflight++;
+    freeSlots += worker.spare();
+}
+
+void WorkerPool::release(WorkerLoad& worker) {
+    freeSlots -= worker.spare();
+    if (worker.inflight > 0) {
+        worker.inflight--;
+    }
+    freeSlots += worker.spare();
+}
+
+void WorkerPool::setCapacity(WorkerLoad& worker, int capacity) {
+    freeSlots -= worker.spare();
+    worker.capacity = capacity;
+    freeSlots += worker.spare();
+}
+
+void WorkerPool::setSuspect(WorkerLoad& worker, bool suspect) {
+    freeSlots -= worker.spare();
+    worker.suspect = suspect;
+    freeSlots += worker.spare();
+}
+
+WorkerLoad* LeastLoadedPolicy::select(const Scheduler::Task&, WorkerPool& pool) {
+    WorkerLoad* best = nullptr;
+    for (size_t i = 0; i < pool.size(); i++) {
+        WorkerLoad& w = pool[i];
+        if (w.spare() == 0) {
+            continue;
+        }
+        if (best == nullptr || lessLoaded(w, *best)) {
+            best = &w;
+        }
+    }
+    return best;
+}
+
+WorkerLoad* PowerOfTwoChoicesPolicy::select(const Scheduler::Task&, WorkerPool& pool) {
+    if (pool.size() == 0) {
+        return nullptr;
+    }
+
+    std::uniform_int_distribution<size_t> dist{0, pool.size() - 1};
+    WorkerLoad& a = pool[dist(rng)];
+    WorkerLoad& b = pool[dist(rng)];
+    WorkerLoad* best = nullptr;
+    if (a.spare() > 0) {
+        best = &a;
+    }
+    if (b.spare() > 0 && (best == nullptr || lessLoaded(b, *best))) {
+        best = &b;
+    }
+    if (best != nullptr) {
+        return best;
+    }
+
+    // Both samples were full, fall back to a scan rather than
+    // resampling as the pool may be nearly saturated
+    for (size_t i = 0; i < pool.size(); i++) {
+        if (pool[i].spare() > 0 && (best == nullptr || lessLoaded(pool[i], *best))) {
+            best = &pool[i];
+        }
+    }
+    return best;
+}
+
+void ConsistentHashPolicy::addWorker(WorkerId id) {
+    ring.add(id);
+}
+
+void ConsistentHashPolicy::removeWorker(WorkerId id) {
+    ring.remove(id);
+}
+
+WorkerLoad* ConsistentHashPolicy::select(const Scheduler::Task& task, WorkerPool& pool) {
+    if (!task.has_key()) {
+        return fallback.select(task, pool);
+    }
+
+    WorkerId id = ring.lookup(mix64(fnv1a(task.key())), [&pool](int id) {
+        WorkerLoad* w = pool.find(id);
+        return w != nullptr && w->spare() > 0;
+    });
+    if (id == -1) {
+        return nullptr;
+    }
+    return pool.find(id);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "HashRing.hpp"
+#include "Hashmap.hpp"
+#include "Protocol.hpp"
+#include "SharedPtr.hpp"
+#include "Vector.hpp"
+#include "Worker.hpp"
+#include "message.pb.h"
+
+#include <mutex>
+#include <random>
+
+struct WorkerLoad {
+    WorkerId id = -1;
+    int fd = -1;
+    // Number of tasks the worker is willing to run concurrently
+    int capacity = 1;
+    // Tasks dispatched to the worker that have not been completed yet
+    int inflight = 0;
+    // Load average reported by the worker on its last heartbeat
+    float load = 0;
+    // Protocol version negotiated in the handshake
+    uint32_t version = PROTOCOL_VERSION;
+    // Heartbeats are overdue enough that the worker may have failed, no
+    // more tasks are placed on it until it is heard from again
+    bool suspect = false;
+    // Held for every write to fd, which more than one thread sends on
+    SharedPtr<std::mutex> sendLock;
+
+    int spare() const {
+        if (suspect) {
+            return 0;
+        }
+        return capacity > inflight ? capacity - inflight : 0;
+    }
+
+    double utilisation() const {
+        return capacity == 0 ? 1.0 : static_cast<double>(inflight) / capacity;
+    }
+};
+
+// Returns true if a is a better placement than b.
+inline bool lessLoaded(const WorkerLoad& a, const WorkerLoad& b) {
+    if (a.utilisation() != b.utilisation()) {
+        return a.utilisation() < b.utilisation();
+    }
+    return a.load < b.load;
+}
+
+// Set of connected workers, indexed by id, that keeps track of the
+// total number of free slots so that the distributor can check for
+// capacity in O(1).
+class WorkerPool {
+public:
+    void add(const WorkerLoad& worker);
+    bool remove(WorkerId id);
+    WorkerLoad* find(WorkerId id);
+
+    // Mutators that keep the free slot count consistent
+    void acquire(WorkerLoad& worker);
+    void release(WorkerLoad& worker);
+    void setCapacity(WorkerLoad& worker, int capacity);
+    void setSuspect(WorkerLoad& worker, bool suspect);
+
+    bool hasCapacity() const {
+        return freeSlots > 0;
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    WorkerLoad& operator[](size_t i) {
+        return workers[i];
+    }
+
+private:
+    Vector<WorkerLoad> workers;
+    Hashmap<WorkerId, size_t> index;
+    long freeSlots = 0;
+};
+
+class IPlacementPolicy {
+public:
+    virtual void addWorker(WorkerId) {}
+    virtual void removeWorker(WorkerId) {}
+
+    // Picks the worker the task should be placed on out of the workers
+    // in the pool with a free slot. Returns nullptr if there is none.
+    virtual WorkerLoad* select(const Scheduler::Task& task, WorkerPool& pool) = 0;
+    virtual ~IPlacementPolicy() = default;
+};
+
+// Scans every worker and picks the one with the lowest utilisation.
+class LeastLoadedPolicy: public IPlacementPolicy {
+public:
+    WorkerLoad* select(const Scheduler::Task& task, WorkerPool& pool) override;
+};
+
+// Samples two workers at random and picks the less loaded one. Gets
+// most of the benefit of least loaded without the O(N) scan or every
+// dispatcher herding onto the same worker.
+class PowerOfTwoChoicesPolicy: public IPlacementPolicy {
+public:
+    WorkerLoad* select(const Scheduler::Task& task, WorkerPool& pool) override;
+
+private:
+    std::mt19937 rng{std::random_device{}()};
+};
+
+// Places tasks with the same key on the same worker so that the
+// worker's local caches are reused. If the owner of a key is full the
+// task spills over to the next worker on the ring. Tasks without a key
+// are placed on the least loaded worker.
+class ConsistentHashPolicy: public IPlacementPolicy {
+public:
+    explicit ConsistentHashPolicy(int virtualNodes = 64): ring(virtualNodes) {}
+    void addWorker(WorkerId id) override;
+    void removeWorker(WorkerId id) override;
+    WorkerLoad* select(const Scheduler::Task& task, WorkerPool& pool) override;
+
+private:
+    HashRing ring;
+    LeastLoadedPolicy fallback;
+};
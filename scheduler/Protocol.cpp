@@ -0,0 +1,132 @@
+#include "Protocol.hpp"
+#include "Logger.hpp"
+#include "Network.hpp"
+
+#include <string>
+
+bool upgradeMessage(Scheduler::Message& msg) {
+    if (msg.payload_case() != Scheduler::Message::PAYLOAD_NOT_SET || !msg.has_data()) {
+        return true;
+    }
+
+    bool success = true;
+    switch (msg.type()) {
+        case (Scheduler::MessageType::MESSAGE_TYPE_HEARTBEAT):
+        case (Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_RES): {
+            success = msg.mutable_heartbeat()->ParseFromString(msg.data());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ): {
+            success = msg.mutable_task()->ParseFromString(msg.data());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_RES): {
+            success = msg.mutable_task_response()->ParseFromString(msg.data());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_REQ): {
+            success = msg.mutable_task_batch()->ParseFromString(msg.data());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES): {
+            success = msg.mutable_task_response_batch()->ParseFromString(msg.data());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_RESULT_CHUNK): {
+            success = msg.mutable_result_chunk()->ParseFromString(msg.data());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_CHUNK_ACK): {
+            success = msg.mutable_chunk_ack()->ParseFromString(msg.data());
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    if (!success) {
+        LOG_ERROR("Error deserializing legacy payload type=%d", msg.type());
+        return false;
+    }
+    msg.clear_data();
+    return true;
+}
+
+bool downgradeMessage(Scheduler::Message& msg) {
+    std::string data;
+    bool success = true;
+    switch (msg.payload_case()) {
+        case (Scheduler::Message::kTask): {
+            success = msg.task().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::kTaskResponse): {
+            success = msg.task_response().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::kHeartbeat): {
+            success = msg.heartbeat().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::kTaskBatch): {
+            success = msg.task_batch().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::kTaskResponseBatch): {
+            success = msg.task_response_batch().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::kResultChunk): {
+            success = msg.result_chunk().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::kChunkAck): {
+            success = msg.chunk_ack().SerializeToString(&data);
+            break;
+        }
+        case (Scheduler::Message::PAYLOAD_NOT_SET): {
+            return true;
+        }
+    }
+    if (!success) {
+        LOG_ERROR("Error serializing legacy payload type=%d", msg.type());
+        return false;
+    }
+    msg.clear_payload();
+    msg.set_data(std::move(data));
+    return true;
+}
+
+bool sendMessage(int fd, Scheduler::Message& msg, uint32_t peerVersion) {
+    std::string buffer;
+    return sendMessage(fd, msg, peerVersion, buffer);
+}
+
+bool serializeMessage(Scheduler::Message& msg, uint32_t peerVersion, std::string& buffer) {
+    if (peerVersion < PROTOCOL_VERSION) {
+        if (!downgradeMessage(msg)) {
+            return false;
+        }
+        msg.clear_version();
+    } else {
+        msg.set_version(PROTOCOL_VERSION);
+    }
+
+    if (!msg.SerializeToString(&buffer)) {
+        LOG_ERROR("Error serializing message type=%d", msg.type());
+        return false;
+    }
+    return true;
+}
+
+bool sendMessage(int fd, Scheduler::Message& msg, uint32_t peerVersion, std::string& buffer) {
+    if (!serializeMessage(msg, peerVersion, buffer)) {
+        return false;
+    }
+
+    if (!Send(fd, buffer)) {
+        LOG_ERROR("Error sending message type=%d fd=%d", msg.type(), fd);
+        return false;
+    }
+    return true;
+}
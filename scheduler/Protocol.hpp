@@ -0,0 +1,43 @@
+#pragma once
+
+#include "message.pb.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Version spoken by this build, see Scheduler::Message. Both versions
+// use length prefixed frames, version 1 is a peer that frames messages but
+// still nests the payload in data. Peers from before framing can't talk
+// to either.
+static constexpr uint32_t PROTOCOL_VERSION = 2;
+static constexpr uint32_t LEGACY_PROTOCOL_VERSION = 1;
+
+// Results larger than this are streamed in chunks of this size so that
+// heartbeats can be sent in between them
+static constexpr size_t RESULT_CHUNK_SIZE = 64 * 1024;
+// Streamed bytes a worker may have outstanding before it waits for the
+// master to acknowledge them. Bounds how much a heartbeat can queue behind.
+static constexpr size_t RESULT_WINDOW_SIZE = 4 * RESULT_CHUNK_SIZE;
+
+inline uint32_t messageVersion(const Scheduler::Message& msg) {
+    return msg.has_version() ? msg.version() : LEGACY_PROTOCOL_VERSION;
+}
+
+// Moves a payload sent by a version 1 peer out of data and into the
+// payload oneof so that handlers only have to deal with one layout.
+bool upgradeMessage(Scheduler::Message& msg);
+
+// Serializes the payload into data for a version 1 peer.
+bool downgradeMessage(Scheduler::Message& msg);
+
+// Stamps the message with our version, downgrading it if the peer only
+// speaks version 1, and serializes it into buffer.
+bool serializeMessage(Scheduler::Message& msg, uint32_t peerVersion, std::string& buffer);
+
+// Serializes the message as above and sends it as a single frame.
+bool sendMessage(int fd, Scheduler::Message& msg, uint32_t peerVersion = PROTOCOL_VERSION);
+
+// Same as above but serializes into buffer so that callers on a hot path
+// can reuse its capacity
+bool sendMessage(int fd, Scheduler::Message& msg, uint32_t peerVersion, std::string& buffer);
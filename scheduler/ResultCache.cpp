@@ -0,0 +1,137 @@
+#include "ResultCache.hpp"
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <bit>
+
+ResultCache::FrequencySketch::FrequencySketch(size_t capacity):
+        // A few counters per entry keep collisions from inflating the
+        // estimates of keys that were only seen once
+        counters(std::bit_ceil(std::max<size_t>(16, capacity * COUNTERS_PER_ENTRY)) * DEPTH),
+        mask(counters.size() / DEPTH - 1), sampleSize(10 * std::max<size_t>(1, capacity)) {}
+
+size_t ResultCache::FrequencySketch::index(uint64_t key, int row) const {
+    uint64_t hash = mix64(key + row * 0x9e3779b97f4a7c15ULL);
+    return row * (mask + 1) + (hash & mask);
+}
+
+void ResultCache::FrequencySketch::increment(uint64_t key) {
+    for (int row = 0; row < DEPTH; row++) {
+        uint8_t& counter = counters[index(key, row)];
+        if (counter < MAX_COUNT) {
+            counter++;
+        }
+    }
+    if (++additions >= sampleSize) {
+        for (uint8_t& counter: counters) {
+            counter >>= 1;
+        }
+        additions /= 2;
+    }
+}
+
+uint8_t ResultCache::FrequencySketch::frequency(uint64_t key) const {
+    uint8_t frequency = MAX_COUNT;
+    for (int row = 0; row < DEPTH; row++) {
+        frequency = std::min(frequency, counters[index(key, row)]);
+    }
+    return frequency;
+}
+
+ResultCache::ResultCache(size_t capacity): capacity(std::max<size_t>(1, capacity)),
+        windowCapacity(std::max<size_t>(1, this->capacity * WINDOW_PERCENT / 100)),
+        protectedCapacity((this->capacity - std::min(this->capacity, windowCapacity)) * PROTECTED_PERCENT / 100),
+        sketch(this->capacity) {}
+
+std::string ResultCache::content(const Scheduler::Task& task) {
+    std::string content;
+    content.reserve(sizeof(uint32_t) + task.payload().size());
+    uint32_t type = task.type();
+    for (size_t i = 0; i < sizeof(type); i++) {
+        content.push_back(static_cast<char>(type >> (8 * i)));
+    }
+    content += task.payload();
+    return content;
+}
+
+uint64_t ResultCache::key(std::string_view content) {
+    return fnv1a(content);
+}
+
+bool ResultCache::get(uint64_t key, std::string_view content, std::string& result) {
+    sketch.increment(key);
+    auto it = index.find(key);
+    if (it == index.end() || it->second->content != content) {
+        missCount++;
+        return false;
+    }
+    hitCount++;
+    touch(it->second);
+    result = it->second->result;
+    return true;
+}
+
+void ResultCache::put(uint64_t key, std::string content, std::string result) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->content = std::move(content);
+        it->second->result = std::move(result);
+        touch(it->second);
+        return;
+    }
+
+    window.push_front(Entry{.key = key, .content = std::move(content), .result = std::move(result),
+            .segment = Segment::Window});
+    index.insert({key, window.begin()});
+    if (window.size() > windowCapacity) {
+        evictFromWindow();
+    }
+}
+
+void ResultCache::touch(List::iterator it) {
+    switch (it->segment) {
+        case (Segment::Window): {
+            window.splice(window.begin(), window, it);
+            break;
+        }
+        case (Segment::Probation): {
+            // Promoted, making room by demoting the least recent
+            it->segment = Segment::Protected;
+            protectedList.splice(protectedList.begin(), probation, it);
+            if (protectedList.size() > protectedCapacity) {
+                List::iterator demoted = std::prev(protectedList.end());
+                demoted->segment = Segment::Probation;
+                probation.splice(probation.begin(), protectedList, demoted);
+            }
+            break;
+        }
+        case (Segment::Protected): {
+            protectedList.splice(protectedList.begin(), protectedList, it);
+            break;
+        }
+    }
+}
+
+void ResultCache::evictFromWindow() {
+    List::iterator candidate = std::prev(window.end());
+    candidate->segment = Segment::Probation;
+    probation.splice(probation.begin(), window, candidate);
+    if (index.size() <= capacity) {
+        return;
+    }
+
+    // The candidate only stays if it is asked for more often than the
+    // entry the main segment would evict for it
+    List& victims = probation.size() > 1 || protectedList.empty() ? probation : protectedList;
+    List::iterator victim = std::prev(victims.end());
+    if (sketch.frequency(candidate->key) > sketch.frequency(victim->key)) {
+        evict(victim, victims);
+    } else {
+        evict(candidate, probation);
+    }
+}
+
+void ResultCache::evict(List::iterator it, List& list) {
+    index.erase(it->key);
+    list.erase(it);
+}
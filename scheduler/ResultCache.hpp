@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Hashmap.hpp"
+#include "message.pb.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bounded cache of task results keyed by the content of the task. Uses
+// W-TinyLFU: new entries go through a small LRU window, and only move on
+// to the main segmented LRU if they have been asked for more often than
+// the entry they would evict. A scan of one off tasks therefore can't
+// flush the results that are actually reused.
+class ResultCache {
+    enum class Segment {
+        Window,
+        Probation,
+        Protected,
+    };
+
+    struct Entry {
+        uint64_t key;
+        // What the key was computed from, two contents sharing a key must
+        // never be taken for one another
+        std::string content;
+        std::string result;
+        Segment segment;
+    };
+
+    using List = std::list<Entry>;
+
+    // Count-min sketch of how often keys were asked for, halved every
+    // sampleSize additions so that it follows changes in popularity
+    class FrequencySketch {
+    public:
+        explicit FrequencySketch(size_t capacity);
+        void increment(uint64_t key);
+        uint8_t frequency(uint64_t key) const;
+
+    private:
+        static constexpr int DEPTH = 4;
+        static constexpr uint8_t MAX_COUNT = 15;
+        static constexpr size_t COUNTERS_PER_ENTRY = 8;
+        size_t index(uint64_t key, int row) const;
+        std::vector<uint8_t> counters;
+        size_t mask;
+        size_t additions = 0;
+        size_t sampleSize;
+    };
+
+public:
+    // Window share of the capacity, and protected share of the rest
+    static constexpr size_t WINDOW_PERCENT = 1;
+    static constexpr size_t PROTECTED_PERCENT = 80;
+
+    explicit ResultCache(size_t capacity);
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // What identical tasks have in common: the type followed by the
+    // payload
+    static std::string content(const Scheduler::Task& task);
+    // Hash of content. Only narrows down the lookup, entries are compared
+    // on their whole content.
+    static uint64_t key(std::string_view content);
+
+    // Counts towards the key's frequency whether it hits or not. An entry
+    // under key for other content is a miss.
+    bool get(uint64_t key, std::string_view content, std::string& result);
+    // Replaces whatever is stored under key
+    void put(uint64_t key, std::string content, std::string result);
+
+    size_t size() const {
+        return index.size();
+    }
+
+    uint64_t hits() const {
+        return hitCount;
+    }
+
+    uint64_t misses() const {
+        return missCount;
+    }
+
+private:
+    void touch(List::iterator it);
+    void evictFromWindow();
+    void evict(List::iterator it, List& list);
+    size_t capacity;
+    size_t windowCapacity;
+    size_t protectedCapacity;
+    // Most recently used at the front
+    List window;
+    List probation;
+    List protectedList;
+    Hashmap<uint64_t, List::iterator> index;
+    FrequencySketch sketch;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
@@ -0,0 +1,37 @@
+#include "ShardMap.hpp"
+#include "Hash.hpp"
+#include "Logger.hpp"
+
+#include <utility>
+
+bool ShardMap::parse(std::string_view description, ShardMap& map) {
+    ShardMap parsed;
+    while (!description.empty()) {
+        size_t end = description.find(',');
+        std::string_view entry = description.substr(0, end);
+        description = end == std::string_view::npos ? std::string_view{} : description.substr(end + 1);
+
+        size_t colon = entry.rfind(':');
+        if (colon == std::string_view::npos || colon == 0 || colon + 1 == entry.size()) {
+            LOG_ERROR("Invalid master address %.*s", static_cast<int>(entry.size()), entry.data());
+            return false;
+        }
+        parsed.add(MasterAddress{.hostname = std::string{entry.substr(0, colon)},
+                .port = std::string{entry.substr(colon + 1)}});
+    }
+    if (parsed.size() == 0) {
+        LOG_ERROR("Shard map lists no masters");
+        return false;
+    }
+    map = std::move(parsed);
+    return true;
+}
+
+int ShardMap::shardOf(std::string_view key) const {
+    return ring.lookup(mix64(fnv1a(key)));
+}
+
+void ShardMap::add(MasterAddress address) {
+    ring.add(masters.size());
+    masters.push_back(std::move(address));
+}
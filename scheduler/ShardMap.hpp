@@ -0,0 +1,44 @@
+#pragma once
+
+#include "HashRing.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct MasterAddress {
+    std::string hostname;
+    std::string port;
+};
+
+// Masters sharing the task space, each owning the keys the ring maps to
+// it. Built from a description like "host1:8999,host2:8999" that every
+// client and worker is given, so they all map a key to the same master.
+// Shards are numbered in the order the masters are listed.
+class ShardMap {
+public:
+    // More than placement's 64: the ring only ever holds a few masters,
+    // and with so few nodes it takes more points each for their shares of
+    // the keys to stay even
+    static constexpr int VIRTUAL_NODES = 256;
+
+    ShardMap(): ring(VIRTUAL_NODES) {}
+    // Returns false, leaving map untouched, if an entry isn't host:port
+    static bool parse(std::string_view description, ShardMap& map);
+    void add(MasterAddress address);
+
+    int shardOf(std::string_view key) const;
+
+    const MasterAddress& master(int shard) const {
+        return masters[shard];
+    }
+
+    size_t size() const {
+        return masters.size();
+    }
+
+private:
+    std::vector<MasterAddress> masters;
+    HashRing ring;
+};
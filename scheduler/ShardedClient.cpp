@@ -0,0 +1,53 @@
+#include "ShardedClient.hpp"
+#include "Logger.hpp"
+
+#include <string>
+#include <utility>
+
+ShardedClient::ShardedClient(ShardMap shards): shards(std::move(shards)) {
+    for (size_t shard = 0; shard < this->shards.size(); shard++) {
+        const MasterAddress& master = this->shards.master(shard);
+        clients.emplace_back(new Client(master.hostname.c_str(), master.port.c_str()));
+    }
+}
+
+bool ShardedClient::connect() {
+    for (size_t shard = 0; shard < clients.size(); shard++) {
+        if (!clients[shard]->connect()) {
+            const MasterAddress& master = shards.master(shard);
+            LOG_ERROR("Error connecting to master %s:%s", master.hostname.c_str(), master.port.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+int ShardedClient::shardOf(const Scheduler::Task& task, std::string_view key) {
+    if (!key.empty()) {
+        return shards.shardOf(key);
+    }
+    if (task.cacheable()) {
+        std::string content = std::to_string(task.type()) + ":" + task.payload();
+        return shards.shardOf(content);
+    }
+    return nextShard.fetch_add(1, std::memory_order_relaxed) % clients.size();
+}
+
+std::future<TaskResult> ShardedClient::submit(Scheduler::Task task, std::string_view key) {
+    std::future<TaskResult> future;
+    int shard;
+    submit(std::move(task), key, future, shard);
+    return future;
+}
+
+uint64_t ShardedClient::submit(Scheduler::Task task, std::string_view key, std::future<TaskResult>& result,
+        int& shard) {
+    shard = shardOf(task, key);
+    return clients[shard]->submit(std::move(task), result);
+}
+
+void ShardedClient::close() {
+    for (UniquePtr<Client>& client: clients) {
+        client->close();
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Client.hpp"
+#include "ShardMap.hpp"
+#include "UniquePtr.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <string_view>
+#include <vector>
+
+// Client of a sharded cluster, submitting each task to the master owning
+// its key. Keeps a session with every master of the shard map.
+class ShardedClient {
+public:
+    explicit ShardedClient(ShardMap shards);
+    ShardedClient(const ShardedClient&) = delete;
+    ShardedClient& operator=(const ShardedClient&) = delete;
+    // Fails unless every master accepts the client
+    bool connect();
+    // Tasks without a key are keyed by their content when cacheable, so
+    // that identical ones meet on the same master, and spread round robin
+    // otherwise
+    std::future<TaskResult> submit(Scheduler::Task task, std::string_view key = {});
+    // Dependencies only resolve within a shard, so a task has to be given
+    // the key of the tasks it depends on. Returns the id to depend on it
+    // with along with its shard.
+    uint64_t submit(Scheduler::Task task, std::string_view key, std::future<TaskResult>& result, int& shard);
+    int shardOf(const Scheduler::Task& task, std::string_view key = {});
+    void close();
+
+private:
+    ShardMap shards;
+    // One per shard, in the order of the shard map
+    std::vector<UniquePtr<Client>> clients;
+    std::atomic<uint64_t> nextShard = 0;
+};
@@ -0,0 +1,45 @@
+#include "ShardedWorker.hpp"
+#include "Logger.hpp"
+
+#include <utility>
+
+ShardedWorker::ShardedWorker(ShardMap shards, std::chrono::seconds heartbeatInterval, int capacity):
+        shards(std::move(shards)) {
+    for (size_t shard = 0; shard < this->shards.size(); shard++) {
+        const MasterAddress& master = this->shards.master(shard);
+        workers.emplace_back(new Worker(master.hostname.c_str(), master.port.c_str(), heartbeatInterval, capacity));
+    }
+}
+
+void ShardedWorker::setHandler(Scheduler::TaskType type, TaskHandler handler) {
+    for (UniquePtr<Worker>& worker: workers) {
+        worker->setHandler(type, handler);
+    }
+}
+
+void ShardedWorker::setReconnectTimeout(std::chrono::seconds timeout) {
+    for (UniquePtr<Worker>& worker: workers) {
+        worker->setReconnectTimeout(timeout);
+    }
+}
+
+bool ShardedWorker::connect() {
+    for (size_t shard = 0; shard < workers.size(); shard++) {
+        if (!workers[shard]->connect()) {
+            const MasterAddress& master = shards.master(shard);
+            LOG_ERROR("Error connecting worker to master %s:%s", master.hostname.c_str(), master.port.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShardedWorker::run() {
+    std::vector<std::thread> threads;
+    for (UniquePtr<Worker>& worker: workers) {
+        threads.emplace_back(&Worker::run, worker.get());
+    }
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+}
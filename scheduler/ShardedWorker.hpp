@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ShardMap.hpp"
+#include "UniquePtr.hpp"
+#include "Worker.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Worker process serving every master of a sharded cluster. Runs a session
+// per master, each with its own slots and on its own thread, so a master
+// losing its share of work does not leave the process idle.
+class ShardedWorker {
+public:
+    explicit ShardedWorker(ShardMap shards, std::chrono::seconds heartbeatInterval = std::chrono::seconds{1},
+            int capacity = 1);
+    ShardedWorker(const ShardedWorker&) = delete;
+    ShardedWorker& operator=(const ShardedWorker&) = delete;
+    void setHandler(Scheduler::TaskType type, TaskHandler handler);
+    void setReconnectTimeout(std::chrono::seconds timeout);
+    // Fails unless every master accepts the worker
+    bool connect();
+    // Returns once every session has ended
+    void run();
+
+private:
+    ShardMap shards;
+    std::vector<UniquePtr<Worker>> workers;
+};
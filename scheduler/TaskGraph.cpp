@@ -0,0 +1,105 @@
+#include "TaskGraph.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+void TaskGraph::add(uint64_t id, Scheduler::Task task, const Vector<uint64_t>& dependencies) {
+    SharedPtr<Node> node = makeShared<Node>();
+    node->cost = std::max<uint64_t>(1, task.cost());
+    node->rank = node->cost;
+    node->task = std::move(task);
+    nodes.insert({id, node});
+
+    for (uint64_t dependency: dependencies) {
+        auto it = nodes.find(dependency);
+        if (it == nodes.end() || dependency == id) {
+            continue;
+        }
+        it->second->successors.push_back(id);
+        node->predecessors.push_back(dependency);
+        node->waitingOn++;
+        raiseRank(dependency, node->rank);
+    }
+    if (node->waitingOn == 0) {
+        ready.push_back(id);
+    }
+}
+
+void TaskGraph::raiseRank(uint64_t id, uint64_t successorRank) {
+    // Only walks up as far as ranks actually change
+    Vector<std::pair<uint64_t, uint64_t>> stack;
+    stack.push_back({id, successorRank});
+    while (stack.size() > 0) {
+        auto [current, rank] = stack[stack.size() - 1];
+        stack.pop_back();
+        auto it = nodes.find(current);
+        if (it == nodes.end()) {
+            continue;
+        }
+        Node& node = *it->second;
+        if (node.cost + rank <= node.rank) {
+            continue;
+        }
+        node.rank = node.cost + rank;
+        for (uint64_t predecessor: node.predecessors) {
+            stack.push_back({predecessor, node.rank});
+        }
+    }
+}
+
+bool TaskGraph::popReady(Scheduler::Task& task, uint64_t& rank) {
+    while (!ready.empty()) {
+        uint64_t id = ready.front();
+        ready.pop_front();
+        auto it = nodes.find(id);
+        // Failed along with a dependency after it became ready
+        if (it == nodes.end()) {
+            continue;
+        }
+        task = std::move(it->second->task);
+        rank = it->second->rank;
+        return true;
+    }
+    return false;
+}
+
+void TaskGraph::complete(uint64_t id, bool success, Vector<uint64_t>& failed) {
+    auto it = nodes.find(id);
+    if (it == nodes.end()) {
+        return;
+    }
+    SharedPtr<Node> node = it->second;
+    nodes.erase(id);
+
+    if (success) {
+        for (uint64_t successor: node->successors) {
+            auto next = nodes.find(successor);
+            if (next != nodes.end() && --next->second->waitingOn == 0) {
+                ready.push_back(successor);
+            }
+        }
+        return;
+    }
+
+    Vector<uint64_t> stack;
+    for (uint64_t successor: node->successors) {
+        stack.push_back(successor);
+    }
+    while (stack.size() > 0) {
+        uint64_t current = stack[stack.size() - 1];
+        stack.pop_back();
+        auto next = nodes.find(current);
+        if (next == nodes.end()) {
+            continue;
+        }
+        SharedPtr<Node> dependent = next->second;
+        nodes.erase(current);
+        failed.push_back(current);
+        for (uint64_t successor: dependent->successors) {
+            stack.push_back(successor);
+        }
+    }
+    if (failed.size() > 0) {
+        LOG_INFO("Task %llu failed, failing %zu tasks that depend on it", id, failed.size());
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Hashmap.hpp"
+#include "message.pb.h"
+#include "SharedPtr.hpp"
+#include "Vector.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Holds submitted tasks until the tasks they depend on have completed.
+// Every task is ranked by the cost of the longest chain of tasks that
+// starts at it, so that the critical path of a graph is dispatched ahead
+// of work that can wait. Only used from the master's event loop.
+class TaskGraph {
+    struct Node {
+        // Moved out once the task is ready
+        Scheduler::Task task;
+        Vector<uint64_t> predecessors;
+        Vector<uint64_t> successors;
+        // Predecessors that have not completed yet
+        uint32_t waitingOn = 0;
+        uint64_t cost = 1;
+        uint64_t rank = 1;
+    };
+
+public:
+    // Adds a task that waits for dependencies. Those that are no longer in
+    // the graph have completed already. As dependencies have to be added
+    // first, the graph can't have cycles.
+    void add(uint64_t id, Scheduler::Task task, const Vector<uint64_t>& dependencies);
+    // Pops a task whose dependencies have all completed, along with its
+    // rank. The rank includes every task added since it became ready.
+    bool popReady(Scheduler::Task& task, uint64_t& rank);
+    // Releases the tasks waiting for a completed task. If it failed, the
+    // tasks depending on it can't run either and are removed along with
+    // everything that depends on them, their ids are appended to failed.
+    void complete(uint64_t id, bool success, Vector<uint64_t>& failed);
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+private:
+    void raiseRank(uint64_t id, uint64_t successorRank);
+    Hashmap<uint64_t, SharedPtr<Node>> nodes;
+    std::deque<uint64_t> ready;
+};
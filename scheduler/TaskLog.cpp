@@ -0,0 +1,289 @@
+#include "TaskLog.hpp"
+#include "Logger.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t bytes = write(fd, data, len);
+        if (bytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Error writing task log errno=%d, msg=%s", errno, strerror(errno));
+            return false;
+        }
+        data += bytes;
+        len -= bytes;
+    }
+    return true;
+}
+
+static bool flushToDisk(int fd) {
+#ifdef F_FULLFSYNC
+    // fsync on macOS leaves the data in the drive's cache
+    if (fcntl(fd, F_FULLFSYNC) == 0) {
+        return true;
+    }
+#endif
+    return fsync(fd) == 0;
+}
+
+// A missing file reads as empty
+static bool readFile(const std::string& path, std::string& contents) {
+    contents.clear();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return errno == ENOENT;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return false;
+    }
+    contents.resize(st.st_size);
+    size_t offset = 0;
+    while (offset < contents.size()) {
+        ssize_t bytes = read(fd, contents.data() + offset, contents.size() - offset);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            break;
+        }
+        offset += bytes;
+    }
+    close(fd);
+    contents.resize(offset);
+    return true;
+}
+
+static void frame(const std::string& record, std::string& out) {
+    uint32_t header = htonl(static_cast<uint32_t>(record.size()));
+    out.append(reinterpret_cast<const char*>(&header), FRAME_HEADER_SIZE);
+    out.append(record);
+}
+
+TaskLog::TaskLog(std::string directory): directory(std::move(directory)) {}
+
+std::string TaskLog::logPath() const {
+    return directory + "/tasks.log";
+}
+
+std::string TaskLog::snapshotPath() const {
+    return directory + "/tasks.snapshot";
+}
+
+bool TaskLog::open(const std::function<void(const Scheduler::LogRecord& record)>& restore) {
+    if (mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST) {
+        LOG_ERROR("Error creating task log directory=%s errno=%d", directory.c_str(), errno);
+        return false;
+    }
+
+    size_t snapshotSize = 0;
+    size_t logSize = 0;
+    if (!load(snapshotPath(), snapshotSize) || !load(logPath(), logSize)) {
+        return false;
+    }
+
+    fd = ::open(logPath().c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+        LOG_ERROR("Error opening task log errno=%d, msg=%s", errno, strerror(errno));
+        return false;
+    }
+    // Appends have to start after the last whole record
+    if (ftruncate(fd, logSize) == -1) {
+        LOG_ERROR("Error truncating task log errno=%d, msg=%s", errno, strerror(errno));
+        return false;
+    }
+
+    // Restored in the order they were submitted, ids increase with it
+    std::vector<uint64_t> ids;
+    ids.reserve(pending.size());
+    for (auto& [id, record]: pending) {
+        ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+    Scheduler::LogRecord record;
+    for (uint64_t id: ids) {
+        record.ParseFromString(pending.at(id));
+        restore(record);
+    }
+    LOG_INFO("Task log restored %zu pending tasks", ids.size());
+    return true;
+}
+
+bool TaskLog::load(const std::string& path, size_t& validSize) {
+    std::string contents;
+    if (!readFile(path, contents)) {
+        LOG_ERROR("Error reading %s errno=%d", path.c_str(), errno);
+        return false;
+    }
+
+    size_t offset = 0;
+    std::string record;
+    while (offset + FRAME_HEADER_SIZE <= contents.size()) {
+        uint32_t header;
+        memcpy(&header, contents.data() + offset, FRAME_HEADER_SIZE);
+        size_t len = ntohl(header);
+        if (offset + FRAME_HEADER_SIZE + len > contents.size()) {
+            break;
+        }
+        record.assign(contents, offset + FRAME_HEADER_SIZE, len);
+        apply(record);
+        offset += FRAME_HEADER_SIZE + len;
+        records++;
+    }
+    if (offset != contents.size()) {
+        LOG_ERROR("Ignoring %zu bytes torn off the end of %s", contents.size() - offset, path.c_str());
+    }
+    validSize = offset;
+    return true;
+}
+
+void TaskLog::apply(const std::string& record) {
+    Scheduler::LogRecord entry;
+    if (!entry.ParseFromString(record)) {
+        LOG_ERROR("Error parsing task log record");
+        return;
+    }
+    switch (entry.type()) {
+        case (Scheduler::LogRecordType::LOG_RECORD_TYPE_SUBMIT): {
+            pending.insert({entry.id(), record});
+            nextTask = std::max(nextTask, entry.id() + 1);
+            nextClient = std::max(nextClient, entry.client_id() + 1);
+            break;
+        }
+        case (Scheduler::LogRecordType::LOG_RECORD_TYPE_COMPLETE): {
+            pending.erase(entry.id());
+            break;
+        }
+        case (Scheduler::LogRecordType::LOG_RECORD_TYPE_SNAPSHOT): {
+            nextTask = std::max(nextTask, entry.next_task_id());
+            nextClient = std::max(nextClient, entry.next_client_id());
+            break;
+        }
+    }
+}
+
+void TaskLog::submit(uint64_t id, const Scheduler::Task& task, int clientId, uint64_t requestId) {
+    Scheduler::LogRecord record;
+    record.set_type(Scheduler::LogRecordType::LOG_RECORD_TYPE_SUBMIT);
+    record.set_id(id);
+    *record.mutable_task() = task;
+    record.mutable_task()->set_id(id);
+    record.set_client_id(clientId);
+    record.set_request_id(requestId);
+
+    std::string serialized;
+    record.SerializeToString(&serialized);
+    append(serialized);
+    pending.insert({id, std::move(serialized)});
+    nextTask = std::max(nextTask, id + 1);
+    nextClient = std::max(nextClient, clientId + 1);
+}
+
+void TaskLog::complete(uint64_t id) {
+    if (!pending.contains(id)) {
+        return;
+    }
+    pending.erase(id);
+    Scheduler::LogRecord record;
+    record.set_type(Scheduler::LogRecordType::LOG_RECORD_TYPE_COMPLETE);
+    record.set_id(id);
+    std::string serialized;
+    record.SerializeToString(&serialized);
+    append(serialized);
+}
+
+void TaskLog::append(const std::string& record) {
+    frame(record, buffer);
+    records++;
+}
+
+bool TaskLog::sync() {
+    if (buffer.empty()) {
+        return true;
+    }
+    if (fd == -1) {
+        LOG_ERROR("Task log is not open");
+        return false;
+    }
+    if (!writeAll(fd, buffer.data(), buffer.size()) || !flushToDisk(fd)) {
+        return false;
+    }
+    buffer.clear();
+
+    if (records > std::max(MIN_COMPACT_RECORDS, 2 * pending.size())) {
+        return compact();
+    }
+    return true;
+}
+
+bool TaskLog::compact() {
+    std::string tmpPath = snapshotPath() + ".tmp";
+    int snapshotFd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (snapshotFd == -1) {
+        LOG_ERROR("Error creating snapshot errno=%d, msg=%s", errno, strerror(errno));
+        return false;
+    }
+
+    Scheduler::LogRecord header;
+    header.set_type(Scheduler::LogRecordType::LOG_RECORD_TYPE_SNAPSHOT);
+    header.set_next_task_id(nextTask);
+    header.set_next_client_id(nextClient);
+    std::string out;
+    frame(header.SerializeAsString(), out);
+
+    // Written out in large chunks rather than a record at a time
+    static constexpr size_t WRITE_SIZE = 1024 * 1024;
+    bool success = true;
+    for (auto& [id, record]: pending) {
+        frame(record, out);
+        if (out.size() >= WRITE_SIZE) {
+            success = writeAll(snapshotFd, out.data(), out.size());
+            out.clear();
+            if (!success) {
+                break;
+            }
+        }
+    }
+    success = success && writeAll(snapshotFd, out.data(), out.size()) && flushToDisk(snapshotFd);
+    close(snapshotFd);
+    if (!success || rename(tmpPath.c_str(), snapshotPath().c_str()) == -1) {
+        LOG_ERROR("Error writing snapshot errno=%d, msg=%s", errno, strerror(errno));
+        return false;
+    }
+
+    // The rename has to be durable before the log it replaces is dropped.
+    // Replaying a log that was not truncated on top of the new snapshot is
+    // harmless as records are idempotent.
+    int dirFd = ::open(directory.c_str(), O_RDONLY);
+    if (dirFd != -1) {
+        flushToDisk(dirFd);
+        close(dirFd);
+    }
+    if (ftruncate(fd, 0) == -1) {
+        LOG_ERROR("Error truncating task log errno=%d, msg=%s", errno, strerror(errno));
+        return false;
+    }
+    LOG_INFO("Task log compacted, %zu tasks pending", pending.size());
+    records = 0;
+    return true;
+}
+
+TaskLog::~TaskLog() {
+    if (fd != -1) {
+        sync();
+        close(fd);
+    }
+}
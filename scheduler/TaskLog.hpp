@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Hashmap.hpp"
+#include "message.pb.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Write ahead log of task submissions and completions, so that a master
+// restarted on the same directory picks its backlog back up. Once the log
+// holds more records than there are tasks pending, the pending tasks are
+// written to a snapshot and the log starts over, which keeps recovery
+// proportional to the backlog rather than to the master's uptime.
+//
+// Records are framed like messages on the wire, a length followed by the
+// serialized LogRecord. A record torn by a crash ends the log.
+class TaskLog {
+public:
+    // Compacting is not worth it for fewer records than this
+    static constexpr size_t MIN_COMPACT_RECORDS = 64 * 1024;
+
+    explicit TaskLog(std::string directory);
+    TaskLog(const TaskLog&) = delete;
+    TaskLog& operator=(const TaskLog&) = delete;
+    ~TaskLog();
+
+    // Loads the snapshot and replays the log on top of it, handing every
+    // pending task to restore in the order it was submitted
+    bool open(const std::function<void(const Scheduler::LogRecord& record)>& restore);
+    void submit(uint64_t id, const Scheduler::Task& task, int clientId, uint64_t requestId);
+    void complete(uint64_t id);
+    // Writes out the records added since the last sync and flushes them to
+    // disk. Meant to be called once per event loop wakeup so that a single
+    // flush covers every record of the wakeup.
+    bool sync();
+
+    // Ids to continue from, past any that were handed out before
+    uint64_t nextTaskId() const {
+        return nextTask;
+    }
+
+    int nextClientId() const {
+        return nextClient;
+    }
+
+    size_t pendingTasks() const {
+        return pending.size();
+    }
+
+private:
+    bool load(const std::string& path, size_t& validSize);
+    void apply(const std::string& record);
+    void append(const std::string& record);
+    bool compact();
+    std::string logPath() const;
+    std::string snapshotPath() const;
+    std::string directory;
+    int fd = -1;
+    // Framed records waiting for the next sync
+    std::string buffer;
+    // Serialized submit records of the pending tasks, written out as they
+    // are when compacting
+    Hashmap<uint64_t, std::string> pending;
+    size_t records = 0;
+    uint64_t nextTask = 1;
+    int nextClient = 1;
+};
@@ -0,0 +1,97 @@
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(uint64_t now): current(now) {
+    std::fill(std::begin(heads), std::end(heads), -1);
+}
+
+void TimerWheel::schedule(int id, uint64_t expiry) {
+    while (timers.size() <= static_cast<size_t>(id)) {
+        timers.emplace_back();
+    }
+    if (timers[id].slot != -1) {
+        unlink(id);
+    }
+    timers[id].expiry = std::clamp(expiry, current + 1, current + MAX_DELAY);
+    link(id);
+}
+
+void TimerWheel::cancel(int id) {
+    if (scheduled(id)) {
+        unlink(id);
+    }
+}
+
+bool TimerWheel::scheduled(int id) {
+    return id >= 0 && static_cast<size_t>(id) < timers.size() && timers[id].slot != -1;
+}
+
+void TimerWheel::advance(uint64_t now, const std::function<void(int)>& fire) {
+    while (current < now) {
+        if (count == 0) {
+            current = now;
+            return;
+        }
+        current++;
+
+        // A slot on the next level up is due whenever this level wraps
+        for (int level = 1; level < LEVELS; level++) {
+            if ((current & ((uint64_t{1} << (LEVEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        int slot = current & (SLOTS - 1);
+        while (heads[slot] != -1) {
+            int id = heads[slot];
+            unlink(id);
+            fire(id);
+        }
+    }
+}
+
+void TimerWheel::link(int id) {
+    Timer& timer = timers[id];
+    uint64_t delta = timer.expiry - current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t{1} << (LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    int slot = level * SLOTS + ((timer.expiry >> (LEVEL_BITS * level)) & (SLOTS - 1));
+
+    timer.slot = slot;
+    timer.prev = -1;
+    timer.next = heads[slot];
+    if (timer.next != -1) {
+        timers[timer.next].prev = id;
+    }
+    heads[slot] = id;
+    count++;
+}
+
+void TimerWheel::unlink(int id) {
+    Timer& timer = timers[id];
+    if (timer.prev != -1) {
+        timers[timer.prev].next = timer.next;
+    } else {
+        heads[timer.slot] = timer.next;
+    }
+    if (timer.next != -1) {
+        timers[timer.next].prev = timer.prev;
+    }
+    timer.slot = -1;
+    count--;
+}
+
+void TimerWheel::cascade(int level) {
+    // Everything in the slot expires within the next SLOTS^level ticks, so
+    // it all moves to lower levels
+    int slot = level * SLOTS + ((current >> (LEVEL_BITS * level)) & (SLOTS - 1));
+    while (heads[slot] != -1) {
+        int id = heads[slot];
+        unlink(id);
+        link(id);
+    }
+}
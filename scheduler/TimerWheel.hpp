@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Vector.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Hierarchical timing wheel keyed by small non negative ids, such as a
+// WorkerId. Each level has SLOTS slots, a slot on level n covering
+// SLOTS^n ticks. Scheduling, rescheduling and cancelling a timer are O(1),
+// and advancing only touches timers that expire or move down a level.
+// Not thread safe.
+class TimerWheel {
+    struct Timer {
+        uint64_t expiry = 0;
+        int prev = -1;
+        int next = -1;
+        // Index into heads, -1 while not scheduled
+        int slot = -1;
+    };
+
+public:
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr int SLOTS = 1 << LEVEL_BITS;
+    static constexpr int LEVELS = 4;
+    // Timers further out than this are clamped to it
+    static constexpr uint64_t MAX_DELAY = (uint64_t{1} << (LEVEL_BITS * LEVELS)) - 1;
+
+    explicit TimerWheel(uint64_t now = 0);
+
+    // Arms the timer for id to fire at tick expiry, replacing any earlier
+    // deadline. Deadlines that have already passed fire on the next tick.
+    void schedule(int id, uint64_t expiry);
+    void cancel(int id);
+    bool scheduled(int id);
+
+    // Moves the wheel forward to tick now, calling fire for every timer
+    // that expires on the way. fire may schedule timers again.
+    void advance(uint64_t now, const std::function<void(int)>& fire);
+
+    uint64_t now() const {
+        return current;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+private:
+    void link(int id);
+    void unlink(int id);
+    void cascade(int level);
+
+    Vector<Timer> timers;
+    int heads[LEVELS * SLOTS];
+    uint64_t current;
+    size_t count = 0;
+};
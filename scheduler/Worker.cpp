@@ -4,9 +4,12 @@
 #include "message.pb.h"
 #include "Util.hpp"
 #include "Network.hpp"
+#include "Protocol.hpp"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -15,16 +18,28 @@
 #include <unistd.h>
 
 Worker::Worker(const char *hostname, const char *port,
-        std::chrono::seconds heartbeatInterval) : fd(0), hostname(hostname),
-        port(port), id(-1), heartbeatInterval(heartbeatInterval) {}
+        std::chrono::seconds heartbeatInterval, int capacity) : fd(0), hostname(hostname),
+        port(port), id(-1), heartbeatInterval(heartbeatInterval), capacity(capacity) {}
 
 Worker::Worker(Worker &&worker): fd(worker.fd), hostname(worker.hostname),
-    port(worker.port), heartbeatThread(std::move(worker.heartbeatThread)),
-    id(worker.id), heartbeatInterval(worker.heartbeatInterval)
+    port(worker.port), writerThread(std::move(worker.writerThread)),
+    id(worker.id), heartbeatInterval(worker.heartbeatInterval),
+    capacity(worker.capacity),
+    protocolVersion(worker.protocolVersion), handlers(std::move(worker.handlers))
 {
     LOG_TRACE("Worker move constructed");
 }
 
+void Worker::setHandler(Scheduler::TaskType type, TaskHandler handler)
+{
+    handlers[type] = std::move(handler);
+}
+
+void Worker::setReconnectTimeout(std::chrono::seconds timeout)
+{
+    reconnectTimeout = timeout;
+}
+
 bool Worker::connect()
 {
     int rfd = connectToHost(hostname, port);
@@ -51,83 +66,249 @@ void Worker::run()
         LOG_ERROR("Trying to run without id initialised");
         return;
     }
-    heartbeatThread = std::thread{&Worker::runHeartbeat, this};
+    do
+    {
+        serve();
+    } while (resume());
+}
+
+void Worker::serve()
+{
+    writerFailed = false;
+    writerThread = std::thread{&Worker::runWriter, this};
 
     while (true)
     {
-        char buffer[MAX_MESSAGE_SIZE];
-        ssize_t bytes = recv(fd, buffer, MAX_MESSAGE_SIZE, 0);
-        if (bytes == 0)
+        // Everything allocated while handling the previous message is
+        // released in one go
+        arena.reset();
+        std::string& buffer = arena.recvBuffer();
+        if (!nextFrame(buffer))
         {
-            LOG_INFO("Master disconnected");
+            LOG_INFO("Worker %d connection to master closed", id);
             break;
         }
-        if (bytes == -1)
+        Scheduler::Message& msg = *arena.create<Scheduler::Message>();
+        if (!msg.ParseFromString(buffer))
         {
-            LOG_ERROR("Worker %d error receiving data. errno=%d, strerrror=%s", id, errno, strerror(errno));
-            break;
+            LOG_ERROR("Worker %d error deserializing message", id);
+            continue;
         }
-        Scheduler::Message msg;
-        if (!msg.ParseFromString(std::string{buffer, static_cast<size_t>(bytes)}))
+        if (!upgradeMessage(msg))
         {
-            LOG_ERROR("Worker %d error deserializing message", id);
             continue;
         }
 
-        if (msg.type() != Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ)
+        bool success;
+        switch (msg.type())
+        {
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ):
+        {
+            success = handleTask(msg.task());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_REQ):
+        {
+            success = handleTaskBatch(msg.task_batch());
+            break;
+        }
+        case (Scheduler::MessageType::MESSAGE_TYPE_CHUNK_ACK):
+        {
+            handleChunkAck(msg.chunk_ack());
+            continue;
+        }
+        default:
         {
             LOG_ERROR("Worker %d invalid message type here type=%d", id, msg.type());
             continue;
         }
+        }
 
-        Scheduler::Task task;
-        if (!task.ParseFromString(msg.data()))
+        if (!success)
         {
-            LOG_ERROR("Worker %d error parsing data task from message type=%d", id, msg.type());
-            continue;
+            break;
         }
+    }
 
-        bool res = execute(task.type());
+    stopWriter();
+}
 
-        Scheduler::TaskResponse taskResponse;
-        taskResponse.set_success(res);
-        std::string r;
-        if (!taskResponse.SerializeToString(&r))
+bool Worker::handleTask(const Scheduler::Task& task)
+{
+    Scheduler::Message& response = *arena.create<Scheduler::Message>();
+    response.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+    if (!runTask(task, *response.mutable_task_response()))
+    {
+        return false;
+    }
+    return sendMessage(response);
+}
+
+bool Worker::handleTaskBatch(const Scheduler::TaskBatch& batch)
+{
+    // Every task in the batch is acknowledged in a single response
+    Scheduler::Message& response = *arena.create<Scheduler::Message>();
+    response.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES);
+    Scheduler::TaskResponseBatch* responses = response.mutable_task_response_batch();
+    for (const Scheduler::Task& task: batch.tasks())
+    {
+        if (!runTask(task, *responses->add_responses()))
         {
-            LOG_ERROR("Worker %d error serializing taskResponse success=%d", id, res);
+            return false;
+        }
+    }
+    return sendMessage(response);
+}
+
+bool Worker::runTask(const Scheduler::Task& task, Scheduler::TaskResponse& taskResponse)
+{
+    std::string result;
+    bool res = execute(task, result);
+
+    taskResponse.set_success(res);
+    if (task.has_id())
+    {
+        taskResponse.set_id(task.id());
+    }
+    if (result.size() <= RESULT_CHUNK_SIZE)
+    {
+        if (!result.empty())
+        {
+            taskResponse.set_result(std::move(result));
+        }
+        return true;
+    }
+
+    // Large results go out ahead of the response in chunks
+    taskResponse.set_result_size(result.size());
+    return streamResult(task.id(), result);
+}
+
+bool Worker::streamResult(uint64_t taskId, const std::string& result)
+{
+    // Reused for every chunk so that the data buffer is only allocated once
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_RESULT_CHUNK);
+    Scheduler::ResultChunk* chunk = msg.mutable_result_chunk();
+    chunk->set_id(taskId);
+    for (size_t offset = 0; offset < result.size(); offset += RESULT_CHUNK_SIZE)
+    {
+        size_t size = std::min(RESULT_CHUNK_SIZE, result.size() - offset);
+        if (!waitForCredit(size))
+        {
+            return false;
+        }
+        chunk->set_offset(offset);
+        chunk->mutable_data()->assign(result, offset, size);
+        if (!sendMessage(msg))
+        {
+            return false;
+        }
+        unackedBytes += size;
+    }
+    LOG_TRACE("Worker %d streamed result of size=%zu for task=%llu", id, result.size(), taskId);
+    return true;
+}
+
+bool Worker::waitForCredit(size_t size)
+{
+    while (unackedBytes + size > RESULT_WINDOW_SIZE)
+    {
+        std::string frame;
+        if (!Receive(fd, frame))
+        {
+            LOG_ERROR("Worker %d connection closed while streaming a result", id);
+            return false;
+        }
+        Scheduler::Message msg;
+        if (!msg.ParseFromString(frame) || !upgradeMessage(msg))
+        {
+            LOG_ERROR("Worker %d error deserializing message", id);
             continue;
         }
-        Scheduler::Message response;
-        response.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
-        response.set_data(r);
-        if (!response.SerializeToString(&r))
+        if (msg.type() == Scheduler::MessageType::MESSAGE_TYPE_CHUNK_ACK)
         {
-            LOG_ERROR("Worker %d error serializing response success=%d", id, res);
+            handleChunkAck(msg.chunk_ack());
             continue;
         }
+        // Anything else is handled by the run loop once the result is out
+        pendingFrames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+bool Worker::nextFrame(std::string& buffer)
+{
+    if (pendingFrames.empty())
+    {
+        return Receive(fd, buffer);
+    }
+    buffer = std::move(pendingFrames.front());
+    pendingFrames.pop_front();
+    return true;
+}
+
+void Worker::handleChunkAck(const Scheduler::ChunkAck& ack)
+{
+    unackedBytes -= std::min<size_t>(ack.size(), unackedBytes);
+}
 
-        if (send(fd, r.data(), r.size(), 0) == -1)
+bool Worker::sendMessage(Scheduler::Message& msg)
+{
+    std::string buffer;
+    {
+        std::scoped_lock<std::mutex> lock{outboxMutex};
+        if (writerFailed)
         {
-            LOG_ERROR("Worker %d error sending response to master errno=%d, %s", id, errno, strerror(errno));
-            break;
+            return false;
+        }
+        if (!freeBuffers.empty())
+        {
+            buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
         }
     }
 
-    stopHeartbeat();
+    if (!serializeMessage(msg, protocolVersion, buffer))
+    {
+        LOG_ERROR("Worker %d error serializing message type=%d", id, msg.type());
+        return false;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock{outboxMutex};
+        if (writerFailed)
+        {
+            return false;
+        }
+        outbox.push_back(std::move(buffer));
+    }
+    outboxCv.notify_one();
+    return true;
 }
 
-void Worker::stopHeartbeat() {
-    LOG_INFO("Worker %d stopping heartbeat thread", id);
-    shutdownHeartbeat = true;
-    if (heartbeatThread.joinable()) {
-        heartbeatThread.join();
+void Worker::stopWriter() {
+    LOG_INFO("Worker %d stopping writer thread", id);
+    {
+        std::scoped_lock<std::mutex> lock{outboxMutex};
+        shutdownWriter = true;
+    }
+    outboxCv.notify_one();
+    if (writerThread.joinable()) {
+        writerThread.join();
     }
-    shutdownHeartbeat = false;
+    shutdownWriter = false;
 }
 
-bool Worker::execute(Scheduler::TaskType taskType)
+bool Worker::execute(const Scheduler::Task& task, std::string& result)
 {
-    switch (taskType)
+    auto handler = handlers.find(task.type());
+    if (handler != handlers.end())
+    {
+        return handler->second(task, result);
+    }
+
+    switch (task.type())
     {
     case (Scheduler::TaskType::TASK_ONE):
     {
@@ -169,36 +350,33 @@ bool Worker::handshake()
 {
     Scheduler::Message msg{};
     msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_REQ);
-    std::string res;
-    if (!msg.SerializeToString(&res))
-    {
-        LOG_ERROR("Error serializing handshake message");
-        return false;
-    }
+    // Capacity is known up front rather than from the first heartbeat,
+    // the id is assigned by the master. A resumed session sends its
+    // previous id and the tasks whose results did not make it out.
+    msg.mutable_heartbeat()->set_id(id);
+    msg.mutable_heartbeat()->set_capacity(capacity);
+    msg.mutable_heartbeat()->set_heartbeat_interval_ms(
+            std::chrono::duration_cast<std::chrono::milliseconds>(heartbeatInterval).count());
+    std::vector<Scheduler::Message> results;
+    reclaimResults(*msg.mutable_heartbeat(), results);
 
-    LOG_TRACE("Sending handshake now(%zu): %s", res.size(), res.c_str());
-    if (send(fd, res.data(), res.size(), 0) == -1)
+    LOG_TRACE("Sending handshake now");
+    if (!::sendMessage(fd, msg))
     {
-        LOG_ERROR("Error sending handshake %d: %s", errno, strerror(errno));
+        LOG_ERROR("Error sending handshake");
         return false;
     }
 
-    char buffer[MAX_MESSAGE_SIZE];
     LOG_TRACE("Receiving handshake response from master now");
-    ssize_t bytes = recv(fd, buffer, MAX_MESSAGE_SIZE, 0);
-    if (bytes == 0)
-    {
-        LOG_INFO("Master disconnected!");
-        return false;
-    }
-    if (bytes < 0)
+    std::string res;
+    if (!Receive(fd, res))
     {
-        LOG_ERROR("Error receiving handshake. bytes=%zu. %d: %s", bytes, errno, strerror(errno));
+        LOG_ERROR("Error receiving handshake response from master");
         return false;
     }
 
     Scheduler::Message response;
-    if (!response.ParseFromString(std::string{buffer, static_cast<size_t>(bytes)}))
+    if (!response.ParseFromString(res))
     {
         LOG_ERROR("Error parsing response from master");
         return false;
@@ -210,30 +388,151 @@ bool Worker::handshake()
         return false;
     }
 
-    Scheduler::HeartbeatData data;
-    if (!data.ParseFromString(response.data()))
+    if (!upgradeMessage(response) || !response.has_heartbeat())
     {
         LOG_ERROR("Error parsing heartbeat resopnse data from master");
         return false;
     }
 
-    id = data.id();
-    LOG_INFO("Handshake success, assigned id=%d", id);
+    // A master that does not stamp a version only speaks version 1
+    protocolVersion = messageVersion(response);
+    id = response.heartbeat().id();
+    LOG_INFO("Handshake success, assigned id=%d, protocol version=%u", id, protocolVersion);
+
+    // The writer is not running yet
+    for (Scheduler::Message& result: results)
+    {
+        std::string buffer;
+        if (serializeMessage(result, protocolVersion, buffer))
+        {
+            outbox.push_back(std::move(buffer));
+        }
+    }
     return true;
 }
 
-void Worker::runHeartbeat()
+void Worker::reclaimResults(Scheduler::HeartbeatData& data, std::vector<Scheduler::Message>& results)
 {
-    LOG_INFO("Initialising heartbeat thread worker=%d", id);
-    while (!shutdownHeartbeat)
+    // Only whole results are kept. A streamed one can't be picked up
+    // halfway, so its task is left to be dispatched again.
+    for (const std::string& frame: outbox)
     {
-        std::this_thread::sleep_for(heartbeatInterval);
-        if (shutdownHeartbeat || !sendHeartbeat())
+        Scheduler::Message msg;
+        if (!msg.ParseFromString(frame) || !upgradeMessage(msg))
+        {
+            continue;
+        }
+        if (msg.type() == Scheduler::MessageType::MESSAGE_TYPE_TASK_RES)
+        {
+            if (msg.task_response().has_result_size())
+            {
+                continue;
+            }
+            data.add_tasks(msg.task_response().id());
+            results.push_back(std::move(msg));
+        }
+        else if (msg.type() == Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES)
+        {
+            Scheduler::Message kept;
+            kept.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES);
+            Scheduler::TaskResponseBatch* batch = kept.mutable_task_response_batch();
+            for (const Scheduler::TaskResponse& response: msg.task_response_batch().responses())
+            {
+                if (!response.has_result_size())
+                {
+                    data.add_tasks(response.id());
+                    *batch->add_responses() = response;
+                }
+            }
+            if (batch->responses_size() > 0)
+            {
+                results.push_back(std::move(kept));
+            }
+        }
+    }
+    outbox.clear();
+}
+
+bool Worker::resume()
+{
+    if (reconnectTimeout.count() == 0)
+    {
+        return false;
+    }
+    close(fd);
+    fd = 0;
+    pendingFrames.clear();
+    unackedBytes = 0;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point deadline = Clock::now() + reconnectTimeout;
+    std::chrono::milliseconds backoff{100};
+    while (Clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min<std::chrono::milliseconds>(backoff * 2, MAX_RECONNECT_BACKOFF);
+        LOG_INFO("Worker %d trying to resume its session", id);
+        if (connect())
+        {
+            return true;
+        }
+    }
+    LOG_ERROR("Worker %d gave up on resuming its session", id);
+    return false;
+}
+
+void Worker::runWriter()
+{
+    LOG_INFO("Initialising writer thread worker=%d", id);
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point lastHeartbeat = Clock::now();
+    std::unique_lock<std::mutex> lock{outboxMutex};
+    while (true)
+    {
+        bool ready = outboxCv.wait_for(lock, heartbeatInterval, [this]{
+            return !outbox.empty() || shutdownWriter;
+        });
+        if (outbox.empty() && shutdownWriter)
         {
             break;
         }
+
+        Clock::time_point now = Clock::now();
+        if (!ready || now - lastHeartbeat >= heartbeatInterval * LOAD_REPORT_INTERVALS)
+        {
+            lock.unlock();
+            bool success = sendHeartbeat();
+            lock.lock();
+            lastHeartbeat = now;
+            if (!success)
+            {
+                break;
+            }
+            if (!ready)
+            {
+                continue;
+            }
+        }
+
+        std::string frame = std::move(outbox.front());
+        outbox.pop_front();
+        lock.unlock();
+        bool success = Send(fd, frame);
+        lock.lock();
+        if (!success)
+        {
+            // Kept for a resumed session
+            LOG_ERROR("Worker %d error sending message to master", id);
+            outbox.push_front(std::move(frame));
+            break;
+        }
+        if (freeBuffers.size() < MAX_FREE_BUFFERS)
+        {
+            freeBuffers.push_back(std::move(frame));
+        }
     }
-    LOG_TRACE("Run heartbeat thread ended, worker=%d", id);
+    writerFailed = true;
+    LOG_TRACE("Writer thread ended, worker=%d", id);
 }
 
 bool Worker::sendHeartbeat()
@@ -244,18 +543,22 @@ bool Worker::sendHeartbeat()
     }
 
     LOG_INFO("Worker %d sending heartbeat", id);
-    Scheduler::Message msg;
+    heartbeatArena.reset();
+    Scheduler::Message& msg = *heartbeatArena.create<Scheduler::Message>();
     msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_HEARTBEAT);
-    std::string res;
-    if (!msg.SerializeToString(&res))
+    Scheduler::HeartbeatData* data = msg.mutable_heartbeat();
+    data->set_id(id);
+    data->set_capacity(capacity);
+    double load;
+    if (getloadavg(&load, 1) == 1)
     {
-        LOG_ERROR("Error serializing heartbeat message worker=%d", id);
-        return false;
+        data->set_load(static_cast<float>(load));
     }
+
     LOG_TRACE("Worker %d sending heartbeat now", id);
-    if (send(fd, res.data(), res.size(), 0) == -1)
+    if (!::sendMessage(fd, msg, protocolVersion, heartbeatArena.sendBuffer()))
     {
-        LOG_ERROR("Error sending heartbeat worker=%d errno=%d: %s", id, errno, strerror(errno));
+        LOG_ERROR("Worker %d error sending heartbeat", id);
         return false;
     }
     return true;
@@ -263,7 +566,7 @@ bool Worker::sendHeartbeat()
 
 Worker::~Worker()
 {
-    stopHeartbeat();
+    stopWriter();
     close(fd);
     LOG_TRACE("Worker %d destructor completed", id);
 }
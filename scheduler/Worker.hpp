@@ -1,35 +1,96 @@
 #pragma once
 
 #include "message.pb.h"
+#include "MessageArena.hpp"
+#include "Protocol.hpp"
+
+#include "Hashmap.hpp"
 
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 using WorkerId = int;
 
+// Runs a task and fills in its result, returns whether it succeeded
+using TaskHandler = std::function<bool(const Scheduler::Task& task, std::string& result)>;
+
 class Worker {
 public:
+    // Every frame counts as a heartbeat, so explicit ones are only sent
+    // when nothing else has been for an interval, and at least every
+    // LOAD_REPORT_INTERVALS intervals so that load stays current
+    static constexpr int LOAD_REPORT_INTERVALS = 10;
+    static constexpr size_t MAX_FREE_BUFFERS = 16;
+    static constexpr std::chrono::seconds MAX_RECONNECT_BACKOFF{5};
+
+    // capacity is the number of tasks the master may have outstanding on
+    // this worker, tasks beyond the first are queued and run in order
     Worker(const char* hostname, const char* port,
-            std::chrono::seconds heartbeatInterval = std::chrono::seconds{1});
+            std::chrono::seconds heartbeatInterval = std::chrono::seconds{1},
+            int capacity = 1);
     Worker(Worker&& worker);
+    // Overrides the built in implementation of a task type
+    void setHandler(Scheduler::TaskType type, TaskHandler handler);
+    // How long to keep trying to resume the session after losing the
+    // master, e.g. to a restart. 0, the default, makes run return instead.
+    void setReconnectTimeout(std::chrono::seconds timeout);
     bool connect();
     void run();
-    void runHeartbeat();
+    void runWriter();
     ~Worker();
     
 private:
     bool sendHeartbeat();
     bool handshake();
-    bool execute(Scheduler::TaskType task);
+    void serve();
+    bool resume();
+    void reclaimResults(Scheduler::HeartbeatData& data, std::vector<Scheduler::Message>& results);
+    bool handleTask(const Scheduler::Task& task);
+    bool handleTaskBatch(const Scheduler::TaskBatch& batch);
+    bool runTask(const Scheduler::Task& task, Scheduler::TaskResponse& taskResponse);
+    bool streamResult(uint64_t taskId, const std::string& result);
+    bool waitForCredit(size_t size);
+    bool nextFrame(std::string& buffer);
+    void handleChunkAck(const Scheduler::ChunkAck& ack);
+    bool sendMessage(Scheduler::Message& msg);
+    bool execute(const Scheduler::Task& task, std::string& result);
     bool executeTaskOne();
     bool executeTaskTwo();
-    void stopHeartbeat();
+    void stopWriter();
     int fd = 0;
     const char* hostname = nullptr; 
     const char* port = nullptr;
-    std::thread heartbeatThread;
+    // The only thread that writes to fd once the handshake is done
+    std::thread writerThread;
     WorkerId id = -1;
-    bool shutdownHeartbeat = false;
     std::chrono::seconds heartbeatInterval = std::chrono::seconds{1};
+    int capacity = 1;
+    std::chrono::seconds reconnectTimeout{0};
+    // Negotiated with the master during the handshake
+    uint32_t protocolVersion = LEGACY_PROTOCOL_VERSION;
+    // Owned by the run loop and the writer respectively
+    MessageArena arena;
+    MessageArena heartbeatArena{4 * 1024};
+    // Serialized frames waiting for the writer, and sent frames kept
+    // around so that their capacity is reused
+    std::mutex outboxMutex;
+    std::condition_variable outboxCv;
+    std::deque<std::string> outbox;
+    std::deque<std::string> freeBuffers;
+    bool shutdownWriter = false;
+    bool writerFailed = false;
+    Hashmap<int, TaskHandler> handlers;
+    // Streamed result bytes the master has not acknowledged yet
+    size_t unackedBytes = 0;
+    // Frames received while waiting for acknowledgements, handled before
+    // reading from the socket again
+    std::deque<std::string> pendingFrames;
 };
 
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "MessageArena.hpp"
+#include "message.pb.h"
+
+#include <string>
+
+static std::string makeBatch(int n) {
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_REQ);
+    for (int i = 0; i < n; i++) {
+        Scheduler::Task* task = msg.mutable_task_batch()->add_tasks();
+        task->set_type(Scheduler::TaskType::TASK_ONE);
+        task->set_key("k");
+        task->set_id(i);
+    }
+    return msg.SerializeAsString();
+}
+
+// Parses a batch and serializes an acknowledgement for it, which is
+// what a worker does for every message it receives
+static void roundTrip(MessageArena& arena, const std::string& wire) {
+    std::string& recv = arena.recvBuffer();
+    recv = wire;
+    Scheduler::Message* msg = arena.create<Scheduler::Message>();
+    ASSERT_TRUE(msg->ParseFromString(recv));
+
+    Scheduler::Message* response = arena.create<Scheduler::Message>();
+    response->set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES);
+    for (const Scheduler::Task& task: msg->task_batch().tasks()) {
+        Scheduler::TaskResponse* r = response->mutable_task_response_batch()->add_responses();
+        r->set_success(true);
+        r->set_id(task.id());
+    }
+    ASSERT_TRUE(response->SerializeToString(&arena.sendBuffer()));
+}
+
+TEST(MessageArenaTest, SteadyStateNeedsNoNewBlocks) {
+    MessageArena arena;
+    std::string wire = makeBatch(64);
+
+    // Warm up so that the buffers reach their working size
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 10; j++) {
+            roundTrip(arena, wire);
+        }
+        arena.reset();
+    }
+
+    AllocationStats before = MessageArena::stats();
+    for (int i = 0; i < 100; i++) {
+        for (int j = 0; j < 10; j++) {
+            roundTrip(arena, wire);
+        }
+        arena.reset();
+    }
+    AllocationStats after = MessageArena::stats();
+
+    EXPECT_EQ(after.blockAllocations, before.blockAllocations);
+    EXPECT_EQ(after.bufferGrowths, before.bufferGrowths);
+    EXPECT_EQ(after.resets, before.resets + 100);
+}
+
+TEST(MessageArenaTest, OverflowIsCounted) {
+    MessageArena arena{1024};
+    std::string wire = makeBatch(256);
+
+    AllocationStats before = MessageArena::stats();
+    roundTrip(arena, wire);
+    arena.reset();
+    AllocationStats after = MessageArena::stats();
+
+    EXPECT_GT(after.blockAllocations, before.blockAllocations);
+    EXPECT_GT(after.blockBytes, before.blockBytes);
+}
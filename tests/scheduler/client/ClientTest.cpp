@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include "Client.hpp"
+#include "Network.hpp"
+#include "Protocol.hpp"
+
+#include <arpa/inet.h>
+#include <future>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Accepts a single client on a loopback port and answers its handshake
+class FakeMaster {
+public:
+    FakeMaster() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        ::listen(listenFd, 1);
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        port = std::to_string(ntohs(addr.sin_port));
+    }
+
+    // Drops any previous connection. nextRequestId, if not 0, is the id
+    // the handshake tells the client to continue from.
+    bool accept(uint64_t nextRequestId = 0) {
+        if (fd != -1) {
+            close(fd);
+        }
+        fd = ::accept(listenFd, nullptr, nullptr);
+        Scheduler::Message msg;
+        if (!receive(msg) || msg.type() != Scheduler::MessageType::MESSAGE_TYPE_CLIENT_HANDSHAKE_REQ) {
+            return false;
+        }
+        Scheduler::Message response;
+        response.set_type(Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_RES);
+        response.mutable_heartbeat()->set_id(1);
+        if (nextRequestId != 0) {
+            response.mutable_heartbeat()->set_next_request_id(nextRequestId);
+        }
+        return sendMessage(fd, response);
+    }
+
+    bool receive(Scheduler::Message& msg) {
+        std::string frame;
+        return Receive(fd, frame) && msg.ParseFromString(frame);
+    }
+
+    ~FakeMaster() {
+        close(fd);
+        close(listenFd);
+    }
+
+    int listenFd = -1;
+    int fd = -1;
+    std::string port;
+};
+
+TEST(ClientTest, PipelinedSubmissionsCompleteOutOfOrder) {
+    FakeMaster master;
+    constexpr int N = 1000;
+    std::thread thread{[&]{
+        ASSERT_TRUE(master.accept());
+        std::vector<Scheduler::Task> tasks;
+        while (tasks.size() < N) {
+            Scheduler::Message msg;
+            ASSERT_TRUE(master.receive(msg));
+            for (const Scheduler::Task& task: msg.task_batch().tasks()) {
+                tasks.push_back(task);
+            }
+        }
+        // Answer in reverse, echoing the payload back as the result
+        for (auto it = tasks.rbegin(); it != tasks.rend(); it++) {
+            Scheduler::Message msg;
+            msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+            msg.mutable_task_response()->set_id(it->id());
+            msg.mutable_task_response()->set_success(true);
+            msg.mutable_task_response()->set_result(it->payload());
+            ASSERT_TRUE(sendMessage(master.fd, msg));
+        }
+    }};
+
+    Client client{"127.0.0.1", master.port.c_str()};
+    ASSERT_TRUE(client.connect());
+    std::vector<std::future<TaskResult>> futures;
+    for (int i = 0; i < N; i++) {
+        Scheduler::Task task;
+        task.set_type(Scheduler::TaskType::TASK_ONE);
+        task.set_payload(std::to_string(i));
+        futures.push_back(client.submit(std::move(task)));
+    }
+    for (int i = 0; i < N; i++) {
+        TaskResult result = futures[i].get();
+        EXPECT_TRUE(result.success);
+        EXPECT_EQ(result.result, std::to_string(i));
+    }
+    thread.join();
+}
+
+TEST(ClientTest, ReassemblesStreamedResult) {
+    FakeMaster master;
+    std::string expected(3 * RESULT_CHUNK_SIZE + 5, 'x');
+    std::thread thread{[&]{
+        ASSERT_TRUE(master.accept());
+        Scheduler::Message msg;
+        ASSERT_TRUE(master.receive(msg));
+        uint64_t id = msg.task_batch().tasks(0).id();
+        for (size_t offset = 0; offset < expected.size(); offset += RESULT_CHUNK_SIZE) {
+            Scheduler::Message chunk;
+            chunk.set_type(Scheduler::MessageType::MESSAGE_TYPE_RESULT_CHUNK);
+            chunk.mutable_result_chunk()->set_id(id);
+            chunk.mutable_result_chunk()->set_offset(offset);
+            chunk.mutable_result_chunk()->set_data(expected.substr(offset, RESULT_CHUNK_SIZE));
+            ASSERT_TRUE(sendMessage(master.fd, chunk));
+        }
+        Scheduler::Message response;
+        response.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+        response.mutable_task_response()->set_id(id);
+        response.mutable_task_response()->set_success(true);
+        response.mutable_task_response()->set_result_size(expected.size());
+        ASSERT_TRUE(sendMessage(master.fd, response));
+    }};
+
+    Client client{"127.0.0.1", master.port.c_str()};
+    ASSERT_TRUE(client.connect());
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    TaskResult result = client.submit(std::move(task)).get();
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(result.result, expected);
+    thread.join();
+}
+
+TEST(ClientTest, OutstandingFailOnDisconnect) {
+    FakeMaster master;
+    std::thread thread{[&]{
+        ASSERT_TRUE(master.accept());
+        Scheduler::Message msg;
+        ASSERT_TRUE(master.receive(msg));
+        shutdown(master.fd, SHUT_RDWR);
+    }};
+
+    Client client{"127.0.0.1", master.port.c_str()};
+    ASSERT_TRUE(client.connect());
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    TaskResult result = client.submit(std::move(task)).get();
+    EXPECT_FALSE(result.success);
+    thread.join();
+}
+
+TEST(ClientTest, ReconnectsAndContinuesFromTheIdTheMasterGives) {
+    FakeMaster master;
+    auto respond = [&](uint64_t id, const std::string& result) {
+        Scheduler::Message response;
+        response.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+        response.mutable_task_response()->set_id(id);
+        response.mutable_task_response()->set_success(true);
+        response.mutable_task_response()->set_result(result);
+        return sendMessage(master.fd, response);
+    };
+    std::thread thread{[&]{
+        ASSERT_TRUE(master.accept());
+        Scheduler::Message msg;
+        ASSERT_TRUE(master.receive(msg));
+        EXPECT_EQ(msg.task_batch().tasks(0).id(), 1);
+        shutdown(master.fd, SHUT_RDWR);
+
+        // Requests up to 4 are still pending in the resumed session
+        ASSERT_TRUE(master.accept(5));
+        ASSERT_TRUE(respond(1, "late"));
+        ASSERT_TRUE(master.receive(msg));
+        EXPECT_EQ(msg.task_batch().tasks(0).id(), 5);
+        ASSERT_TRUE(respond(5, "new"));
+    }};
+
+    Client client{"127.0.0.1", master.port.c_str()};
+    std::promise<std::pair<uint64_t, TaskResult>> resumed;
+    client.setResumedHandler([&](uint64_t requestId, TaskResult result) {
+        resumed.set_value({requestId, std::move(result)});
+    });
+    ASSERT_TRUE(client.connect());
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    EXPECT_FALSE(client.submit(task).get().success);
+
+    ASSERT_TRUE(client.connect(client.session()));
+    auto [requestId, late] = resumed.get_future().get();
+    EXPECT_EQ(requestId, 1);
+    EXPECT_EQ(late.result, "late");
+    std::future<TaskResult> result;
+    EXPECT_EQ(client.submit(task, result), 5);
+    EXPECT_EQ(result.get().result, "new");
+    thread.join();
+}
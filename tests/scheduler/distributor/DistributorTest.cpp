@@ -0,0 +1,305 @@
+#include <gtest/gtest.h>
+
+#include "Distributor.hpp"
+#include "Network.hpp"
+#include "Protocol.hpp"
+
+#include <chrono>
+#include <deque>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+// A worker is one end of a socket pair, the distributor writes tasks to
+// the other end
+struct FakeWorker {
+    FakeWorker() {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    }
+
+    ~FakeWorker() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    WorkerId id() const {
+        return fds[0];
+    }
+
+    int fds[2];
+};
+
+// Waits for a task on either worker and returns the one it went to
+static FakeWorker* receiveTask(FakeWorker& a, FakeWorker& b, Scheduler::Task& task,
+        std::chrono::milliseconds timeout = 2s) {
+    pollfd pfds[2] = {{a.fds[1], POLLIN, 0}, {b.fds[1], POLLIN, 0}};
+    if (poll(pfds, 2, timeout.count()) <= 0) {
+        return nullptr;
+    }
+    FakeWorker* worker = (pfds[0].revents & POLLIN) ? &a : &b;
+    std::string frame;
+    Scheduler::Message msg;
+    if (!Receive(worker->fds[1], frame) || !msg.ParseFromString(frame)) {
+        return nullptr;
+    }
+    task = msg.has_task() ? msg.task() : msg.task_batch().tasks(0);
+    return worker;
+}
+
+static Scheduler::Task makeTask() {
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    task.set_payload("payload");
+    return task;
+}
+
+TEST(DistributorTest, RequeuesTasksOfLostWorker) {
+    Distributor distributor;
+    FakeWorker a, b;
+    distributor.addWorker(a.fds[0], a.id());
+    distributor.start();
+    uint64_t id = distributor.addTask(makeTask());
+
+    Scheduler::Task task;
+    ASSERT_EQ(receiveTask(a, b, task), &a);
+    EXPECT_EQ(task.id(), id);
+    EXPECT_EQ(task.attempt(), 0);
+
+    distributor.addWorker(b.fds[0], b.id());
+    distributor.removeWorker(a.id());
+    ASSERT_EQ(receiveTask(a, b, task), &b);
+    EXPECT_EQ(task.id(), id);
+    EXPECT_GT(task.attempt(), 0);
+    EXPECT_EQ(task.payload(), "payload");
+    EXPECT_TRUE(distributor.completeTask(b.id(), id));
+    distributor.stop();
+}
+
+TEST(DistributorTest, TimedOutTaskRunsOnAnotherWorkerAndFirstResultWins) {
+    Distributor distributor{UniquePtr<IPlacementPolicy>{new LeastLoadedPolicy}, 200ms};
+    FakeWorker a, b;
+    distributor.addWorker(a.fds[0], a.id());
+    distributor.addWorker(b.fds[0], b.id());
+    distributor.start();
+    uint64_t id = distributor.addTask(makeTask());
+
+    Scheduler::Task task;
+    FakeWorker* first = receiveTask(a, b, task);
+    ASSERT_NE(first, nullptr);
+    FakeWorker* second = receiveTask(a, b, task);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(task.id(), id);
+    EXPECT_GT(task.attempt(), 0);
+
+    // The copy that starts streaming first owns the result
+    EXPECT_TRUE(distributor.claimResult(second->id(), id));
+    EXPECT_FALSE(distributor.claimResult(first->id(), id));
+    EXPECT_FALSE(distributor.completeTask(first->id(), id));
+    EXPECT_TRUE(distributor.completeTask(second->id(), id));
+    EXPECT_FALSE(distributor.completeTask(second->id(), id));
+    distributor.stop();
+}
+
+TEST(DistributorTest, AbandonsTaskAfterRepeatedTimeouts) {
+    Distributor distributor{UniquePtr<IPlacementPolicy>{new LeastLoadedPolicy}, 100ms};
+    FakeWorker a, b;
+    distributor.addWorker(a.fds[0], a.id(), PROTOCOL_VERSION, Distributor::MAX_FAILURES);
+    distributor.start();
+    uint64_t id = distributor.addTask(makeTask());
+
+    Scheduler::Task task;
+    for (uint32_t i = 0; i < Distributor::MAX_FAILURES; i++) {
+        ASSERT_EQ(receiveTask(a, b, task), &a);
+        EXPECT_EQ(task.id(), id);
+    }
+
+    std::deque<uint64_t> abandoned;
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (distributor.drainAbandoned(abandoned) == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    ASSERT_EQ(abandoned.size(), 1);
+    EXPECT_EQ(abandoned.front(), id);
+    EXPECT_FALSE(distributor.completeTask(a.id(), id));
+    distributor.stop();
+}
+
+TEST(DistributorTest, CompletedTasksDisarmTheirTimeout) {
+    Distributor distributor;
+    FakeWorker a, b;
+    distributor.addWorker(a.fds[0], a.id());
+    distributor.start();
+
+    Scheduler::Task task;
+    for (int i = 0; i < 100; i++) {
+        uint64_t id = distributor.addTask(makeTask());
+        ASSERT_EQ(receiveTask(a, b, task), &a);
+        EXPECT_EQ(distributor.pendingTimeouts(), 1);
+        EXPECT_TRUE(distributor.completeTask(a.id(), id));
+    }
+    // Long before the five minute timeout of any of them
+    EXPECT_EQ(distributor.pendingTimeouts(), 0);
+    distributor.stop();
+}
+
+TEST(DistributorTest, FramesFromOtherThreadsNeverInterleaveWithBatches) {
+    constexpr int TASKS = 200;
+    constexpr int ACKS = 1000;
+    Distributor distributor;
+    FakeWorker a;
+    distributor.addWorker(a.fds[0], a.id(), PROTOCOL_VERSION, TASKS);
+    distributor.start();
+
+    // Large enough for every batch to take several writes
+    Scheduler::Task task = makeTask();
+    task.set_payload(std::string(64 * 1024, 'x'));
+    for (int i = 0; i < TASKS; i++) {
+        distributor.addTask(task);
+    }
+    std::thread acker{[&]() {
+        Scheduler::Message ack;
+        ack.set_type(Scheduler::MessageType::MESSAGE_TYPE_CHUNK_ACK);
+        ack.mutable_chunk_ack()->set_id(1);
+        ack.mutable_chunk_ack()->set_size(1);
+        std::string buffer;
+        for (int i = 0; i < ACKS; i++) {
+            ASSERT_TRUE(distributor.sendToWorker(a.id(), ack, buffer));
+        }
+    }};
+
+    int tasks = 0;
+    int acks = 0;
+    std::string frame;
+    Scheduler::Message msg;
+    while (tasks < TASKS || acks < ACKS) {
+        pollfd pfd{a.fds[1], POLLIN, 0};
+        ASSERT_GT(poll(&pfd, 1, 2000), 0);
+        ASSERT_TRUE(Receive(a.fds[1], frame));
+        ASSERT_TRUE(msg.ParseFromString(frame));
+        if (msg.type() == Scheduler::MessageType::MESSAGE_TYPE_CHUNK_ACK) {
+            acks++;
+        } else if (msg.has_task()) {
+            EXPECT_EQ(msg.task().payload().size(), task.payload().size());
+            tasks++;
+        } else {
+            for (const Scheduler::Task& received: msg.task_batch().tasks()) {
+                EXPECT_EQ(received.payload().size(), task.payload().size());
+                tasks++;
+            }
+        }
+    }
+    acker.join();
+    distributor.stop();
+}
+
+TEST(DistributorTest, SpeculatesOnStragglers) {
+    Distributor distributor{UniquePtr<IPlacementPolicy>{new LeastLoadedPolicy}, 1min, 2};
+    FakeWorker a, b;
+    distributor.addWorker(a.fds[0], a.id());
+    distributor.addWorker(b.fds[0], b.id());
+    distributor.start();
+
+    // A quick task gives the distributor a mean duration to go by
+    Scheduler::Task task;
+    uint64_t quick = distributor.addTask(makeTask());
+    FakeWorker* worker = receiveTask(a, b, task);
+    ASSERT_NE(worker, nullptr);
+    EXPECT_TRUE(distributor.completeTask(worker->id(), quick));
+
+    uint64_t slow = distributor.addTask(makeTask());
+    FakeWorker* first = receiveTask(a, b, task);
+    ASSERT_NE(first, nullptr);
+    EXPECT_FALSE(task.speculative());
+    FakeWorker* second = receiveTask(a, b, task);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(task.id(), slow);
+    EXPECT_TRUE(task.speculative());
+
+    // No further copies once the task has been speculated on
+    EXPECT_EQ(receiveTask(a, b, task, 300ms), nullptr);
+    EXPECT_TRUE(distributor.completeTask(second->id(), slow));
+    EXPECT_FALSE(distributor.completeTask(first->id(), slow));
+    distributor.stop();
+}
+
+// A straggler that can't be copied for lack of a free slot doesn't hold on
+// to the deadlines of the tasks that complete around it
+TEST(DistributorTest, StragglersStayBoundedWhileWorkersAreSaturated) {
+    Distributor distributor{UniquePtr<IPlacementPolicy>{new LeastLoadedPolicy}, 1min, 2};
+    FakeWorker a, b;
+    distributor.addWorker(a.fds[0], a.id(), PROTOCOL_VERSION, 2);
+    distributor.start();
+
+    // Runs for the whole test, in one slot of the only worker
+    Scheduler::Task task;
+    uint64_t slow = distributor.addTask(makeTask());
+    ASSERT_EQ(receiveTask(a, b, task), &a);
+    uint64_t quick = distributor.addTask(makeTask());
+    ASSERT_EQ(receiveTask(a, b, task), &a);
+    for (int i = 0; i < 300; i++) {
+        // Waits for the other slot
+        uint64_t next = distributor.addTask(makeTask());
+        EXPECT_TRUE(distributor.completeTask(a.id(), quick));
+        ASSERT_EQ(receiveTask(a, b, task), &a);
+        EXPECT_EQ(task.id(), next);
+        quick = next;
+        EXPECT_LE(distributor.pendingStragglers(), 2);
+        std::this_thread::sleep_for(1ms);
+    }
+
+    EXPECT_TRUE(distributor.completeTask(a.id(), quick));
+    EXPECT_TRUE(distributor.completeTask(a.id(), slow));
+    EXPECT_EQ(distributor.pendingStragglers(), 0);
+    distributor.stop();
+}
+
+TEST(DistributorTest, ResumedWorkerKeepsTheTasksItHolds) {
+    Distributor distributor;
+    FakeWorker a, b;
+    // As restored from a log, with the ids they were given before
+    Scheduler::Task restored = makeTask();
+    restored.set_id(7);
+    EXPECT_EQ(distributor.addTask(restored), 7);
+    restored.set_id(8);
+    distributor.addTask(restored);
+    distributor.setNextTaskId(9);
+
+    distributor.addWorker(a.fds[0], a.id(), PROTOCOL_VERSION, 2);
+    google::protobuf::RepeatedField<uint64_t> held;
+    held.Add(7);
+    distributor.adoptTasks(a.id(), held);
+    distributor.start();
+
+    // Only the task the worker did not hold is dispatched
+    Scheduler::Task task;
+    ASSERT_EQ(receiveTask(a, b, task), &a);
+    EXPECT_EQ(task.id(), 8);
+    EXPECT_EQ(receiveTask(a, b, task, 200ms), nullptr);
+    EXPECT_TRUE(distributor.completeTask(a.id(), 7));
+    EXPECT_EQ(distributor.addTask(makeTask()), 9);
+    distributor.stop();
+}
+
+TEST(DistributorTest, DispatchesHighestPriorityFirst) {
+    Distributor distributor;
+    FakeWorker a, b;
+    uint64_t low = distributor.addTask(makeTask(), 1);
+    uint64_t high = distributor.addTask(makeTask(), 5);
+    uint64_t medium = distributor.addTask(makeTask(), 3);
+    distributor.addWorker(a.fds[0], a.id());
+    distributor.start();
+
+    Scheduler::Task task;
+    for (uint64_t expected: {high, medium, low}) {
+        ASSERT_EQ(receiveTask(a, b, task), &a);
+        EXPECT_EQ(task.id(), expected);
+        EXPECT_TRUE(distributor.completeTask(a.id(), task.id()));
+    }
+    distributor.stop();
+}
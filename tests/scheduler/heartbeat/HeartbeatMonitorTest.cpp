@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include "HeartbeatMonitor.hpp"
+#include "Master.hpp"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// The master is never started, suspecting or failing a worker it doesn't
+// know about does nothing
+TEST(HeartbeatMonitorTest, SeedsEstimateWithIntervalOfWorker) {
+    Master master{nullptr, "0"};
+    HeartbeatMonitor monitor{&master, 100ms};
+    // Neither sends a heartbeat. The first is suspected after about 560ms
+    // of silence, the second only after about 1.8s.
+    monitor.addWorker(1);
+    monitor.addWorker(2, 1000ms);
+    monitor.activate();
+
+    std::this_thread::sleep_for(1200ms);
+    EXPECT_TRUE(monitor.suspected(1));
+    EXPECT_FALSE(monitor.suspected(2));
+
+    // Frames closer together than the worker's interval count as a full one
+    for (int i = 0; i < 10; i++) {
+        monitor.registerHeartbeat(2);
+        std::this_thread::sleep_for(10ms);
+    }
+    std::this_thread::sleep_for(800ms);
+    EXPECT_FALSE(monitor.suspected(2));
+    monitor.stop();
+}
+
+// The master disconnects a reported worker only if it is still failed when
+// the event loop gets to it
+TEST(HeartbeatMonitorTest, FailedWorkerRecoversWhenHeardFrom) {
+    Master master{nullptr, "0"};
+    HeartbeatMonitor monitor{&master, 100ms};
+    monitor.addWorker(1);
+    monitor.activate();
+    EXPECT_FALSE(monitor.failed(1));
+
+    auto giveUp = std::chrono::steady_clock::now() + 5s;
+    while (!monitor.failed(1) && std::chrono::steady_clock::now() < giveUp) {
+        std::this_thread::sleep_for(50ms);
+    }
+    EXPECT_TRUE(monitor.failed(1));
+
+    monitor.registerHeartbeat(1);
+    EXPECT_FALSE(monitor.failed(1));
+    // Still armed, so it is no longer suspected on the next tick
+    std::this_thread::sleep_for(300ms);
+    EXPECT_FALSE(monitor.suspected(1));
+    EXPECT_FALSE(monitor.failed(2));
+    monitor.stop();
+}
@@ -1,8 +1,26 @@
 #include <gtest/gtest.h>
 
-//#include "Master.hpp"
-//#include "Vector.hpp"
-//#include "Worker.hpp"
+#include "Client.hpp"
+#include "Master.hpp"
+#include "Network.hpp"
+#include "Protocol.hpp"
+#include "Vector.hpp"
+#include "Worker.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 TEST(MasterTest, Constructor) {
     //Master master{nullptr, "3000"};
@@ -12,3 +30,166 @@ TEST(MasterTest, Constructor) {
         //workers.emplace_back(nullptr, "3000");
     //}
 }
+
+static constexpr const char* PORT = "18997";
+
+static Scheduler::Task makeTask(const std::string& payload) {
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    task.set_payload(payload);
+    return task;
+}
+
+// Runs a master logging to directory until it is stopped
+static void runMaster(Master& master, const std::string& directory) {
+    ASSERT_TRUE(master.init());
+    ASSERT_TRUE(master.restore(directory.c_str()));
+    ASSERT_TRUE(master.listen());
+    master.run();
+}
+
+static bool waitFor(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{30};
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    return true;
+}
+
+TEST(MasterTest, ResumedSessionGetsResultsOfTasksFromBeforeARestart) {
+    // Workers write to the master that is gone until they notice
+    std::signal(SIGPIPE, SIG_IGN);
+    char path[] = "/tmp/MasterTestXXXXXX";
+    ASSERT_NE(mkdtemp(path), nullptr);
+    std::string directory = path;
+
+    // Every worker holds on to its task until the master is gone, so all
+    // three are still pending when it stops
+    int session;
+    {
+        Master master{nullptr, PORT};
+        std::thread masterThread{runMaster, std::ref(master), directory};
+        std::atomic<int> running = 0;
+        std::atomic<bool> release = false;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < 3; i++) {
+            workers.emplace_back([&]() {
+                Worker worker{nullptr, PORT};
+                worker.setHandler(Scheduler::TaskType::TASK_ONE, [&](const Scheduler::Task&, std::string&) {
+                    running++;
+                    while (!release) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+                    }
+                    return true;
+                });
+                ASSERT_TRUE(waitFor([&]() { return worker.connect(); }));
+                worker.run();
+            });
+        }
+
+        Client client{nullptr, PORT};
+        ASSERT_TRUE(waitFor([&]() { return client.connect(); }));
+        session = client.session();
+        std::vector<std::future<TaskResult>> futures;
+        for (const char* payload: {"a", "b", "c"}) {
+            futures.push_back(client.submit(makeTask(payload)));
+        }
+        ASSERT_TRUE(waitFor([&]() { return running == 3; }));
+
+        master.stop();
+        masterThread.join();
+        release = true;
+        for (std::thread& worker: workers) {
+            worker.join();
+        }
+        for (auto& future: futures) {
+            EXPECT_FALSE(future.get().success);
+        }
+    }
+
+    Master master{nullptr, PORT};
+    std::thread masterThread{runMaster, std::ref(master), directory};
+    std::mutex m;
+    std::condition_variable cv;
+    std::map<uint64_t, std::string> resumed;
+    // A new client has no idea which ids the session already used
+    Client client{nullptr, PORT};
+    client.setResumedHandler([&](uint64_t requestId, TaskResult result) {
+        EXPECT_TRUE(result.success);
+        std::scoped_lock lock{m};
+        resumed[requestId] = result.result;
+        cv.notify_all();
+    });
+    ASSERT_TRUE(waitFor([&]() { return client.connect(session); }));
+    EXPECT_EQ(client.session(), session);
+    std::future<TaskResult> future;
+    uint64_t id = client.submit(makeTask("d"), future);
+    EXPECT_EQ(id, 4);
+
+    std::thread workerThread{[&]() {
+        Worker worker{nullptr, PORT};
+        worker.setHandler(Scheduler::TaskType::TASK_ONE, [](const Scheduler::Task& task, std::string& result) {
+            result = task.payload();
+            return true;
+        });
+        ASSERT_TRUE(worker.connect());
+        worker.run();
+    }};
+
+    TaskResult result = future.get();
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(result.result, "d");
+    {
+        std::unique_lock lock{m};
+        EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds{30}, [&]() { return resumed.size() == 3; }));
+        EXPECT_EQ(resumed, (std::map<uint64_t, std::string>{{1, "a"}, {2, "b"}, {3, "c"}}));
+    }
+
+    client.close();
+    master.stop();
+    masterThread.join();
+    workerThread.join();
+    std::remove((directory + "/tasks.log").c_str());
+    std::remove((directory + "/tasks.snapshot").c_str());
+    std::remove(directory.c_str());
+}
+
+// The heartbeat monitor only reports a silent worker, the event loop is the
+// one to disconnect it
+TEST(MasterTest, DisconnectsWorkerThatStopsSendingHeartbeats) {
+    std::signal(SIGPIPE, SIG_IGN);
+    char path[] = "/tmp/MasterTestXXXXXX";
+    ASSERT_NE(mkdtemp(path), nullptr);
+    std::string directory = path;
+    Master master{nullptr, PORT};
+    std::thread masterThread{runMaster, std::ref(master), directory};
+
+    int fd = -1;
+    ASSERT_TRUE(waitFor([&]() { return (fd = connectToHost(nullptr, PORT)) != -1; }));
+    struct timeval timeout{.tv_sec = 30, .tv_usec = 0};
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)), 0);
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_HANDSHAKE_REQ);
+    msg.mutable_heartbeat()->set_id(-1);
+    msg.mutable_heartbeat()->set_capacity(1);
+    msg.mutable_heartbeat()->set_heartbeat_interval_ms(50);
+    ASSERT_TRUE(sendMessage(fd, msg));
+    std::string s;
+    ASSERT_TRUE(Receive(fd, s));
+
+    // Never sends a heartbeat, so the next thing it sees is the master
+    // closing the connection rather than the receive timing out
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(Receive(fd, s));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{10});
+    close(fd);
+
+    master.stop();
+    masterThread.join();
+    std::remove((directory + "/tasks.log").c_str());
+    std::remove((directory + "/tasks.snapshot").c_str());
+    std::remove(directory.c_str());
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "Network.hpp"
+#include "Outbox.hpp"
+#include "Util.hpp"
+
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// The outbox writes to one end of a socket pair, the test reads from the
+// other
+struct SocketPair {
+    SocketPair() {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        // Small so that the outbox fills it quickly
+        int size = 16 * 1024;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+
+    ~SocketPair() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    int fds[2];
+};
+
+TEST(OutboxTest, SendsFramesInOrder) {
+    SocketPair sockets;
+    Outbox outbox;
+    std::vector<int> done;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(outbox.push("frame " + std::to_string(i), [&done, i]() { done.push_back(i); }));
+    }
+    EXPECT_EQ(outbox.size(), 3 * (4 + 7));
+
+    ASSERT_TRUE(outbox.flush(sockets.fds[0]));
+    EXPECT_TRUE(outbox.empty());
+    EXPECT_EQ(outbox.size(), 0);
+    EXPECT_EQ(done, (std::vector<int>{0, 1, 2}));
+
+    std::string frame;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(Receive(sockets.fds[1], frame));
+        EXPECT_EQ(frame, "frame " + std::to_string(i));
+    }
+}
+
+TEST(OutboxTest, LeavesWhatDoesNotFitQueued) {
+    SocketPair sockets;
+    Outbox outbox;
+    std::string big(256 * 1024, '\0');
+    for (size_t i = 0; i < big.size(); i++) {
+        big[i] = static_cast<char>(i * 7);
+    }
+    int done = 0;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(outbox.push(big, [&done]() { done++; }));
+    }
+
+    // Returns instead of waiting for the reader
+    ASSERT_TRUE(outbox.flush(sockets.fds[0]));
+    EXPECT_FALSE(outbox.empty());
+    EXPECT_LT(done, 4);
+
+    // Frames come out whole however the writes were split
+    std::thread reader([&sockets, &big]() {
+        std::string frame;
+        for (int i = 0; i < 4; i++) {
+            ASSERT_TRUE(Receive(sockets.fds[1], frame));
+            EXPECT_EQ(frame, big);
+        }
+    });
+    while (!outbox.empty()) {
+        ASSERT_TRUE(outbox.flush(sockets.fds[0]));
+        std::this_thread::yield();
+    }
+    reader.join();
+    EXPECT_EQ(done, 4);
+}
+
+TEST(OutboxTest, ClearCallsEveryCallback) {
+    SocketPair sockets;
+    Outbox outbox;
+    int done = 0;
+    for (int i = 0; i < 8; i++) {
+        ASSERT_TRUE(outbox.push(std::string(64 * 1024, 'x'), [&done]() { done++; }));
+    }
+    ASSERT_TRUE(outbox.flush(sockets.fds[0]));
+    ASSERT_FALSE(outbox.empty());
+
+    outbox.clear();
+    EXPECT_TRUE(outbox.empty());
+    EXPECT_EQ(outbox.size(), 0);
+    EXPECT_EQ(done, 8);
+}
+
+TEST(OutboxTest, RejectsOversizedMessage) {
+    Outbox outbox;
+    bool called = false;
+    EXPECT_FALSE(outbox.push(std::string(MAX_MESSAGE_SIZE + 1, 'x'), [&called]() { called = true; }));
+    EXPECT_TRUE(outbox.empty());
+    EXPECT_FALSE(called);
+}
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+
+#include "PhiAccrual.hpp"
+
+TEST(PhiAccrualTest, PhiGrowsWithSilence) {
+    EXPECT_NEAR(phi(1000, 1000, 100), 0.30103, 1e-4);
+    EXPECT_LT(phi(1100, 1000, 100), phi(1200, 1000, 100));
+    EXPECT_GT(phi(2000, 1000, 100), 8);
+    // A noisier worker is given longer before it is suspected
+    EXPECT_GT(phi(1300, 1000, 100), phi(1300, 1000, 300));
+}
+
+TEST(PhiAccrualTest, DeviationsInvertPhi) {
+    for (double threshold: {1.0, 3.0, 8.0}) {
+        double deviations = phiDeviations(threshold);
+        EXPECT_NEAR(phi(1000 + deviations * 100, 1000, 100), threshold, 1e-6);
+    }
+}
+
+TEST(PhiAccrualTest, EstimateConvergesOnInterval) {
+    ArrivalEstimate estimate{.mean = 1000, .variance = 250 * 250};
+    for (int i = 0; i < 200; i++) {
+        estimate.add(i % 2 == 0 ? 190 : 210);
+    }
+    EXPECT_NEAR(estimate.mean, 200, 15);
+    EXPECT_LT(estimate.variance, 400);
+}
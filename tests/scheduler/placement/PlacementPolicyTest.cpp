@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "PlacementPolicy.hpp"
+
+static void addWorkers(WorkerPool& pool, IPlacementPolicy& policy, int n) {
+    for (int i = 0; i < n; i++) {
+        pool.add(WorkerLoad{.id = i, .fd = 100 + i, .capacity = 2});
+        policy.addWorker(i);
+    }
+}
+
+TEST(PlacementPolicyTest, WorkerPoolCapacity) {
+    WorkerPool pool;
+    EXPECT_FALSE(pool.hasCapacity());
+    pool.add(WorkerLoad{.id = 1, .fd = 5, .capacity = 1});
+    EXPECT_TRUE(pool.hasCapacity());
+
+    pool.acquire(*pool.find(1));
+    EXPECT_FALSE(pool.hasCapacity());
+    pool.release(*pool.find(1));
+    EXPECT_TRUE(pool.hasCapacity());
+
+    EXPECT_TRUE(pool.remove(1));
+    EXPECT_FALSE(pool.remove(1));
+    EXPECT_FALSE(pool.hasCapacity());
+    EXPECT_EQ(pool.find(1), nullptr);
+}
+
+TEST(PlacementPolicyTest, LeastLoaded) {
+    WorkerPool pool;
+    LeastLoadedPolicy policy;
+    addWorkers(pool, policy, 3);
+    pool.acquire(*pool.find(0));
+    pool.acquire(*pool.find(2));
+
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    WorkerLoad* w = policy.select(task, pool);
+    ASSERT_NE(w, nullptr);
+    EXPECT_EQ(w->id, 1);
+}
+
+TEST(PlacementPolicyTest, PowerOfTwoChoicesSkipsFullWorkers) {
+    WorkerPool pool;
+    PowerOfTwoChoicesPolicy policy;
+    addWorkers(pool, policy, 4);
+    for (int i = 0; i < 3; i++) {
+        pool.setCapacity(*pool.find(i), 0);
+    }
+
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    for (int i = 0; i < 100; i++) {
+        WorkerLoad* w = policy.select(task, pool);
+        ASSERT_NE(w, nullptr);
+        EXPECT_EQ(w->id, 3);
+    }
+}
+
+TEST(PlacementPolicyTest, ConsistentHashAffinity) {
+    WorkerPool pool;
+    ConsistentHashPolicy policy;
+    addWorkers(pool, policy, 8);
+
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    task.set_key("dataset-42");
+    WorkerLoad* owner = policy.select(task, pool);
+    ASSERT_NE(owner, nullptr);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(policy.select(task, pool), owner);
+    }
+
+    // Spills over to another worker once the owner is full
+    pool.setCapacity(*owner, 0);
+    WorkerLoad* spill = policy.select(task, pool);
+    ASSERT_NE(spill, nullptr);
+    EXPECT_NE(spill->id, owner->id);
+}
+
+TEST(PlacementPolicyTest, SuspectWorkersAreSkipped) {
+    WorkerPool pool;
+    LeastLoadedPolicy policy;
+    addWorkers(pool, policy, 2);
+    pool.acquire(*pool.find(1));
+    pool.setSuspect(*pool.find(0), true);
+
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    WorkerLoad* w = policy.select(task, pool);
+    ASSERT_NE(w, nullptr);
+    EXPECT_EQ(w->id, 1);
+
+    pool.acquire(*w);
+    EXPECT_FALSE(pool.hasCapacity());
+    pool.setSuspect(*pool.find(0), false);
+    EXPECT_TRUE(pool.hasCapacity());
+}
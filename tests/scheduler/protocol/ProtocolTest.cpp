@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "Network.hpp"
+#include "Protocol.hpp"
+#include "Util.hpp"
+
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TEST(ProtocolTest, UpgradeLegacyTask) {
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_TWO);
+    task.set_id(7);
+
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ);
+    msg.set_data(task.SerializeAsString());
+    EXPECT_EQ(messageVersion(msg), LEGACY_PROTOCOL_VERSION);
+
+    ASSERT_TRUE(upgradeMessage(msg));
+    ASSERT_TRUE(msg.has_task());
+    EXPECT_FALSE(msg.has_data());
+    EXPECT_EQ(msg.task().type(), Scheduler::TaskType::TASK_TWO);
+    EXPECT_EQ(msg.task().id(), 7);
+}
+
+TEST(ProtocolTest, DowngradeRoundTrip) {
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_BATCH_RES);
+    for (int i = 0; i < 3; i++) {
+        Scheduler::TaskResponse* response = msg.mutable_task_response_batch()->add_responses();
+        response->set_success(true);
+        response->set_id(i);
+    }
+
+    ASSERT_TRUE(downgradeMessage(msg));
+    EXPECT_EQ(msg.payload_case(), Scheduler::Message::PAYLOAD_NOT_SET);
+    ASSERT_TRUE(msg.has_data());
+
+    ASSERT_TRUE(upgradeMessage(msg));
+    ASSERT_TRUE(msg.has_task_response_batch());
+    ASSERT_EQ(msg.task_response_batch().responses_size(), 3);
+    EXPECT_EQ(msg.task_response_batch().responses(2).id(), 2);
+}
+
+TEST(ProtocolTest, UpgradeLeavesCurrentVersionAlone) {
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_HEARTBEAT);
+    msg.set_version(PROTOCOL_VERSION);
+    msg.mutable_heartbeat()->set_id(3);
+
+    ASSERT_TRUE(upgradeMessage(msg));
+    EXPECT_EQ(msg.heartbeat().id(), 3);
+    EXPECT_EQ(messageVersion(msg), PROTOCOL_VERSION);
+}
+
+TEST(ProtocolTest, ResultChunkRoundTrip) {
+    std::string data(RESULT_CHUNK_SIZE, '\0');
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i);
+    }
+
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_RESULT_CHUNK);
+    Scheduler::ResultChunk* chunk = msg.mutable_result_chunk();
+    chunk->set_id(5);
+    chunk->set_offset(RESULT_CHUNK_SIZE);
+    chunk->set_data(data);
+    EXPECT_LE(msg.ByteSizeLong(), MAX_MESSAGE_SIZE);
+
+    ASSERT_TRUE(downgradeMessage(msg));
+    ASSERT_TRUE(upgradeMessage(msg));
+    ASSERT_TRUE(msg.has_result_chunk());
+    EXPECT_EQ(msg.result_chunk().offset(), RESULT_CHUNK_SIZE);
+    EXPECT_EQ(msg.result_chunk().data(), data);
+}
+
+// A version 1 peer frames its messages like we do but nests the payload
+// in data and doesn't set a version
+TEST(ProtocolTest, TalksToFramedLegacyPeer) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    Scheduler::TaskResponse response;
+    response.set_success(true);
+    response.set_id(11);
+    Scheduler::Message legacy;
+    legacy.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_RES);
+    legacy.set_data(response.SerializeAsString());
+    ASSERT_TRUE(Send(fds[1], legacy.SerializeAsString()));
+
+    std::string frame;
+    Scheduler::Message received;
+    ASSERT_TRUE(Receive(fds[0], frame));
+    ASSERT_TRUE(received.ParseFromString(frame));
+    EXPECT_EQ(messageVersion(received), LEGACY_PROTOCOL_VERSION);
+    ASSERT_TRUE(upgradeMessage(received));
+    ASSERT_TRUE(received.has_task_response());
+    EXPECT_EQ(received.task_response().id(), 11);
+
+    Scheduler::Message msg;
+    msg.set_type(Scheduler::MessageType::MESSAGE_TYPE_TASK_REQ);
+    msg.mutable_task()->set_type(Scheduler::TaskType::TASK_ONE);
+    msg.mutable_task()->set_id(12);
+    ASSERT_TRUE(sendMessage(fds[0], msg, LEGACY_PROTOCOL_VERSION));
+
+    ASSERT_TRUE(Receive(fds[1], frame));
+    ASSERT_TRUE(legacy.ParseFromString(frame));
+    EXPECT_FALSE(legacy.has_version());
+    EXPECT_EQ(legacy.payload_case(), Scheduler::Message::PAYLOAD_NOT_SET);
+    Scheduler::Task task;
+    ASSERT_TRUE(task.ParseFromString(legacy.data()));
+    EXPECT_EQ(task.id(), 12);
+
+    close(fds[0]);
+    close(fds[1]);
+}
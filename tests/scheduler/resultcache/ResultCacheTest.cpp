@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "ResultCache.hpp"
+
+#include <string>
+
+static Scheduler::Task makeTask(const std::string& payload, Scheduler::TaskType type = Scheduler::TaskType::TASK_ONE) {
+    Scheduler::Task task;
+    task.set_type(type);
+    task.set_payload(payload);
+    return task;
+}
+
+TEST(ResultCacheTest, KeysTasksByTypeAndPayload) {
+    Scheduler::Task task = makeTask("abc");
+    Scheduler::Task same = makeTask("abc");
+    same.set_id(42);
+    EXPECT_EQ(ResultCache::content(task), ResultCache::content(same));
+    EXPECT_NE(ResultCache::content(task), ResultCache::content(makeTask("abd")));
+    EXPECT_NE(ResultCache::content(task), ResultCache::content(makeTask("abc", Scheduler::TaskType::TASK_TWO)));
+    EXPECT_EQ(ResultCache::key(ResultCache::content(task)), ResultCache::key(ResultCache::content(same)));
+    EXPECT_NE(ResultCache::key(ResultCache::content(task)), ResultCache::key(ResultCache::content(makeTask("abd"))));
+}
+
+TEST(ResultCacheTest, ContentSharingAKeyIsAMiss) {
+    ResultCache cache(16);
+    std::string result;
+    cache.put(1, "first", "one");
+    EXPECT_FALSE(cache.get(1, "second", result));
+    ASSERT_TRUE(cache.get(1, "first", result));
+    EXPECT_EQ(result, "one");
+
+    // The newer content takes the key over
+    cache.put(1, "second", "two");
+    EXPECT_FALSE(cache.get(1, "first", result));
+    ASSERT_TRUE(cache.get(1, "second", result));
+    EXPECT_EQ(result, "two");
+    EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(ResultCacheTest, ReturnsStoredResults) {
+    ResultCache cache(16);
+    std::string result;
+    EXPECT_FALSE(cache.get(1, "1", result));
+    cache.put(1, "1", "one");
+    ASSERT_TRUE(cache.get(1, "1", result));
+    EXPECT_EQ(result, "one");
+    cache.put(1, "1", "uno");
+    ASSERT_TRUE(cache.get(1, "1", result));
+    EXPECT_EQ(result, "uno");
+    EXPECT_EQ(cache.hits(), 2);
+    EXPECT_EQ(cache.misses(), 1);
+}
+
+TEST(ResultCacheTest, StaysWithinCapacity) {
+    ResultCache cache(100);
+    for (uint64_t key = 0; key < 1000; key++) {
+        cache.put(key, std::to_string(key), std::to_string(key));
+        EXPECT_LE(cache.size(), 100);
+    }
+    EXPECT_EQ(cache.size(), 100);
+}
+
+TEST(ResultCacheTest, KeepsFrequentResultsThroughAScan) {
+    ResultCache cache(100);
+    std::string result;
+    for (uint64_t key = 0; key < 50; key++) {
+        cache.get(key, std::to_string(key), result);
+        cache.put(key, std::to_string(key), std::to_string(key));
+    }
+    for (int round = 0; round < 3; round++) {
+        for (uint64_t key = 0; key < 50; key++) {
+            cache.get(key, std::to_string(key), result);
+        }
+    }
+    // Keys asked for once each must not flush the popular ones
+    for (uint64_t key = 1000; key < 2000; key++) {
+        cache.get(key, std::to_string(key), result);
+        cache.put(key, std::to_string(key), std::to_string(key));
+    }
+    int kept = 0;
+    for (uint64_t key = 0; key < 50; key++) {
+        kept += cache.get(key, std::to_string(key), result);
+    }
+    EXPECT_EQ(kept, 50);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "ShardMap.hpp"
+
+#include <string>
+#include <vector>
+
+TEST(ShardMapTest, ParsesMasterAddresses) {
+    ShardMap map;
+    ASSERT_TRUE(ShardMap::parse("localhost:8999,10.0.0.2:9000", map));
+    ASSERT_EQ(map.size(), 2);
+    EXPECT_EQ(map.master(0).hostname, "localhost");
+    EXPECT_EQ(map.master(0).port, "8999");
+    EXPECT_EQ(map.master(1).hostname, "10.0.0.2");
+    EXPECT_EQ(map.master(1).port, "9000");
+}
+
+TEST(ShardMapTest, RejectsInvalidDescriptions) {
+    ShardMap map;
+    ASSERT_TRUE(ShardMap::parse("localhost:8999", map));
+    EXPECT_FALSE(ShardMap::parse("", map));
+    EXPECT_FALSE(ShardMap::parse("localhost", map));
+    EXPECT_FALSE(ShardMap::parse("localhost:8999,:9000", map));
+    EXPECT_FALSE(ShardMap::parse("localhost:", map));
+    // Left as it was
+    EXPECT_EQ(map.size(), 1);
+}
+
+TEST(ShardMapTest, MapsKeysTheSameWayInEveryProcess) {
+    ShardMap a;
+    ShardMap b;
+    ASSERT_TRUE(ShardMap::parse("m1:1,m2:2,m3:3", a));
+    ASSERT_TRUE(ShardMap::parse("m1:1,m2:2,m3:3", b));
+    std::vector<int> counts(3);
+    for (int i = 0; i < 30000; i++) {
+        std::string key = "task-" + std::to_string(i);
+        int shard = a.shardOf(key);
+        ASSERT_EQ(shard, b.shardOf(key));
+        counts[shard]++;
+    }
+    for (int count: counts) {
+        EXPECT_GT(count, 7000);
+        EXPECT_LT(count, 13000);
+    }
+}
+
+TEST(ShardMapTest, AddingAMasterOnlyMovesItsShareOfKeys) {
+    ShardMap before;
+    ShardMap after;
+    ASSERT_TRUE(ShardMap::parse("m1:1,m2:2,m3:3", before));
+    ASSERT_TRUE(ShardMap::parse("m1:1,m2:2,m3:3,m4:4", after));
+    int moved = 0;
+    for (int i = 0; i < 10000; i++) {
+        std::string key = "task-" + std::to_string(i);
+        int shard = after.shardOf(key);
+        if (shard != before.shardOf(key)) {
+            EXPECT_EQ(shard, 3);
+            moved++;
+        }
+    }
+    EXPECT_GT(moved, 1500);
+    EXPECT_LT(moved, 3500);
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include "ClientRequests.hpp"
+#include "TaskGraph.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+static Scheduler::Task makeTask(uint32_t cost = 1) {
+    Scheduler::Task task;
+    task.set_type(Scheduler::TaskType::TASK_ONE);
+    task.set_cost(cost);
+    return task;
+}
+
+static void add(TaskGraph& graph, uint64_t id, std::initializer_list<uint64_t> dependencies, uint32_t cost = 1) {
+    Vector<uint64_t> deps;
+    for (uint64_t dependency: dependencies) {
+        deps.push_back(dependency);
+    }
+    Scheduler::Task task = makeTask(cost);
+    task.set_id(id);
+    graph.add(id, std::move(task), deps);
+}
+
+// Ids and ranks of the tasks that are ready, in order
+static std::vector<std::pair<uint64_t, uint64_t>> popReady(TaskGraph& graph) {
+    std::vector<std::pair<uint64_t, uint64_t>> ready;
+    Scheduler::Task task;
+    uint64_t rank;
+    while (graph.popReady(task, rank)) {
+        ready.push_back({task.id(), rank});
+    }
+    return ready;
+}
+
+TEST(TaskGraphTest, ReleasesTasksOnceTheirDependenciesComplete) {
+    TaskGraph graph;
+    // 1 -> 3, 2 -> 3, 3 -> 4
+    add(graph, 1, {});
+    add(graph, 2, {});
+    add(graph, 3, {1, 2});
+    add(graph, 4, {3});
+    auto ready = popReady(graph);
+    ASSERT_EQ(ready.size(), 2);
+    EXPECT_EQ(ready[0].first, 1);
+    EXPECT_EQ(ready[1].first, 2);
+
+    Vector<uint64_t> failed;
+    graph.complete(1, true, failed);
+    EXPECT_TRUE(popReady(graph).empty());
+    graph.complete(2, true, failed);
+    ready = popReady(graph);
+    ASSERT_EQ(ready.size(), 1);
+    EXPECT_EQ(ready[0].first, 3);
+    graph.complete(3, true, failed);
+    ready = popReady(graph);
+    ASSERT_EQ(ready.size(), 1);
+    EXPECT_EQ(ready[0].first, 4);
+    graph.complete(4, true, failed);
+    EXPECT_EQ(failed.size(), 0);
+    EXPECT_EQ(graph.size(), 0);
+}
+
+TEST(TaskGraphTest, RanksByLongestChainOfCost) {
+    TaskGraph graph;
+    // 1 -> 2 -> 3 is the critical path, 4 -> 5 is cheaper
+    add(graph, 1, {});
+    add(graph, 2, {1}, 5);
+    add(graph, 3, {2});
+    add(graph, 4, {});
+    add(graph, 5, {4}, 2);
+    auto ready = popReady(graph);
+    ASSERT_EQ(ready.size(), 2);
+    EXPECT_EQ(ready[0], std::make_pair(uint64_t{1}, uint64_t{7}));
+    EXPECT_EQ(ready[1], std::make_pair(uint64_t{4}, uint64_t{3}));
+}
+
+TEST(TaskGraphTest, DependenciesNoLongerInTheGraphHaveCompleted) {
+    TaskGraph graph;
+    add(graph, 1, {});
+    popReady(graph);
+    Vector<uint64_t> failed;
+    graph.complete(1, true, failed);
+
+    add(graph, 2, {1, 42});
+    auto ready = popReady(graph);
+    ASSERT_EQ(ready.size(), 1);
+    EXPECT_EQ(ready[0].first, 2);
+}
+
+TEST(TaskGraphTest, FailureFailsEverythingDownstream) {
+    TaskGraph graph;
+    // 1 -> 2 -> 3, 4 -> 3, 5 on its own
+    add(graph, 1, {});
+    add(graph, 2, {1});
+    add(graph, 4, {});
+    add(graph, 3, {2, 4});
+    add(graph, 5, {});
+    popReady(graph);
+
+    Vector<uint64_t> failed;
+    graph.complete(1, false, failed);
+    ASSERT_EQ(failed.size(), 2);
+    std::vector<uint64_t> ids{failed[0], failed[1]};
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, (std::vector<uint64_t>{2, 3}));
+
+    // 4 completing has nothing left to release
+    graph.complete(4, true, failed);
+    EXPECT_TRUE(popReady(graph).empty());
+    EXPECT_EQ(graph.size(), 1);
+}
+
+static google::protobuf::RepeatedField<uint64_t> dependsOn(std::initializer_list<uint64_t> ids) {
+    google::protobuf::RepeatedField<uint64_t> field;
+    for (uint64_t id: ids) {
+        field.Add(id);
+    }
+    return field;
+}
+
+TEST(TaskGraphTest, DependingOnAnAlreadyFailedRequestFails) {
+    // Client requests 10 -> 11 run as tasks 1 -> 2
+    TaskGraph graph;
+    ClientRequests requests;
+    Vector<uint64_t> dependencies;
+    ASSERT_TRUE(requests.resolve(dependsOn({}), dependencies));
+    add(graph, 1, {});
+    requests.add(10, 1);
+    ASSERT_TRUE(requests.resolve(dependsOn({10}), dependencies));
+    ASSERT_EQ(dependencies.size(), 1);
+    EXPECT_EQ(dependencies[0], 1);
+    add(graph, 2, {1});
+    requests.add(11, 2);
+    popReady(graph);
+
+    Vector<uint64_t> failed;
+    graph.complete(1, false, failed);
+    ASSERT_EQ(failed.size(), 1);
+    requests.complete(10, false);
+    requests.complete(11, false);
+    EXPECT_EQ(requests.pending(), 0);
+
+    // Both are out of the graph, but anything submitted on them now fails
+    // instead of running as if they had succeeded
+    Vector<uint64_t> late;
+    EXPECT_FALSE(requests.resolve(dependsOn({10}), late));
+    EXPECT_FALSE(requests.resolve(dependsOn({12, 11}), late));
+
+    requests.add(12, 3);
+    requests.complete(12, true);
+    EXPECT_TRUE(requests.resolve(dependsOn({12}), late));
+    EXPECT_EQ(late.size(), 0);
+}
+
+TEST(TaskGraphTest, RemembersOnlyTheMostRecentFailures) {
+    ClientRequests requests;
+    for (uint64_t id = 0; id <= ClientRequests::MAX_FAILED; id++) {
+        requests.add(id, id);
+        requests.complete(id, false);
+    }
+    Vector<uint64_t> dependencies;
+    EXPECT_TRUE(requests.resolve(dependsOn({0}), dependencies));
+    EXPECT_FALSE(requests.resolve(dependsOn({1}), dependencies));
+    EXPECT_FALSE(requests.resolve(dependsOn({ClientRequests::MAX_FAILED}), dependencies));
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include "TaskLog.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+class TaskLogTest: public ::testing::Test {
+protected:
+    void SetUp() override {
+        char path[] = "/tmp/TaskLogTestXXXXXX";
+        ASSERT_NE(mkdtemp(path), nullptr);
+        directory = path;
+    }
+
+    void TearDown() override {
+        std::remove((directory + "/tasks.log").c_str());
+        std::remove((directory + "/tasks.snapshot").c_str());
+        std::remove(directory.c_str());
+    }
+
+    static Scheduler::Task makeTask(const std::string& payload) {
+        Scheduler::Task task;
+        task.set_type(Scheduler::TaskType::TASK_ONE);
+        task.set_payload(payload);
+        return task;
+    }
+
+    std::vector<Scheduler::LogRecord> reopen(TaskLog& log) {
+        std::vector<Scheduler::LogRecord> restored;
+        EXPECT_TRUE(log.open([&](const Scheduler::LogRecord& record) {
+            restored.push_back(record);
+        }));
+        return restored;
+    }
+
+    static size_t fileSize(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    std::string directory;
+};
+
+TEST_F(TaskLogTest, RestoresPendingTasksInSubmissionOrder) {
+    {
+        TaskLog log{directory};
+        EXPECT_TRUE(reopen(log).empty());
+        log.submit(3, makeTask("c"), 1, 30);
+        log.submit(1, makeTask("a"), 2, 10);
+        log.submit(2, makeTask("b"), 1, 20);
+        log.complete(3);
+        EXPECT_TRUE(log.sync());
+    }
+
+    TaskLog log{directory};
+    std::vector<Scheduler::LogRecord> restored = reopen(log);
+    ASSERT_EQ(restored.size(), 2);
+    EXPECT_EQ(restored[0].task().id(), 1);
+    EXPECT_EQ(restored[0].task().payload(), "a");
+    EXPECT_EQ(restored[0].client_id(), 2);
+    EXPECT_EQ(restored[0].request_id(), 10);
+    EXPECT_EQ(restored[1].task().id(), 2);
+    EXPECT_EQ(log.nextTaskId(), 4);
+    EXPECT_EQ(log.nextClientId(), 3);
+}
+
+TEST_F(TaskLogTest, RecordTornByACrashEndsTheLog) {
+    {
+        TaskLog log{directory};
+        reopen(log);
+        log.submit(1, makeTask("a"), 1, 1);
+        EXPECT_TRUE(log.sync());
+    }
+    {
+        std::ofstream out{directory + "/tasks.log", std::ios::app | std::ios::binary};
+        out.write("\0\0\0\x40partial", 11);
+    }
+    {
+        TaskLog log{directory};
+        EXPECT_EQ(reopen(log).size(), 1);
+        log.submit(2, makeTask("b"), 1, 2);
+        EXPECT_TRUE(log.sync());
+    }
+
+    TaskLog log{directory};
+    std::vector<Scheduler::LogRecord> restored = reopen(log);
+    ASSERT_EQ(restored.size(), 2);
+    EXPECT_EQ(restored[1].task().payload(), "b");
+}
+
+TEST_F(TaskLogTest, CompactsIntoSnapshotOnceTheLogOutgrowsThePendingTasks) {
+    constexpr uint64_t N = TaskLog::MIN_COMPACT_RECORDS;
+    {
+        TaskLog log{directory};
+        reopen(log);
+        for (uint64_t id = 1; id <= N; id++) {
+            log.submit(id, makeTask("payload"), 1, id);
+        }
+        EXPECT_TRUE(log.sync());
+        for (uint64_t id = 1; id <= N - 10; id++) {
+            log.complete(id);
+        }
+        EXPECT_TRUE(log.sync());
+        EXPECT_EQ(fileSize(directory + "/tasks.log"), 0);
+        EXPECT_GT(fileSize(directory + "/tasks.snapshot"), 0);
+
+        log.complete(N);
+        EXPECT_TRUE(log.sync());
+    }
+
+    TaskLog log{directory};
+    std::vector<Scheduler::LogRecord> restored = reopen(log);
+    ASSERT_EQ(restored.size(), 9);
+    EXPECT_EQ(restored[0].task().id(), N - 9);
+    EXPECT_EQ(log.nextTaskId(), N + 1);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include "TimerWheel.hpp"
+
+#include <map>
+#include <random>
+#include <vector>
+
+TEST(TimerWheelTest, FiresAtDeadline) {
+    TimerWheel wheel;
+    wheel.schedule(1, 5);
+    wheel.schedule(2, 5000);
+    std::vector<int> fired;
+    auto fire = [&](int id) { fired.push_back(id); };
+
+    wheel.advance(4, fire);
+    EXPECT_TRUE(fired.empty());
+    wheel.advance(5, fire);
+    ASSERT_EQ(fired.size(), 1);
+    EXPECT_EQ(fired[0], 1);
+
+    wheel.advance(4999, fire);
+    EXPECT_EQ(fired.size(), 1);
+    wheel.advance(5000, fire);
+    ASSERT_EQ(fired.size(), 2);
+    EXPECT_EQ(fired[1], 2);
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, RescheduleAndCancel) {
+    TimerWheel wheel;
+    wheel.schedule(3, 10);
+    wheel.schedule(3, 100);
+    wheel.schedule(4, 10);
+    wheel.cancel(4);
+    EXPECT_FALSE(wheel.scheduled(4));
+
+    std::vector<int> fired;
+    wheel.advance(99, [&](int id) { fired.push_back(id); });
+    EXPECT_TRUE(fired.empty());
+    EXPECT_TRUE(wheel.scheduled(3));
+    wheel.advance(100, [&](int id) { fired.push_back(id); });
+    ASSERT_EQ(fired.size(), 1);
+    EXPECT_EQ(fired[0], 3);
+}
+
+TEST(TimerWheelTest, RearmFromCallback) {
+    TimerWheel wheel;
+    wheel.schedule(0, 1);
+    int fired = 0;
+    wheel.advance(1000, [&](int id) {
+        fired++;
+        wheel.schedule(id, wheel.now() + 100);
+    });
+    EXPECT_EQ(fired, 10);
+}
+
+TEST(TimerWheelTest, MatchesReferenceAcrossLevels) {
+    std::mt19937_64 rng{42};
+    TimerWheel wheel{12345};
+    std::map<int, uint64_t> expected;
+    for (int id = 0; id < 2000; id++) {
+        uint64_t expiry = wheel.now() + 1 + rng() % 300000;
+        wheel.schedule(id, expiry);
+        expected[id] = expiry;
+    }
+
+    uint64_t now = wheel.now();
+    while (!expected.empty()) {
+        now += 1 + rng() % 500;
+        wheel.advance(now, [&](int id) {
+            ASSERT_TRUE(expected.contains(id));
+            EXPECT_EQ(expected[id], wheel.now());
+            expected.erase(id);
+        });
+        for (auto& [id, expiry]: expected) {
+            ASSERT_GT(expiry, now);
+        }
+    }
+}
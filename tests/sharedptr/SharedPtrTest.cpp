@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 
 #include "SharedPtr.hpp"
@@ -18,3 +19,101 @@ TEST(SharedPtrTest, Constructor) {
     SharedPtr<int> x = SharedPtr(new int(888));
     copy_into_thread(10, x);
 }
+
+TEST(SharedPtrTest, NullAllocatesNothing) {
+    SharedPtr<int> null;
+    EXPECT_EQ(null.get(), nullptr);
+    EXPECT_EQ(null.get_count(), 0);
+    EXPECT_FALSE(null);
+    SharedPtr<int> copy = null;
+    EXPECT_EQ(copy.get_count(), 0);
+}
+
+// Counts live instances to check every object is destroyed exactly once
+struct Tracked {
+    static inline std::atomic<int> live = 0;
+    int val;
+
+    explicit Tracked(int val): val(val) {
+        live++;
+    }
+
+    virtual ~Tracked() {
+        live--;
+    }
+};
+
+struct Derived: Tracked {
+    explicit Derived(int val): Tracked(val) {}
+};
+
+TEST(SharedPtrTest, MakeShared) {
+    {
+        SharedPtr<Tracked> ptr = makeShared<Tracked>(7);
+        EXPECT_EQ(ptr->val, 7);
+        EXPECT_EQ(Tracked::live, 1);
+        SharedPtr<Tracked> copy = ptr;
+        EXPECT_EQ(ptr.get_count(), 2);
+        ptr.reset();
+        EXPECT_EQ(copy.get_count(), 1);
+        EXPECT_EQ(Tracked::live, 1);
+    }
+    EXPECT_EQ(Tracked::live, 0);
+}
+
+TEST(SharedPtrTest, ConvertsToBase) {
+    {
+        SharedPtr<Tracked> base = makeShared<Derived>(3);
+        EXPECT_EQ(base->val, 3);
+        SharedPtr<Tracked> other{new Derived(4)};
+        base = other;
+        EXPECT_EQ(Tracked::live, 1);
+    }
+    EXPECT_EQ(Tracked::live, 0);
+}
+
+TEST(SharedPtrTest, Aliasing) {
+    SharedPtr<int> member;
+    {
+        SharedPtr<Tracked> owner = makeShared<Tracked>(5);
+        member = SharedPtr<int>(owner, &owner->val);
+        EXPECT_EQ(owner.get_count(), 2);
+    }
+    // The member keeps the whole object alive
+    EXPECT_EQ(Tracked::live, 1);
+    EXPECT_EQ(*member, 5);
+    member.reset();
+    EXPECT_EQ(Tracked::live, 0);
+}
+
+TEST(SharedPtrTest, WeakPtr) {
+    WeakPtr<Tracked> weak;
+    EXPECT_TRUE(weak.expired());
+    {
+        SharedPtr<Tracked> ptr = makeShared<Tracked>(1);
+        weak = WeakPtr<Tracked>(ptr);
+        EXPECT_FALSE(weak.expired());
+        SharedPtr<Tracked> locked = weak.lock();
+        EXPECT_EQ(locked.get(), ptr.get());
+        EXPECT_EQ(ptr.get_count(), 2);
+    }
+    EXPECT_EQ(Tracked::live, 0);
+    EXPECT_TRUE(weak.expired());
+    EXPECT_EQ(weak.lock().get(), nullptr);
+}
+
+TEST(SharedPtrTest, LockRacesWithRelease) {
+    for (int round = 0; round < 1000; round++) {
+        SharedPtr<Tracked> ptr = makeShared<Tracked>(round);
+        WeakPtr<Tracked> weak{ptr};
+        std::thread locker{[&weak, round]() {
+            SharedPtr<Tracked> locked = weak.lock();
+            if (locked) {
+                EXPECT_EQ(locked->val, round);
+            }
+        }};
+        ptr.reset();
+        locker.join();
+        EXPECT_EQ(Tracked::live, 0);
+    }
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "IntrusiveTsList.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Item: TsListHook<Item> {
+    int val = 0;
+};
+
+TEST(IntrusiveTsListTest, ForEachFrontToBack) {
+    std::vector<Item> items(5);
+    IntrusiveTsList<Item> list;
+    for (int i = 0; i < 5; i++) {
+        items[i].val = i;
+        list.pushFront(items[i]);
+    }
+
+    int i = 4;
+    list.forEach([&i, &items](Item& item) {
+        EXPECT_EQ(&item, &items[i]);
+        i--;
+    });
+    EXPECT_EQ(i, -1);
+}
+
+TEST(IntrusiveTsListTest, RemoveIfHandsElementsBack) {
+    IntrusiveTsList<Item> list;
+    for (int i = 0; i < 10; i++) {
+        Item* item = new Item;
+        item->val = i;
+        list.pushFront(*item);
+    }
+
+    size_t removed = list.removeIf([](Item& item) { return item.val % 2 == 0; }, [](Item& item) { delete &item; });
+    EXPECT_EQ(removed, 5);
+
+    int i = 9;
+    list.forEach([&i](Item& item) {
+        EXPECT_EQ(item.val, i);
+        i -= 2;
+    });
+    EXPECT_EQ(i, -1);
+
+    list.removeIf([](Item&) { return true; }, [](Item& item) { delete &item; });
+    EXPECT_TRUE(list.empty());
+}
+
+TEST(IntrusiveTsListTest, RemoveOne) {
+    Item a, b;
+    IntrusiveTsList<Item> list;
+    list.pushFront(a);
+    list.pushFront(b);
+    EXPECT_TRUE(list.remove(a));
+    EXPECT_FALSE(list.remove(a));
+    // Free to go on a list again
+    list.pushFront(a);
+    EXPECT_TRUE(list.remove(b));
+    EXPECT_TRUE(list.remove(a));
+    EXPECT_TRUE(list.empty());
+}
+
+struct Tagged: TsListHook<Tagged, struct First>, TsListHook<Tagged, struct Second> {
+    int val = 0;
+};
+
+TEST(IntrusiveTsListTest, OnTwoListsAtOnce) {
+    std::vector<Tagged> items(4);
+    IntrusiveTsList<Tagged, First> all;
+    IntrusiveTsList<Tagged, Second> odd;
+    for (int i = 0; i < 4; i++) {
+        items[i].val = i;
+        all.pushFront(items[i]);
+        if (i % 2 == 1) {
+            odd.pushFront(items[i]);
+        }
+    }
+    odd.removeIf([](Tagged& item) { return item.val == 3; });
+
+    int sum = 0;
+    all.forEach([&sum](Tagged& item) { sum += item.val; });
+    EXPECT_EQ(sum, 6);
+    sum = 0;
+    odd.forEach([&sum](Tagged& item) { sum += item.val; });
+    EXPECT_EQ(sum, 1);
+}
+
+TEST(IntrusiveTsListTest, ConcurrentPushAndRemove) {
+    constexpr int THREADS = 4;
+    constexpr int PER_THREAD = 2000;
+    std::vector<Item> items(THREADS * PER_THREAD);
+    IntrusiveTsList<Item> list;
+    std::atomic<int> removed = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < PER_THREAD; i++) {
+                Item& item = items[t * PER_THREAD + i];
+                item.val = t;
+                list.pushFront(item);
+                if (i % 100 == 99) {
+                    // Only this thread's elements, so none is removed twice
+                    removed += list.removeIf([t](Item& cur) { return cur.val == t; });
+                }
+            }
+        });
+    }
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    int left = 0;
+    list.forEach([&left](Item&) { left++; });
+    EXPECT_EQ(left + removed, THREADS * PER_THREAD);
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "RcuList.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(RcuListTest, ForEachFrontToBack) {
+    RcuList<int> list;
+    for (int i = 0; i < 5; i++) {
+        list.pushFront(i);
+    }
+
+    int i = 4;
+    list.forEach([&i](const int& val) {
+        EXPECT_EQ(val, i);
+        i--;
+    });
+    EXPECT_EQ(i, -1);
+}
+
+TEST(RcuListTest, RemoveIf) {
+    RcuList<int> list;
+    for (int i = 0; i < 10; i++) {
+        list.pushFront(i);
+    }
+
+    EXPECT_EQ(list.removeIf([](const int& val) { return val % 2 == 0; }), 5);
+
+    int i = 9;
+    list.forEach([&i](const int& val) {
+        EXPECT_EQ(val, i);
+        i -= 2;
+    });
+    EXPECT_EQ(i, -1);
+}
+
+TEST(RcuListTest, UpdateIfReplacesWithCopies) {
+    RcuList<int> list;
+    for (int i = 0; i < 10; i++) {
+        list.pushFront(i);
+    }
+
+    EXPECT_EQ(list.updateIf([](const int& val) { return val >= 5; }, [](int& val) { val *= 10; }), 5);
+
+    std::vector<int> vals;
+    list.forEach([&vals](const int& val) { vals.push_back(val); });
+    EXPECT_EQ(vals, (std::vector<int>{90, 80, 70, 60, 50, 4, 3, 2, 1, 0}));
+}
+
+// Elements below STABLE are never removed
+static constexpr int STABLE = 100;
+
+// Writers keep pushing and removing while readers check every traversal
+// sees the elements that are never removed, in order
+TEST(RcuListTest, ReadersRunAlongsideWriters) {
+    RcuList<int> list;
+    for (int i = 0; i < STABLE; i++) {
+        list.pushFront(i);
+    }
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; r++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                int expected = STABLE - 1;
+                list.forEach([&expected](const int& val) {
+                    if (val < STABLE) {
+                        EXPECT_EQ(val, expected);
+                        expected--;
+                    }
+                });
+                EXPECT_EQ(expected, -1);
+            }
+        });
+    }
+
+    std::thread writer{[&]() {
+        for (int round = 0; round < 200; round++) {
+            for (int i = 0; i < 10; i++) {
+                list.pushFront(STABLE + i);
+            }
+            list.updateIf([](const int& val) { return val >= STABLE; }, [](int& val) { val++; });
+            list.removeIf([](const int& val) { return val >= STABLE; });
+        }
+    }};
+    writer.join();
+    done = true;
+    for (std::thread& reader: readers) {
+        reader.join();
+    }
+}
+
+// Counts live instances to check every element is destroyed exactly once
+struct Tracked {
+    static inline std::atomic<int> live = 0;
+    int val = 0;
+
+    explicit Tracked(int val): val(val) {
+        live++;
+    }
+
+    Tracked(const Tracked& other): val(other.val) {
+        live++;
+    }
+
+    Tracked(Tracked&& other): val(other.val) {
+        live++;
+    }
+
+    ~Tracked() {
+        live--;
+    }
+};
+
+TEST(RcuListTest, FreesRemovedElements) {
+    {
+        RcuList<Tracked> list;
+        for (int i = 0; i < 1000; i++) {
+            list.pushFront(Tracked{i});
+        }
+        list.updateIf([](const Tracked& t) { return t.val % 3 == 0; }, [](Tracked& t) { t.val = -1; });
+        list.removeIf([](const Tracked& t) { return t.val % 2 == 0; });
+        Rcu::synchronize();
+        // The 333 even elements not updated were removed, and the
+        // originals of the updated ones are gone with them once no reader
+        // can hold them
+        EXPECT_EQ(Tracked::live.load(), 1000 - 333);
+    }
+    EXPECT_EQ(Tracked::live.load(), 0);
+}
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include "TsSkipList.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(TsSkipListTest, Basic) {
+    TsSkipList<int, std::string> map;
+    EXPECT_TRUE(map.insert(2, "two"));
+    EXPECT_TRUE(map.insert(1, "one"));
+    EXPECT_FALSE(map.insert(2, "again"));
+    EXPECT_EQ(map.size(), 2);
+
+    std::string val;
+    ASSERT_TRUE(map.find(2, val));
+    EXPECT_EQ(val, "two");
+    EXPECT_FALSE(map.find(3, val));
+    EXPECT_TRUE(map.contains(1));
+
+    EXPECT_TRUE(map.erase(2));
+    EXPECT_FALSE(map.erase(2));
+    EXPECT_FALSE(map.contains(2));
+    EXPECT_EQ(map.size(), 1);
+}
+
+TEST(TsSkipListTest, IteratesInKeyOrder) {
+    TsSkipList<int, int> map;
+    for (int key: {50, 10, 40, 0, 30, 20}) {
+        map.insert(key, key * 2);
+    }
+
+    std::vector<int> keys;
+    map.forEach([&keys](const int& key, const int& val) {
+        EXPECT_EQ(val, key * 2);
+        keys.push_back(key);
+    });
+    EXPECT_EQ(keys, (std::vector<int>{0, 10, 20, 30, 40, 50}));
+
+    keys.clear();
+    map.forEachInRange(15, 40, [&keys](const int& key, const int&) { keys.push_back(key); });
+    EXPECT_EQ(keys, (std::vector<int>{20, 30}));
+}
+
+TEST(TsSkipListTest, PopsSmallestFirst) {
+    TsSkipList<int, int, std::greater<int>> map;
+    for (int key: {3, 9, 1, 7, 5}) {
+        map.insert(key, -key);
+    }
+    int key, val;
+    for (int expected: {9, 7, 5, 3, 1}) {
+        ASSERT_TRUE(map.popFront(key, val));
+        EXPECT_EQ(key, expected);
+        EXPECT_EQ(val, -expected);
+    }
+    EXPECT_FALSE(map.popFront(key, val));
+    EXPECT_TRUE(map.empty());
+}
+
+TEST(TsSkipListTest, ConcurrentWritersAndReaders) {
+    TsSkipList<int, int> map;
+    constexpr int WRITERS = 4;
+    constexpr int KEYS = 5000;
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                int last = -1;
+                map.forEach([&last](const int& key, const int& val) {
+                    EXPECT_LT(last, key);
+                    EXPECT_EQ(val, key);
+                    last = key;
+                });
+                int val;
+                if (map.find(KEYS / 2, val)) {
+                    EXPECT_EQ(val, KEYS / 2);
+                }
+            }
+        });
+    }
+
+    // Each writer owns the keys equal to its index modulo WRITERS and
+    // erases every other one it inserted
+    std::vector<std::thread> writers;
+    for (int w = 0; w < WRITERS; w++) {
+        writers.emplace_back([&map, w]() {
+            for (int key = w; key < KEYS; key += WRITERS) {
+                ASSERT_TRUE(map.insert(key, key));
+            }
+            for (int key = w; key < KEYS; key += 2 * WRITERS) {
+                ASSERT_TRUE(map.erase(key));
+            }
+        });
+    }
+    for (std::thread& writer: writers) {
+        writer.join();
+    }
+    done = true;
+    for (std::thread& reader: readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(map.size(), KEYS / 2);
+    for (int key = 0; key < KEYS; key++) {
+        EXPECT_EQ(map.contains(key), (key / WRITERS) % 2 == 1) << key;
+    }
+}
+
+TEST(TsSkipListTest, ConcurrentPopsTakeEachKeyOnce) {
+    TsSkipList<int, int> map;
+    constexpr int KEYS = 20000;
+    for (int key = 0; key < KEYS; key++) {
+        map.insert(key, key);
+    }
+
+    std::vector<std::vector<int>> popped(4);
+    std::vector<std::thread> threads;
+    for (std::vector<int>& keys: popped) {
+        threads.emplace_back([&map, &keys]() {
+            int key, val;
+            while (map.popFront(key, val)) {
+                EXPECT_EQ(key, val);
+                keys.push_back(key);
+            }
+        });
+    }
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    std::vector<bool> seen(KEYS);
+    for (const std::vector<int>& keys: popped) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            // Each thread pops in increasing order
+            if (i > 0) {
+                EXPECT_LT(keys[i - 1], keys[i]);
+            }
+            EXPECT_FALSE(seen[keys[i]]);
+            seen[keys[i]] = true;
+        }
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), true), KEYS);
+}
+
+// Counts live instances to check every value is destroyed exactly once
+struct Tracked {
+    static inline std::atomic<int> live = 0;
+    int val = 0;
+
+    Tracked() {
+        live++;
+    }
+
+    explicit Tracked(int val): val(val) {
+        live++;
+    }
+
+    Tracked(const Tracked& other): val(other.val) {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other) = default;
+
+    ~Tracked() {
+        live--;
+    }
+};
+
+TEST(TsSkipListTest, DestroysEveryValueOnce) {
+    {
+        TsSkipList<int, Tracked> map;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&map, t]() {
+                for (int i = 0; i < 2000; i++) {
+                    int key = i * 4 + t;
+                    map.insert(key, Tracked{key});
+                    if (i % 2 == 0) {
+                        map.erase(key);
+                    }
+                }
+            });
+        }
+        for (std::thread& thread: threads) {
+            thread.join();
+        }
+        EXPECT_EQ(map.size(), 4000);
+        // Let the erased nodes still waiting on readers go
+        Rcu::synchronize();
+        Rcu::synchronize();
+    }
+    EXPECT_EQ(Tracked::live.load(), 0);
+}
@@ -1,8 +1,23 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "TsQueue.hpp"
 #include "FineGrainedTsQueue.hpp"
+#include "TsPriorityQueue.hpp"
+#include "RingQueue.hpp"
+#include "LockFreeQueue.hpp"
+
+// Large enough to take everything a test pushes before it pops
+template <typename T>
+class LargeRingQueue: public RingQueue<T> {
+public:
+    LargeRingQueue(): RingQueue<T>(1 << 19) {}
+};
 
 template <typename T>
 class ITsQueueTest: public testing::Test {
@@ -10,7 +25,9 @@ public:
     T queueImpl;
 };
 
-using IntQueueImpls = ::testing::Types<TsQueue<int>, FineGrainedTsQueue<int>>;
+// Smallest first, so the priority queue pops increasing pushes in order
+using IntQueueImpls = ::testing::Types<TsQueue<int>, FineGrainedTsQueue<int>,
+        TsPriorityQueue<int, std::greater<int>>, LargeRingQueue<int>, LockFreeQueue<int>>;
 TYPED_TEST_SUITE(ITsQueueTest, IntQueueImpls);
 
 TYPED_TEST(ITsQueueTest, Basic) {
@@ -175,7 +192,8 @@ public:
     T queueImpl;
 };
 
-using CustomStructQueueImpls = ::testing::Types<TsQueue<Foo>, FineGrainedTsQueue<Foo>>;
+using CustomStructQueueImpls = ::testing::Types<TsQueue<Foo>, FineGrainedTsQueue<Foo>, RingQueue<Foo>,
+        LockFreeQueue<Foo>>;
 TYPED_TEST_SUITE(ITsQueueCustomStructTest, CustomStructQueueImpls);
 
 TYPED_TEST(ITsQueueCustomStructTest, CustomStruct) {
@@ -194,3 +212,147 @@ TYPED_TEST(ITsQueueCustomStructTest, CustomStruct) {
     }
 }
 
+
+TEST(TsPriorityQueueTest, PopsGreatestFirst) {
+    TsPriorityQueue<int> queue;
+    for (int val: {3, 9, 1, 7, 5}) {
+        queue.push(val);
+    }
+    int val;
+    for (int expected: {9, 7, 5, 3, 1}) {
+        ASSERT_TRUE(queue.tryPop(val));
+        EXPECT_EQ(val, expected);
+    }
+    EXPECT_FALSE(queue.tryPop(val));
+}
+
+TEST(RingQueueTest, IsBounded) {
+    RingQueue<int> queue(4);
+    EXPECT_EQ(queue.capacity(), 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.tryPush(int{i}));
+    }
+    EXPECT_FALSE(queue.tryPush(4));
+    int val;
+    ASSERT_TRUE(queue.tryPop(val));
+    EXPECT_EQ(val, 0);
+    EXPECT_TRUE(queue.tryPush(4));
+    EXPECT_EQ(queue.size(), 4);
+}
+
+TEST(RingQueueTest, PushesAndPopsInBatches) {
+    RingQueue<int> queue(8);
+    int values[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    ASSERT_EQ(queue.pushN(values, 6), 6);
+    // Only what fits goes in
+    ASSERT_EQ(queue.pushN(values + 6, 4), 2);
+
+    int out[10];
+    ASSERT_EQ(queue.popN(out, 3), 3);
+    ASSERT_EQ(queue.popN(out + 3, 10), 5);
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(out[i], i);
+    }
+    EXPECT_EQ(queue.popN(out, 10), 0);
+}
+
+TEST(RingQueueTest, PushWaitsForSpace) {
+    RingQueue<int> queue(2);
+    queue.push(1);
+    queue.push(2);
+    std::thread producer{[&queue]() { queue.push(3); }};
+    int val;
+    for (int expected: {1, 2, 3}) {
+        ASSERT_TRUE(queue.waitAndPop(val));
+        EXPECT_EQ(val, expected);
+    }
+    producer.join();
+}
+
+TEST(RingQueueTest, StopWakesWaiters) {
+    RingQueue<int> queue(2);
+    bool popped = true;
+    std::thread consumer{[&]() {
+        int val;
+        popped = queue.waitAndPop(val);
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    queue.stop();
+    consumer.join();
+    EXPECT_FALSE(popped);
+}
+
+TEST(FineGrainedTsQueueTest, ReusesPoppedNodes) {
+    FineGrainedTsQueue<std::string> queue(4);
+    std::string val;
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 8; i++) {
+            queue.push(std::to_string(round * 8 + i));
+        }
+        for (int i = 0; i < 8; i++) {
+            ASSERT_TRUE(queue.tryPop(val));
+            EXPECT_EQ(val, std::to_string(round * 8 + i));
+        }
+    }
+    EXPECT_TRUE(queue.empty());
+    for (int i = 0; i < 8; i++) {
+        queue.push(std::to_string(i));
+    }
+    // The rest are destroyed with the queue
+    SharedPtr<std::string> res = queue.waitAndPop();
+    EXPECT_EQ(*res, "0");
+}
+
+TEST(TsQueueTest, PushesAndDrainsInBatches) {
+    TsQueue<int> queue;
+    std::vector<int> values{0, 1, 2, 3, 4, 5};
+    queue.pushBatch(values);
+    queue.pushBatch(std::vector<int>{6, 7});
+    EXPECT_EQ(values.size(), 6);
+
+    std::deque<int> out;
+    ASSERT_EQ(queue.drain(out, 3), 3);
+    // Appended after what out already holds
+    ASSERT_EQ(queue.drain(out), 5);
+    ASSERT_EQ(out.size(), 8);
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(out[i], i);
+    }
+    EXPECT_EQ(queue.drain(out), 0);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(TsQueueTest, BatchWakesEveryWaiter) {
+    TsQueue<int> queue;
+    std::atomic<int> sum = 0;
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 4; i++) {
+        consumers.emplace_back([&]() {
+            int val;
+            ASSERT_TRUE(queue.waitAndPop(val));
+            sum += val;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    queue.pushBatch(std::vector<int>{1, 2, 3, 4});
+    for (std::thread& consumer: consumers) {
+        consumer.join();
+    }
+    EXPECT_EQ(sum, 10);
+}
+
+TEST(TsQueueTest, WaitAndPopForTimesOut) {
+    TsQueue<int> queue;
+    int val;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(queue.waitAndPopFor(val, std::chrono::milliseconds{20}));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{20});
+
+    std::thread producer{[&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        queue.push(7);
+    }};
+    ASSERT_TRUE(queue.waitAndPopFor(val, std::chrono::seconds{10}));
+    EXPECT_EQ(val, 7);
+    producer.join();
+}
@@ -2,7 +2,89 @@
 
 #include "LockFreeQueue.hpp"
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST(LockFreeQueueTest, Basic) {
-    LockFreeQueue q;
+    LockFreeQueue<int> q;
     q.push(1);
+    int val;
+    ASSERT_TRUE(q.tryPop(val));
+    EXPECT_EQ(val, 1);
+    EXPECT_FALSE(q.tryPop(val));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(LockFreeQueueTest, HoldsNonTrivialTypes) {
+    LockFreeQueue<std::string> q;
+    for (int i = 0; i < 100; i++) {
+        q.push(std::string(64, 'a' + i % 26));
+    }
+    std::string val;
+    for (int i = 0; i < 50; i++) {
+        ASSERT_TRUE(q.tryPop(val));
+        EXPECT_EQ(val, std::string(64, 'a' + i % 26));
+    }
+    // The rest are destroyed with the queue
+}
+
+// Counts live instances to check every element is destroyed exactly once
+struct Tracked {
+    static inline std::atomic<int> live = 0;
+    int val = 0;
+
+    Tracked() {
+        live++;
+    }
+
+    explicit Tracked(int val): val(val) {
+        live++;
+    }
+
+    Tracked(const Tracked& other): val(other.val) {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other) = default;
+
+    ~Tracked() {
+        live--;
+    }
+};
+
+TEST(LockFreeQueueTest, DestroysEveryElementOnce) {
+    {
+        LockFreeQueue<Tracked> q;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&q]() {
+                Tracked val;
+                for (int i = 0; i < 10000; i++) {
+                    q.push(Tracked{i});
+                    if (i % 2 == 0) {
+                        q.tryPop(val);
+                    }
+                }
+            });
+        }
+        for (std::thread& thread: threads) {
+            thread.join();
+        }
+    }
+    EXPECT_EQ(Tracked::live.load(), 0);
+}
+
+TEST(LockFreeQueueTest, StopWakesWaiters) {
+    LockFreeQueue<int> q;
+    bool popped = true;
+    std::thread consumer{[&]() {
+        int val;
+        popped = q.waitAndPop(val);
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    q.stop();
+    consumer.join();
+    EXPECT_FALSE(popped);
 }
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "SpscQueue.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(SpscQueueTest, IsBounded) {
+    SpscQueue<int> q(4);
+    EXPECT_EQ(q.capacity(), 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(q.tryPush(int{i}));
+    }
+    EXPECT_FALSE(q.tryPush(4));
+    int val;
+    ASSERT_TRUE(q.tryPop(val));
+    EXPECT_EQ(val, 0);
+    EXPECT_TRUE(q.tryPush(4));
+    EXPECT_EQ(q.size(), 4);
+    for (int expected = 1; expected <= 4; expected++) {
+        ASSERT_TRUE(q.tryPop(val));
+        EXPECT_EQ(val, expected);
+    }
+    EXPECT_FALSE(q.tryPop(val));
+}
+
+TEST(SpscQueueTest, PushesAndPopsInBatches) {
+    SpscQueue<std::string> q(8);
+    std::vector<std::string> values;
+    for (int i = 0; i < 10; i++) {
+        values.push_back(std::to_string(i));
+    }
+    ASSERT_EQ(q.pushN(values.data(), 6), 6);
+    // Only what fits goes in
+    ASSERT_EQ(q.pushN(values.data() + 6, 4), 2);
+
+    std::string out[10];
+    ASSERT_EQ(q.popN(out, 3), 3);
+    ASSERT_EQ(q.popN(out + 3, 10), 5);
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(out[i], std::to_string(i));
+    }
+    EXPECT_EQ(q.popN(out, 10), 0);
+}
+
+TEST(SpscQueueTest, KeepsOrderAcrossThreads) {
+    SpscQueue<int> q(64);
+    constexpr int COUNT = 1000000;
+    std::thread producer{[&q]() {
+        for (int i = 0; i < COUNT; i++) {
+            q.push(i);
+        }
+    }};
+    int val;
+    for (int expected = 0; expected < COUNT; expected++) {
+        ASSERT_TRUE(q.waitAndPop(val));
+        ASSERT_EQ(val, expected);
+    }
+    producer.join();
+}
+
+TEST(SpscQueueTest, KeepsOrderAcrossBatches) {
+    SpscQueue<int> q(64);
+    constexpr int COUNT = 1000000;
+    std::thread producer{[&q]() {
+        int batch[16];
+        for (int next = 0; next < COUNT;) {
+            int size = std::min(16, COUNT - next);
+            for (int i = 0; i < size; i++) {
+                batch[i] = next + i;
+            }
+            size_t pushed = q.pushN(batch, size);
+            if (pushed == 0) {
+                std::this_thread::yield();
+            }
+            next += pushed;
+        }
+    }};
+    int out[32];
+    for (int expected = 0; expected < COUNT;) {
+        size_t count = q.popN(out, 32);
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+    producer.join();
+}
+
+TEST(SpscQueueTest, StopWakesWaiters) {
+    SpscQueue<int> q(2);
+    bool popped = true;
+    std::thread consumer{[&]() {
+        int val;
+        popped = q.waitAndPop(val);
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    q.stop();
+    consumer.join();
+    EXPECT_FALSE(popped);
+}